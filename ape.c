@@ -24,25 +24,22 @@ static const char preamble[PREAMBLE_SIZE] = { 'A', 'P', 'E', 'T', 'A', 'G', 'E',
 #define HEADER_SIZE (32)
 
 /* returns position of APE header or -1 if not found */
-static int find_ape_tag_slow(int fd)
+static off_t find_ape_tag_slow(struct tag_probe *tp)
 {
-	char buf[4096];
+	/* buf must not grow with the option while we are looping */
+	int block = tag_probe_size;
+	char *buf;
 	int match = 0;
-	int pos = 0;
-
-	/* seek to start of file */
-	if (lseek(fd, pos, SEEK_SET) == -1)
-		return -1;
+	off_t pos = 0;
 
-	while (1) {
-		int i, got = read(fd, buf, sizeof(buf));
+	buf = xnew(char, block);
+	while (pos < tp->size) {
+		int i, got = block;
 
-		if (got == -1) {
-			if (errno == EAGAIN || errno == EINTR)
-				continue;
-			break;
-		}
-		if (got == 0)
+		if (tp->size - pos < got)
+			got = tp->size - pos;
+		/* first and last block come from the probe buffers */
+		if (tag_probe_read(tp, pos, buf, got))
 			break;
 
 		for (i = 0; i < got; i++) {
@@ -52,11 +49,14 @@ static int find_ape_tag_slow(int fd)
 			}
 
 			match++;
-			if (match == PREAMBLE_SIZE)
+			if (match == PREAMBLE_SIZE) {
+				free(buf);
 				return pos + i + 1 - PREAMBLE_SIZE;
+			}
 		}
 		pos += got;
 	}
+	free(buf);
 	return -1;
 }
 
@@ -72,36 +72,38 @@ static int ape_parse_header(const char *buf, struct ape_header *h)
 	return 1;
 }
 
-static int read_header(int fd, struct ape_header *h)
+/* returns offset of the tag data if found, otherwise -1 */
+static off_t find_ape_tag(struct tag_probe *tp, struct ape_header *h, int slow)
 {
-	char buf[HEADER_SIZE];
+	char tmp[HEADER_SIZE];
+	const char *buf;
+	off_t pos;
 
-	if (read_all(fd, buf, sizeof(buf)) != sizeof(buf))
-		return 0;
-	return ape_parse_header(buf, h);
-}
+	pos = tp->size - HEADER_SIZE;
+	buf = tag_probe_peek(tp, pos, HEADER_SIZE);
+	if (buf && ape_parse_header(buf, h))
+		goto found;
 
-/* sets fd right after the header and returns 1 if found,
- * otherwise returns 0
- */
-static int find_ape_tag(int fd, struct ape_header *h, int slow)
-{
-	int pos;
-
-	if (lseek(fd, -HEADER_SIZE, SEEK_END) == -1)
-		return 0;
-	if (read_header(fd, h))
-		return 1;
+	/* APE tag followed by ID3v1, still in the tail buffer */
+	pos = tp->size - 128 - HEADER_SIZE;
+	buf = tag_probe_peek(tp, pos, HEADER_SIZE + 3);
+	if (buf && !memcmp(buf + HEADER_SIZE, "TAG", 3) && ape_parse_header(buf, h))
+		goto found;
 
 	if (!slow)
-		return 0;
+		return -1;
 
-	pos = find_ape_tag_slow(fd);
+	pos = find_ape_tag_slow(tp);
 	if (pos == -1)
-		return 0;
-	if (lseek(fd, pos, SEEK_SET) == -1)
-		return 0;
-	return read_header(fd, h);
+		return -1;
+	if (tag_probe_read(tp, pos, tmp, HEADER_SIZE) || !ape_parse_header(tmp, h))
+		return -1;
+found:
+	if (AF_IS_FOOTER(h->flags)) {
+		/* size includes the footer but not the header */
+		return pos + HEADER_SIZE - h->size;
+	}
+	return pos + HEADER_SIZE;
 }
 
 /*
@@ -184,45 +186,36 @@ static int ape_parse_one(const char *buf, int size, char **keyp, char **valp)
 	return -1;
 }
 
-static off_t get_size(int fd)
-{
-	struct stat statbuf;
-
-	if (fstat(fd, &statbuf) || !(statbuf.st_mode & S_IFREG))
-		return 0;
-	return statbuf.st_size;
-}
-
 /* return the number of comments, or -1 */
-int ape_read_tags(struct apetag *ape, int fd, int slow)
+int ape_read_tags_probe(struct apetag *ape, struct tag_probe *tp, int slow)
 {
 	struct ape_header *h = &ape->header;
-	int old_pos, rc = -1;
-
-	/* save position */
-	old_pos = lseek(fd, 0, SEEK_CUR);
-
-	if (!find_ape_tag(fd, h, slow))
-		goto fail;
+	off_t pos;
 
-	if (AF_IS_FOOTER(h->flags)) {
-		/* seek back right after the header */
-		if (lseek(fd, get_size(fd) - h->size, SEEK_SET) == -1)
-			goto fail;
-	}
+	pos = find_ape_tag(tp, h, slow);
+	if (pos == -1)
+		return -1;
 
 	/* ignore insane tags */
 	if (h->size > 1024 * 1024)
-		goto fail;
+		return -1;
 
 	ape->buf = xnew(char, h->size);
-	if (read_all(fd, ape->buf, h->size) != h->size)
-		goto fail;
+	if (tag_probe_read(tp, pos, ape->buf, h->size))
+		return -1;
+
+	return h->count;
+}
 
-	rc = h->count;
+int ape_read_tags(struct apetag *ape, int fd, int slow)
+{
+	struct tag_probe tp;
+	int rc;
 
-fail:
-	lseek(fd, old_pos, SEEK_SET);
+	if (tag_probe_init(&tp, fd))
+		return -1;
+	rc = ape_read_tags_probe(ape, &tp, slow);
+	tag_probe_free(&tp);
 	return rc;
 }
 
@@ -5,6 +5,8 @@
 #ifndef _APE_H
 #define _APE_H
 
+#include "tag_probe.h"
+
 #include <inttypes.h>
 #include <stdlib.h>
 
@@ -38,6 +40,7 @@ struct apetag {
 #define APETAG(name) struct apetag name = { .buf = NULL, .pos = 0, }
 
 extern int ape_read_tags(struct apetag *ape, int fd, int slow);
+extern int ape_read_tags_probe(struct apetag *ape, struct tag_probe *tp, int slow);
 extern char *ape_get_comment(struct apetag *ape, char **val);
 
 static inline void ape_free(struct apetag *ape)
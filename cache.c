@@ -3,13 +3,19 @@
 #include "file.h"
 #include "input.h"
 #include "track_info.h"
+#include "ti_hash.h"
 #include "utils.h"
 #include "xmalloc.h"
 #include "xstrjoin.h"
 #include "gbuf.h"
+#include "job_stats.h"
+#include "editable.h"
+#include "debug.h"
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
 #include <sys/types.h>
 #include <sys/stat.h>
 #include <unistd.h>
@@ -30,39 +36,31 @@ struct cache_entry {
 	unsigned int size;
 	int duration;
 	time_t mtime;
+	// CACHE_ENTRY_*
+	unsigned int flags;
+	// size of seek index which follows strings
+	unsigned int seek_idx_size;
 
 	// filename and N * (key, val)
 	char strings[0];
 };
 
+#define CACHE_ENTRY_ESTIMATED	0x01
+
 #define ALIGN(size) (((size) + sizeof(long) - 1) & ~(sizeof(long) - 1))
-#define HASH_SIZE 1023
 
-static struct track_info *hash_table[HASH_SIZE];
+static TI_HASH(cache_hash);
 static char *cache_filename;
 static int total;
 static int removed;
 static int new;
+static int updated;
 
 pthread_mutex_t cache_mutex = CMUS_MUTEX_INITIALIZER;
 
-static unsigned int filename_hash(const char *filename)
+static void add_ti(struct track_info *ti)
 {
-	unsigned int hash = 0;
-	int i;
-
-	for (i = 0; filename[i]; i++)
-		hash = (hash << 5) - hash + filename[i];
-	return hash;
-}
-
-static void add_ti(struct track_info *ti, unsigned int hash)
-{
-	unsigned int pos = hash % HASH_SIZE;
-	struct track_info *next = hash_table[pos];
-
-	ti->next = next;
-	hash_table[pos] = ti;
+	ti_hash_insert(&cache_hash, ti);
 	total++;
 }
 
@@ -78,7 +76,10 @@ static int valid_cache_entry(const struct cache_entry *e, unsigned int avail)
 	if (e->size < min_size || e->size > avail)
 		return 0;
 
-	str_size = e->size - min_size;
+	if (e->seek_idx_size >= e->size - min_size)
+		return 0;
+
+	str_size = e->size - min_size - e->seek_idx_size;
 	count = 0;
 	for (i = 0; i < str_size; i++) {
 		if (!e->strings[i])
@@ -94,81 +95,32 @@ static int valid_cache_entry(const struct cache_entry *e, unsigned int avail)
 static struct track_info *cache_entry_to_ti(struct cache_entry *e)
 {
 	const char *strings = e->strings;
-	struct track_info *ti = track_info_new(strings);
-	struct keyval *kv;
-	int str_size = e->size - sizeof(*e);
-	int pos, i, count;
+	int str_size = e->size - sizeof(*e) - e->seek_idx_size;
+	struct track_info *ti = track_info_new_strings(strings, str_size);
 
 	ti->duration = e->duration;
 	ti->mtime = e->mtime;
-
-	// count strings (filename + key/val pairs)
-	count = 0;
-	for (i = 0; i < str_size; i++) {
-		if (!strings[i])
-			count++;
-	}
-	count = (count - 1) / 2;
-
-	// NOTE: filename already copied by track_info_new()
-	pos = strlen(strings) + 1;
-	ti->comments = xnew(struct keyval, count + 1);
-	kv = ti->comments;
-	for (i = 0; i < count; i++) {
-		int size;
-
-		size = strlen(strings + pos) + 1;
-		kv[i].key = xstrdup(strings + pos);
-		pos += size;
-
-		size = strlen(strings + pos) + 1;
-		kv[i].val = xstrdup(strings + pos);
-		pos += size;
+	ti->duration_estimated = (e->flags & CACHE_ENTRY_ESTIMATED) != 0;
+	if (e->seek_idx_size) {
+		ti->seek_idx = xmalloc(e->seek_idx_size);
+		memcpy(ti->seek_idx, strings + str_size, e->seek_idx_size);
+		ti->seek_idx_size = e->seek_idx_size;
 	}
-	kv[i].key = NULL;
-	kv[i].val = NULL;
 	return ti;
 }
 
-static struct track_info *lookup_cache_entry(const char *filename, unsigned int hash)
+static struct track_info *lookup_cache_entry(const char *filename)
 {
-	struct track_info *ti = hash_table[hash % HASH_SIZE];
-
-	while (ti) {
-		if (!strcmp(filename, ti->filename))
-			return ti;
-		ti = ti->next;
-	}
-	return NULL;
-}
-
-static void do_cache_remove_ti(struct track_info *ti, unsigned int hash)
-{
-	unsigned int pos = hash % HASH_SIZE;
-	struct track_info *t = hash_table[pos];
-	struct track_info *next, *prev = NULL;
-
-	while (t) {
-		next = t->next;
-		if (t == ti) {
-			if (prev) {
-				prev->next = next;
-			} else {
-				hash_table[pos] = next;
-			}
-			total--;
-			removed++;
-			track_info_unref(ti);
-			return;
-		}
-		prev = t;
-		t = next;
-	}
+	return ti_hash_lookup(&cache_hash, filename, ti_hash_filename(filename));
 }
 
 void cache_remove_ti(struct track_info *ti)
 {
-	do_cache_remove_ti(ti, filename_hash(ti->filename));
+	if (ti_hash_remove(&cache_hash, ti)) {
+		total--;
+		removed++;
+		track_info_unref(ti);
+	}
 }
 
 static int read_cache(void)
@@ -207,7 +159,7 @@ static int read_cache(void)
 			goto corrupt;
 
 		ti = cache_entry_to_ti(e);
-		add_ti(ti, filename_hash(ti->filename));
+		add_ti(ti);
 		offset += ALIGN(e->size);
 	}
 	munmap(buf, size);
@@ -236,12 +188,19 @@ int cache_init(void)
 	cache_header[4] = flags & 0xff; flags >>= 8;
 
 	/* assumed version */
-	cache_header[3] = 0x01;
+	cache_header[3] = 0x02;
 
-	cache_filename = xstrjoin(cmus_config_dir, "/cache");
+	if (!cache_filename)
+		cache_filename = xstrjoin(cmus_config_dir, "/cache");
 	return read_cache();
 }
 
+void cache_set_filename(const char *filename)
+{
+	free(cache_filename);
+	cache_filename = xstrdup(filename);
+}
+
 static int ti_filename_cmp(const void *a, const void *b)
 {
 	const struct track_info *ai = *(const struct track_info **)a;
@@ -257,13 +216,9 @@ static struct track_info **get_track_infos(void)
 
 	tis = xnew(struct track_info *, total);
 	c = 0;
-	for (i = 0; i < HASH_SIZE; i++) {
-		struct track_info *ti = hash_table[i];
-
-		while (ti) {
-			tis[c++] = ti;
-			ti = ti->next;
-		}
+	for (i = 0; i < cache_hash.size; i++) {
+		if (cache_hash.slots[i])
+			tis[c++] = cache_hash.slots[i];
 	}
 	qsort(tis, total, sizeof(struct track_info *), ti_filename_cmp);
 	return tis;
@@ -289,6 +244,9 @@ static void write_ti(int fd, struct gbuf *buf, struct track_info *ti, unsigned i
 	e.size = sizeof(e);
 	e.duration = ti->duration;
 	e.mtime = ti->mtime;
+	e.flags = ti->duration_estimated ? CACHE_ENTRY_ESTIMATED : 0;
+	e.seek_idx_size = ti->seek_idx_size;
+	e.size += ti->seek_idx_size;
 	len[count] = strlen(ti->filename) + 1;
 	e.size += len[count++];
 	for (i = 0; kv[i].key; i++) {
@@ -311,10 +269,17 @@ static void write_ti(int fd, struct gbuf *buf, struct track_info *ti, unsigned i
 		gbuf_add_bytes(buf, kv[i].key, len[count++]);
 		gbuf_add_bytes(buf, kv[i].val, len[count++]);
 	}
+	if (ti->seek_idx_size)
+		gbuf_add_bytes(buf, ti->seek_idx, ti->seek_idx_size);
 
 	*offsetp = offset + pad + e.size;
 }
 
+const char *cache_get_filename(void)
+{
+	return cache_filename;
+}
+
 int cache_close(void)
 {
 	GBUF(buf);
@@ -323,10 +288,11 @@ int cache_close(void)
 	int i, fd;
 	char *tmp;
 
-	if (!new && !removed)
+	if (!new && !removed && !updated)
 		return 0;
 
-	tmp = xstrjoin(cmus_config_dir, "/cache.tmp");
+	/* same directory, rename() can't cross filesystems */
+	tmp = xstrjoin(cache_filename, ".tmp");
 	fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
 	if (fd < 0)
 		return -1;
@@ -352,9 +318,21 @@ static struct track_info *ip_get_ti(const char *filename)
 	struct track_info *ti = NULL;
 	struct input_plugin *ip;
 	struct keyval *comments;
-	int rc;
+	int rc, duration;
 
 	ip = ip_new(filename);
+
+	/* fast path, no decoder */
+	rc = ip_read_info(ip, &comments, &duration);
+	if (!rc) {
+		ti = track_info_new(filename, comments);
+		keyvals_free(comments);
+		ti->duration = duration;
+		ti->mtime = 0;
+		ip_delete(ip);
+		return ti;
+	}
+
 	rc = ip_open(ip);
 	if (rc) {
 		ip_delete(ip);
@@ -363,93 +341,335 @@ static struct track_info *ip_get_ti(const char *filename)
 
 	rc = ip_read_comments(ip, &comments);
 	if (!rc) {
-		ti = track_info_new(filename);
-		ti->comments = comments;
+		ti = track_info_new(filename, comments);
+		keyvals_free(comments);
 		ti->duration = ip_duration(ip);
+		ti->duration_estimated = ip_duration_estimated(ip);
 		ti->mtime = 0;
 	}
 	ip_delete(ip);
 	return ti;
 }
 
-struct track_info *cache_get_ti(const char *filename)
+static struct track_info *ip_get_ti_timed(const char *filename)
 {
-	unsigned int hash = filename_hash(filename);
+	const char *ext = strrchr(filename, '.');
 	struct track_info *ti;
+	struct timeval t1, t2;
 
-	ti = lookup_cache_entry(filename, hash);
-	if (!ti) {
-		ti = ip_get_ti(filename);
-		if (!ti)
-			return NULL;
-		ti->mtime = file_get_mtime(filename);
-		add_ti(ti, hash);
+	gettimeofday(&t1, NULL);
+	ti = ip_get_ti(filename);
+	gettimeofday(&t2, NULL);
+
+	job_stats_scanned(ext ? ext + 1 : "unknown",
+			(t2.tv_sec - t1.tv_sec) * (uint64_t)1000000 + t2.tv_usec - t1.tv_usec);
+	return ti;
+}
+
+/*
+ * @ti has been read without cache lock, returns the cached track_info
+ * for its filename, referenced
+ */
+static struct track_info *add_read_ti(struct track_info *ti)
+{
+	struct track_info *other;
+
+	other = ti_hash_lookup(&cache_hash, ti->filename, ti->hash);
+	if (other) {
+		/* added by someone else meanwhile */
+		track_info_unref(ti);
+		ti = other;
+	} else {
+		add_ti(ti);
 		new++;
 	}
 	track_info_ref(ti);
 	return ti;
 }
 
-struct track_info **cache_refresh(int *count)
+struct track_info *cache_get_ti(const char *filename)
+{
+	struct track_info *ti;
+
+	ti = lookup_cache_entry(filename);
+	job_stats_cache(ti != NULL);
+	if (ti) {
+		track_info_ref(ti);
+		return ti;
+	}
+
+	/* don't block other workers while reading the tags */
+	cache_unlock();
+	ti = ip_get_ti_timed(filename);
+	if (ti)
+		ti->mtime = file_get_mtime(filename);
+	cache_lock();
+	if (!ti)
+		return NULL;
+	return add_read_ti(ti);
+}
+
+/* threads reading tags for cache_get_tis(), including the caller */
+#define NR_READ_THREADS 8
+
+struct read_pool {
+	pthread_mutex_t mutex;
+	/* a batch has been queued or the pool is being freed */
+	pthread_cond_t work_cond;
+	/* nr_busy dropped to 0 */
+	pthread_cond_t idle_cond;
+	pthread_t threads[NR_READ_THREADS - 1];
+	int nr_threads;
+	int exiting;
+
+	/* current batch */
+	char * const *filenames;
+	struct track_info **tis;
+	/* indexes of the files not found in the cache */
+	int *misses;
+	int nr_misses;
+	int next;
+	int cancelled;
+	/* files being read */
+	int nr_busy;
+};
+
+/* takes files of the current batch until there are none left, p->mutex held */
+static void read_misses(struct read_pool *p, int (*cancel)(void))
+{
+	while (1) {
+		struct track_info *ti;
+		int i;
+
+		if (cancel && cancel())
+			p->cancelled = 1;
+		if (p->cancelled || p->next == p->nr_misses)
+			return;
+		i = p->misses[p->next++];
+		p->nr_busy++;
+		cmus_mutex_unlock(&p->mutex);
+
+		ti = ip_get_ti_timed(p->filenames[i]);
+		if (ti)
+			ti->mtime = file_get_mtime(p->filenames[i]);
+
+		cmus_mutex_lock(&p->mutex);
+		p->tis[i] = ti;
+		if (--p->nr_busy == 0)
+			pthread_cond_signal(&p->idle_cond);
+	}
+}
+
+static void *read_thread(void *arg)
+{
+	struct read_pool *p = arg;
+
+	cmus_mutex_lock(&p->mutex);
+	while (!p->exiting) {
+		read_misses(p, NULL);
+		pthread_cond_wait(&p->work_cond, &p->mutex);
+	}
+	cmus_mutex_unlock(&p->mutex);
+	return NULL;
+}
+
+struct read_pool *read_pool_new(void)
+{
+	struct read_pool *p = xnew0(struct read_pool, 1);
+
+	pthread_mutex_init(&p->mutex, NULL);
+	pthread_cond_init(&p->work_cond, NULL);
+	pthread_cond_init(&p->idle_cond, NULL);
+	return p;
+}
+
+void read_pool_free(struct read_pool *p)
 {
-	struct track_info **tis = get_track_infos();
 	int i;
 
-	for (i = 0; i < total; i++) {
-		unsigned int hash;
-		struct track_info *ti = tis[i];
-		struct stat st;
-		int rc;
-
-		/*
-		 * If no-one else has reference to tis[i] then it is set to NULL
-		 * otherwise:
-		 *
-		 * unchanged: tis[i] = NULL
-		 * deleted:   tis[i]->next = NULL
-		 * changed:   tis[i]->next = new
-		 */
-
-		rc = stat(ti->filename, &st);
-		if (!rc && ti->mtime == st.st_mtime) {
-			// unchanged
-			tis[i] = NULL;
-			continue;
-		}
+	cmus_mutex_lock(&p->mutex);
+	p->exiting = 1;
+	pthread_cond_broadcast(&p->work_cond);
+	cmus_mutex_unlock(&p->mutex);
+	for (i = 0; i < p->nr_threads; i++)
+		pthread_join(p->threads[i], NULL);
+	pthread_cond_destroy(&p->idle_cond);
+	pthread_cond_destroy(&p->work_cond);
+	pthread_mutex_destroy(&p->mutex);
+	free(p);
+}
 
-		hash = filename_hash(ti->filename);
-		track_info_ref(ti);
-		do_cache_remove_ti(ti, hash);
-
-		if (!rc) {
-			// changed
-			struct track_info *new_ti = ip_get_ti(ti->filename);
-
-			if (new_ti) {
-				new_ti->mtime = st.st_mtime;
-				add_ti(new_ti, hash);
-				new++;
-
-				if (ti->ref == 1) {
-					track_info_unref(ti);
-					tis[i] = NULL;
-				} else {
-					track_info_ref(new_ti);
-					ti->next = new_ti;
-				}
-				continue;
-			}
-			// treat as deleted
+/* threads are started when a batch needs them, then kept */
+static void start_read_threads(struct read_pool *p, int wanted)
+{
+	if (wanted > NR_READ_THREADS - 1)
+		wanted = NR_READ_THREADS - 1;
+	while (p->nr_threads < wanted) {
+		int rc = pthread_create(&p->threads[p->nr_threads], NULL, read_thread, p);
+
+		if (rc) {
+			d_print("pthread_create: %s\n", strerror(rc));
+			break;
 		}
+		p->nr_threads++;
+	}
+}
 
-		// deleted
-		if (ti->ref == 1) {
-			track_info_unref(ti);
-			tis[i] = NULL;
+void cache_get_tis(struct read_pool *p, char * const *filenames, int nr,
+		struct track_info **tis, int (*cancel)(void))
+{
+	int *misses = xnew(int, nr);
+	int i, nr_misses = 0;
+
+	cache_lock();
+	for (i = 0; i < nr; i++) {
+		tis[i] = lookup_cache_entry(filenames[i]);
+		job_stats_cache(tis[i] != NULL);
+		if (tis[i]) {
+			track_info_ref(tis[i]);
 		} else {
-			ti->next = NULL;
+			misses[nr_misses++] = i;
 		}
 	}
+	cache_unlock();
+
+	if (nr_misses == 0) {
+		free(misses);
+		return;
+	}
+
+	/* the caller reads too */
+	start_read_threads(p, nr_misses - 1);
+
+	cmus_mutex_lock(&p->mutex);
+	p->filenames = filenames;
+	p->tis = tis;
+	p->misses = misses;
+	p->nr_misses = nr_misses;
+	p->next = 0;
+	p->cancelled = 0;
+	pthread_cond_broadcast(&p->work_cond);
+	read_misses(p, cancel);
+	/* no new files are taken, wait for the ones being read */
+	while (p->nr_busy)
+		pthread_cond_wait(&p->idle_cond, &p->mutex);
+	/* late wakeups of the threads find nothing to do */
+	p->nr_misses = 0;
+	p->next = 0;
+	cmus_mutex_unlock(&p->mutex);
+
+	cache_lock();
+	for (i = 0; i < nr_misses; i++) {
+		int idx = misses[i];
+
+		if (tis[idx])
+			tis[idx] = add_read_ti(tis[idx]);
+	}
+	cache_unlock();
+	free(misses);
+}
+
+struct track_info **cache_get_all(int *count)
+{
+	struct track_info **tis = get_track_infos();
+	int i;
+
+	for (i = 0; i < total; i++)
+		track_info_ref(tis[i]);
 	*count = total;
 	return tis;
 }
+
+struct track_info *cache_read_ti(const char *filename, time_t mtime)
+{
+	struct track_info *ti = ip_get_ti_timed(filename);
+
+	if (ti)
+		ti->mtime = mtime;
+	return ti;
+}
+
+int cache_replace_ti(struct track_info *old, struct track_info *new_ti)
+{
+	if (ti_hash_lookup(&cache_hash, old->filename, old->hash) != old)
+		return 0;
+
+	cache_remove_ti(old);
+	if (new_ti) {
+		track_info_ref(new_ti);
+		add_ti(new_ti);
+		new++;
+	}
+	return 1;
+}
+
+struct track_info **cache_get_estimated(int *count)
+{
+	struct track_info **tis = NULL;
+	int i, c = 0, size = 0;
+
+	for (i = 0; i < cache_hash.size; i++) {
+		struct track_info *ti = cache_hash.slots[i];
+
+		if (ti && ti->duration_estimated) {
+			if (c == size) {
+				size = size ? size * 2 : 32;
+				tis = xrenew(struct track_info *, tis, size);
+			}
+			track_info_ref(ti);
+			tis[c++] = ti;
+		}
+	}
+	*count = c;
+	return tis;
+}
+
+int cache_scan_ti(struct track_info *ti)
+{
+	struct input_plugin *ip;
+	const char *seek_idx;
+	int rc, size, duration;
+
+	cache_lock();
+	rc = ti->duration_estimated;
+	cache_unlock();
+	if (!rc)
+		return 0;
+
+	ip = ip_new(ti->filename);
+	ip_set_exact(ip);
+	rc = ip_open(ip);
+	if (rc) {
+		ip_delete(ip);
+
+		/* don't try again */
+		cache_lock();
+		ti->duration_estimated = 0;
+		updated++;
+		cache_unlock();
+		return rc;
+	}
+	duration = ip_duration(ip);
+	seek_idx = ip_get_seek_idx(ip, &size);
+
+	cache_lock();
+	/* the views read the duration under editable_lock */
+	editable_lock();
+	if (ti->duration != duration) {
+		ti->duration = duration;
+		editable_durations_changed = 1;
+	}
+	editable_unlock();
+	if (seek_idx) {
+		free(ti->seek_idx);
+		ti->seek_idx = xmalloc(size);
+		memcpy(ti->seek_idx, seek_idx, size);
+		ti->seek_idx_size = size;
+	}
+	ti->duration_estimated = 0;
+	updated++;
+	cache_unlock();
+
+	ip_delete(ip);
+	return 0;
+}
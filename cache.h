@@ -10,9 +10,53 @@ extern pthread_mutex_t cache_mutex;
 #define cache_unlock() cmus_mutex_unlock(&cache_mutex)
 
 int cache_init(void);
+/* use @filename instead of ~/.cmus/cache, call before cache_init() */
+void cache_set_filename(const char *filename);
 int cache_close(void);
+/* NULL before cache_init() */
+const char *cache_get_filename(void);
+/* cache must be locked, the lock is dropped while reading a new file */
 struct track_info *cache_get_ti(const char *filename);
 void cache_remove_ti(struct track_info *ti);
-struct track_info **cache_refresh(int *count);
+
+/* threads reading tags for cache_get_tis(), kept for a whole job */
+struct read_pool;
+
+struct read_pool *read_pool_new(void);
+void read_pool_free(struct read_pool *p);
+
+/*
+ * cache_get_ti() for many files, call without cache lock
+ *
+ * cached files are looked up with one lock, tags of the rest are read by
+ * the threads of @p and the caller without the lock.
+ *
+ * @tis:     referenced track_infos or NULL, in the order of @filenames
+ * @cancel:  polled between files, files not read yet get NULL if it
+ *           returns non-zero.  can be NULL
+ */
+void cache_get_tis(struct read_pool *p, char * const *filenames, int nr,
+		struct track_info **tis, int (*cancel)(void));
+
+/* all tracks in the cache, referenced and sorted by filename */
+struct track_info **cache_get_all(int *count);
+
+/* read tags of a changed file, call without cache lock */
+struct track_info *cache_read_ti(const char *filename, time_t mtime);
+
+/*
+ * replace @old with @new_ti (NULL if the file is gone)
+ * returns 0 if @old is not in the cache anymore
+ */
+int cache_replace_ti(struct track_info *old, struct track_info *new_ti);
+
+/* referenced tracks whose duration is only estimated */
+struct track_info **cache_get_estimated(int *count);
+
+/*
+ * decode whole file to get exact duration and seek index of @ti
+ * slow, call without cache lock
+ */
+int cache_scan_ti(struct track_info *ti);
 
 #endif
@@ -14,11 +14,13 @@
 #include "options.h"
 #include "xmalloc.h"
 #include "xstrjoin.h"
+#include "gbuf.h"
 #include "debug.h"
 #include "load_dir.h"
 #include "ui_curses.h"
 #include "cache.h"
 #include "dbus-server.h"
+#include "watch.h"
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -27,17 +29,30 @@
 #include <dirent.h>
 #include <stdlib.h>
 #include <ctype.h>
+#include <errno.h>
 
 static char **playable_exts;
 static const char * const playlist_exts[] = { "m3u", "pl", "pls", NULL };
 
-int cmus_init(void)
+void cmus_init_playable(void)
 {
 	playable_exts = ip_get_supported_extensions();
+}
+
+int cmus_init(void)
+{
+	cmus_init_playable();
 	cache_init();
 	worker_init();
+	/* what the user is waiting for first, background scans last */
+	worker_set_priority(JOB_TYPE_QUEUE, WORKER_PRIO_HIGH);
+	worker_set_priority(JOB_TYPE_PL, WORKER_PRIO_HIGH);
+	worker_set_priority(JOB_TYPE_LIB, WORKER_PRIO_NORMAL);
+	worker_set_priority(JOB_TYPE_SCAN, WORKER_PRIO_LOW);
 	play_queue_init();
 
+	cmus_scan_durations();
+
 	cmus_dbus_start();
 
 	return 0;
@@ -47,6 +62,7 @@ void cmus_exit(void)
 {
 	cmus_dbus_stop();
 
+	watch_exit();
 	worker_remove_jobs(JOB_TYPE_ANY);
 	worker_exit();
 	if (cache_close())
@@ -151,34 +167,99 @@ void cmus_add(add_ti_cb add, const char *name, enum file_type ft, int jt)
 
 	data->add = add;
 	data->name = xstrdup(name);
+	data->names = NULL;
 	data->type = ft;
+	data->ti_buffer_fill = 0;
+	data->scan_data = NULL;
+	data->read_pool = NULL;
 	worker_add_job(jt, do_add_job, free_add_job, data);
 }
 
-static int save_playlist_cb(void *data, struct track_info *ti)
+void cmus_add_many(add_ti_cb add, char **names, int jt)
 {
-	int fd = *(int *)data;
-	const char nl = '\n';
-	int rc;
+	struct add_data *data = xnew(struct add_data, 1);
 
-	rc = write_all(fd, ti->filename, strlen(ti->filename));
-	if (rc == -1)
-		return -1;
-	rc = write_all(fd, &nl, 1);
-	if (rc == -1)
-		return -1;
+	data->add = add;
+	data->name = NULL;
+	data->names = names;
+	data->type = FILE_TYPE_INVALID;
+	data->ti_buffer_fill = 0;
+	data->scan_data = NULL;
+	data->read_pool = NULL;
+	worker_add_job(jt, do_add_job, free_add_job, data);
+}
+
+void cmus_load_lib(const char *filename)
+{
+	struct add_data *data = xnew(struct add_data, 1);
+
+	data->add = lib_add_track;
+	data->name = xstrdup(filename);
+	data->names = NULL;
+	data->type = FILE_TYPE_PL;
+	data->ti_buffer_fill = 0;
+	data->scan_data = NULL;
+	data->read_pool = NULL;
+	worker_add_job(JOB_TYPE_LIB, do_load_lib_job, free_add_job, data);
+}
+
+static int save_snapshot_cb(void *data, struct track_info *ti)
+{
+	track_info_ref(ti);
+	ptr_array_add(data, ti);
 	return 0;
 }
 
-int cmus_save(for_each_ti_cb for_each_ti, const char *filename)
+void cmus_save_snapshot(struct ptr_array *tis, for_each_ti_cb for_each_ti)
+{
+	for_each_ti(save_snapshot_cb, tis);
+}
+
+void cmus_save_snapshot_free(struct ptr_array *tis)
 {
-	int fd, rc;
+	struct track_info **ptrs = tis->ptrs;
+	int i;
+
+	for (i = 0; i < tis->count; i++)
+		track_info_unref(ptrs[i]);
+	free(ptrs);
+	tis->ptrs = NULL;
+	tis->alloc = 0;
+	tis->count = 0;
+}
+
+int cmus_save_tis(struct ptr_array *tis, int (*cmp)(const void *a, const void *b),
+		const char *filename)
+{
+	struct track_info **ptrs;
+	struct atomic_file f;
+	int i;
 
-	fd = open(filename, O_CREAT | O_WRONLY | O_TRUNC, 0666);
-	if (fd == -1)
+	/* sort to speed up playlist loading */
+	if (cmp)
+		ptr_array_sort(tis, cmp);
+	ptrs = tis->ptrs;
+
+	if (atomic_file_open(&f, filename))
 		return -1;
-	rc = for_each_ti(save_playlist_cb, &fd);
-	close(fd);
+	for (i = 0; i < tis->count; i++) {
+		gbuf_add_str(&f.buf, ptrs[i]->filename);
+		gbuf_add_ch(&f.buf, '\n');
+		if (atomic_file_flush(&f))
+			break;
+	}
+	return atomic_file_close(&f);
+}
+
+int cmus_save(for_each_ti_cb for_each_ti, int (*cmp)(const void *a, const void *b),
+		const char *filename)
+{
+	PTR_ARRAY(tis);
+	int rc;
+
+	cmus_save_snapshot(&tis, for_each_ti);
+	rc = cmus_save_tis(&tis, cmp, filename);
+	cmus_save_snapshot_free(&tis);
 	return rc;
 }
 
@@ -232,6 +313,30 @@ void cmus_update_tis(struct track_info **tis, int nr)
 	worker_add_job(JOB_TYPE_LIB, do_update_job, free_update_job, data);
 }
 
+void cmus_watch_lib(void)
+{
+	worker_add_job(JOB_TYPE_LIB, do_watch_lib_job, free_watch_lib_job, NULL);
+}
+
+void cmus_scan_durations(void)
+{
+	struct update_data *data;
+	struct track_info **tis;
+	int count;
+
+	cache_lock();
+	tis = cache_get_estimated(&count);
+	cache_unlock();
+	if (!count)
+		return;
+
+	data = xnew(struct update_data, 1);
+	data->size = count;
+	data->used = count;
+	data->ti = tis;
+	worker_add_job(JOB_TYPE_SCAN, do_scan_job, free_scan_job, data);
+}
+
 static const char *get_ext(const char *filename)
 {
 	const char *ext = strrchr(filename, '.');
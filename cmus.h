@@ -2,6 +2,7 @@
 #define _CMUS_H
 
 #include "track_info.h"
+#include "load_dir.h"
 
 /*
  * these types are only used to determine what jobs we should cancel.
@@ -12,6 +13,8 @@
 #define JOB_TYPE_LIB	1
 #define JOB_TYPE_PL	2
 #define JOB_TYPE_QUEUE	3
+/* background scan for exact duration of VBR files */
+#define JOB_TYPE_SCAN	4
 
 enum file_type {
 	/* not found, device file... */
@@ -36,6 +39,11 @@ typedef void (*add_ti_cb)(struct track_info *);
 
 int cmus_init(void);
 void cmus_exit(void);
+/*
+ * file extensions for cmus_is_playable(), call after loading the input
+ * plugins.  done by cmus_init()
+ */
+void cmus_init_playable(void);
 void cmus_play_file(const char *filename);
 
 /* detect file type, returns absolute path or url in @ret */
@@ -52,12 +60,48 @@ enum file_type cmus_detect_ft(const char *name, char **ret);
  */
 void cmus_add(add_ti_cb, const char *name, enum file_type ft, int jt);
 
-int cmus_save(for_each_ti_cb for_each_ti, const char *filename);
+/* like cmus_add() but for many names in one job
+ *
+ * @names  NULL terminated array of playlists, directories, files or URLs,
+ *         freed by the job.  types are detected in the worker thread,
+ *         failures are reported by job_get_add_error()
+ */
+void cmus_add_many(add_ti_cb, char **names, int jt);
+
+/*
+ * loads the library saved in @filename (lib.pl) at startup, from the
+ * library snapshot if it is up to date.  see lib_snapshot.h
+ */
+void cmus_load_lib(const char *filename);
+
+/*
+ * saving is done in three steps so that the editable lock is held only
+ * while the tracks are collected and released again:
+ *
+ * cmus_save_snapshot()       references all tracks, lock held
+ * cmus_save_tis()            sorts with @cmp (can be NULL) and writes the
+ *                            file names to @filename.tmp, which is then
+ *                            renamed to @filename.  no lock needed
+ * cmus_save_snapshot_free()  lock held
+ */
+void cmus_save_snapshot(struct ptr_array *tis, for_each_ti_cb for_each_ti);
+int cmus_save_tis(struct ptr_array *tis, int (*cmp)(const void *a, const void *b),
+		const char *filename);
+void cmus_save_snapshot_free(struct ptr_array *tis);
+
+/* all steps at once, for when no other thread is running */
+int cmus_save(for_each_ti_cb for_each_ti, int (*cmp)(const void *a, const void *b),
+		const char *filename);
 
 void cmus_update_cache(void);
 void cmus_update_lib(void);
 void cmus_update_tis(struct track_info **tis, int nr);
 
+/* get exact duration for tracks in the cache which have estimated duration */
+void cmus_scan_durations(void);
+/* watch directories of all library tracks */
+void cmus_watch_lib(void);
+
 int cmus_is_playlist(const char *filename);
 int cmus_is_playable(const char *filename);
 int cmus_is_supported(const char *filename);
@@ -46,6 +46,7 @@
 #include "list.h"
 #include "debug.h"
 #include "load_dir.h"
+#include "gbuf.h"
 #include "config/datadir.h"
 #include "help.h"
 #include "dbus-server.h"
@@ -194,6 +195,29 @@ void view_add(int view, char *arg, int prepend)
 	free(name);
 }
 
+void view_add_many(int view, char **names, int prepend)
+{
+	switch (view) {
+	case TREE_VIEW:
+	case SORTED_VIEW:
+		cmus_add_many(lib_add_track, names, JOB_TYPE_LIB);
+		break;
+	case PLAYLIST_VIEW:
+		cmus_add_many(pl_add_track, names, JOB_TYPE_PL);
+		break;
+	case QUEUE_VIEW:
+		if (prepend) {
+			cmus_add_many(play_queue_prepend, names, JOB_TYPE_QUEUE);
+		} else {
+			cmus_add_many(play_queue_append, names, JOB_TYPE_QUEUE);
+		}
+		break;
+	default:
+		info_msg(":add-batch only works in views 1-4");
+		free_str_array(names);
+	}
+}
+
 void view_load(int view, char *arg)
 {
 	char *tmp, *name;
@@ -242,9 +266,11 @@ void view_load(int view, char *arg)
 	}
 }
 
-static void do_save(for_each_ti_cb for_each_ti, const char *arg, char **filenamep)
+static void do_save(for_each_ti_cb for_each_ti, int (*cmp)(const void *a, const void *b),
+		const char *arg, char **filenamep)
 {
 	char *filename = *filenamep;
+	PTR_ARRAY(tis);
 
 	if (arg) {
 		free(filename);
@@ -252,9 +278,16 @@ static void do_save(for_each_ti_cb for_each_ti, const char *arg, char **filename
 		*filenamep = filename;
 	}
 
+	/* sorting and writing don't block the worker or player thread */
 	editable_lock();
-	if (cmus_save(for_each_ti, filename) == -1)
+	cmus_save_snapshot(&tis, for_each_ti);
+	editable_unlock();
+
+	if (cmus_save_tis(&tis, cmp, filename) == -1)
 		error_msg("saving '%s': %s", filename, strerror(errno));
+
+	editable_lock();
+	cmus_save_snapshot_free(&tis);
 	editable_unlock();
 }
 
@@ -273,12 +306,12 @@ void view_save(int view, char *arg)
 	case SORTED_VIEW:
 		if (worker_has_job(JOB_TYPE_LIB))
 			goto worker_running;
-		do_save(lib_for_each, arg, &lib_filename);
+		do_save(lib_for_each, lib_ti_cmp, arg, &lib_filename);
 		break;
 	case PLAYLIST_VIEW:
 		if (worker_has_job(JOB_TYPE_PL))
 			goto worker_running;
-		do_save(pl_for_each, arg, &pl_filename);
+		do_save(pl_for_each, NULL, arg, &pl_filename);
 		break;
 	default:
 		info_msg(":save only works in views 1 & 2 (library) and 3 (playlist)");
@@ -366,6 +399,53 @@ static void cmd_add(char *arg)
 	view_add(flag_to_view(flag), arg, flag == 'Q');
 }
 
+/*
+ * add-batch [-l] [-p] [-q] [-Q] NAME<TAB>NAME...
+ *
+ * for cmus-remote, tabs, newlines and backslashes in names are escaped as
+ * \t, \n and \\
+ */
+static void cmd_add_batch(char *arg)
+{
+	int flag = parse_flags((const char **)&arg, "lpqQ");
+	PTR_ARRAY(names);
+	GBUF(name);
+	const char *s;
+
+	/* NULL if only flags were given, nothing to add like an empty list */
+	if (flag == -1 || arg == NULL)
+		return;
+
+	for (s = arg; ; s++) {
+		if (*s == '\t' || *s == 0) {
+			if (name.len) {
+				/* same as view_add(), types are detected by the job */
+				ptr_array_add(&names, expand_filename(name.buffer));
+				gbuf_clear(&name);
+			}
+			if (*s == 0)
+				break;
+		} else if (*s == '\\' && s[1]) {
+			s++;
+			if (*s == 't') {
+				gbuf_add_ch(&name, '\t');
+			} else if (*s == 'n') {
+				gbuf_add_ch(&name, '\n');
+			} else {
+				gbuf_add_ch(&name, *s);
+			}
+		} else {
+			gbuf_add_ch(&name, *s);
+		}
+	}
+	gbuf_free(&name);
+	if (names.count == 0)
+		return;
+
+	ptr_array_add(&names, NULL);
+	view_add_many(flag_to_view(flag), (char **)names.ptrs, flag == 'Q');
+}
+
 static void cmd_clear(char *arg)
 {
 	int flag = parse_flags((const char **)&arg, "lpq");
@@ -706,7 +786,10 @@ err:
 
 static void cmd_quit(char *arg)
 {
-	if (!worker_has_job(JOB_TYPE_ANY) || yes_no_query("Tracks are being added. Quit and truncate playlist(s)? [y/N]"))
+	int adding = worker_has_job(JOB_TYPE_LIB) || worker_has_job(JOB_TYPE_PL) ||
+		worker_has_job(JOB_TYPE_QUEUE);
+
+	if (!adding || !ui_initialized || yes_no_query("Tracks are being added. Quit and truncate playlist(s)? [y/N]"))
 		cmus_running = 0;
 }
 
@@ -1651,6 +1734,9 @@ static void cmd_browser_up(char *arg)
 
 static void cmd_refresh(char *arg)
 {
+	/* no curses in daemon mode */
+	if (!ui_initialized)
+		return;
 	clearok(curscr, TRUE);
 	refresh();
 }
@@ -2318,6 +2404,7 @@ static void expand_colorscheme(const char *str)
 /* sort by name */
 struct command commands[] = {
 	{ "add",		cmd_add,	1, 1, expand_add,	  0, 0 },
+	{ "add-batch",		cmd_add_batch,	1, 1, NULL,		  0, 0 },
 	{ "bind",		cmd_bind,	1, 1, expand_bind_args,	  0, CMD_UNSAFE },
 	{ "browser-up",		cmd_browser_up,	0, 0, NULL,		  0, 0 },
 	{ "cd",			cmd_cd,		0, 1, expand_directories, 0, 0 },
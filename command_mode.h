@@ -57,6 +57,8 @@ struct command *get_command(const char *str);
 
 void view_clear(int view);
 void view_add(int view, char *arg, int prepend);
+/* @names: NULL terminated, freed */
+void view_add_many(int view, char **names, int prepend);
 void view_load(int view, char *arg);
 void view_save(int view, char *arg);
 
@@ -7,6 +7,9 @@
 #include "dbus-api.h"
 #include "command_mode.h"
 #include "output.h"
+#include "job_stats.h"
+#include "gbuf.h"
+#include "query.h"
 
 gboolean
 dbus_cmus_cmd(DBusCmus *obj, char *cmd, int *ret, GError **err)
@@ -14,3 +17,42 @@ dbus_cmus_cmd(DBusCmus *obj, char *cmd, int *ret, GError **err)
 	*ret = run_command(cmd);
 	return TRUE;
 }
+
+/* same "jobs <key> <value>" lines as the status command of cmus-remote */
+gboolean
+dbus_cmus_job_stats(DBusCmus *obj, char **stats, GError **err)
+{
+	GBUF(buf);
+
+	job_stats_format(&buf);
+	*stats = g_strdup(buf.buffer);
+	gbuf_free(&buf);
+	return TRUE;
+}
+
+/* "emitted <n>" and "dropped <n>" lines for the NowPlaying signal */
+gboolean
+dbus_cmus_signal_stats(DBusCmus *obj, char **stats, GError **err)
+{
+	*stats = g_strdup_printf("emitted %u\ndropped %u\n",
+			dbus_signals_emitted, dbus_signals_dropped);
+	return TRUE;
+}
+
+/* one page of tracks, same output as the tracks command of cmus-remote */
+gboolean
+dbus_cmus_tracks(DBusCmus *obj, char *view, guint offset, guint limit,
+		char *fields, char *filter, char **tracks, GError **err)
+{
+	GBUF(buf);
+
+	if (query_tracks(&buf, view, offset, limit, fields, filter)) {
+		g_set_error(err, DBUS_GERROR, DBUS_GERROR_INVALID_ARGS,
+				"invalid view, field list or filter");
+		gbuf_free(&buf);
+		return FALSE;
+	}
+	*tracks = g_strdup(buf.buffer);
+	gbuf_free(&buf);
+	return TRUE;
+}
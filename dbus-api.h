@@ -8,6 +8,10 @@
 #include "dbus-server.h"
 
 gboolean dbus_cmus_cmd(DBusCmus *obj, char *cmd, int *ret, GError **err);
+gboolean dbus_cmus_job_stats(DBusCmus *obj, char **stats, GError **err);
+gboolean dbus_cmus_signal_stats(DBusCmus *obj, char **stats, GError **err);
+gboolean dbus_cmus_tracks(DBusCmus *obj, char *view, guint offset, guint limit,
+		char *fields, char *filter, char **tracks, GError **err);
 
 #endif
 
@@ -17,7 +17,10 @@
 #include "dbus-api.h"
 #include "dbus-bindings.h"
 #include "dbus-marshal.h"
+#include "mpris.h"
 #include "player.h"
+#include "status.h"
+#include "debug.h"
 
 G_DEFINE_TYPE(DBusCmus, cmus, G_TYPE_OBJECT);
 
@@ -95,7 +98,10 @@ cmus_dbus_thread(gpointer data)
 		g_object_unref(obj);
 		return NULL;
 	}
-	
+
+	/* the legacy interface works even if MPRIS2 can't be served */
+	mpris_init(dbus_g_connection_get_connection(connection));
+
 	g_main_loop_run(dbus_loop);
 
 	g_object_unref(obj);
@@ -116,49 +122,72 @@ cmus_dbus_stop(void)
 {
 	g_main_loop_quit(dbus_loop);
 	g_thread_join(dbus_thread);
+	d_print("signals emitted: %u, dropped: %u\n", dbus_signals_emitted,
+			dbus_signals_dropped);
 }
 
 /*
- * Inspired by 
- * http://www.hci-matters.com/blog/2008/05/06/c-music-player-audioscrobblerlastfm-patch/
+ * Signals are emitted by the glib thread so that a slow bus doesn't stall
+ * the player or the UI.  Callers only set a bit for the action, repeated
+ * actions before the glib thread gets to run are sent once with the state
+ * at that time.
  */
+static volatile unsigned int pending_actions = 0;
+
+volatile unsigned int dbus_signals_emitted = 0;
+volatile unsigned int dbus_signals_dropped = 0;
+
+static gboolean
+emit_pending(gpointer data)
+{
+	unsigned int actions = __sync_fetch_and_and(&pending_actions, 0);
+	struct status_snapshot *s;
+	int a;
+
+	if (obj == NULL)
+		return FALSE;
+
+	if (actions & (1 << DBUS_SEEK))
+		mpris_seek_requested();
+
+	s = status_get();
+	for (a = 0; actions; a++) {
+		if (!(actions & (1 << a)))
+			continue;
+		actions &= ~(1 << a);
+		if (s->ti == NULL)
+			continue;
+
+		/*
+		 * Inspired by
+		 * http://www.hci-matters.com/blog/2008/05/06/c-music-player-audioscrobblerlastfm-patch/
+		 */
+		g_signal_emit(obj,
+			sig_num, 0,
+			a,
+			s->artist ? s->artist : "",
+			s->title ? s->title : "",
+			s->album ? s->album : "",
+			s->tracknumber ? atoi(s->tracknumber) : 0,
+			s->duration,
+			s->pos);
+		__sync_add_and_fetch(&dbus_signals_emitted, 1);
+	}
+	status_put(s);
+	return FALSE;
+}
+
 void
 cmus_dbus_hook(enum dbus_actions a)
 {
-	const char *artist, *album, *track_name, *tn;
-	int secs, pos;
+	unsigned int bit = 1 << a;
+	unsigned int old = __sync_fetch_and_or(&pending_actions, bit);
 
-	player_info_lock();
-	if (player_info.ti == NULL) {
-		player_info_unlock();
+	if (old & bit) {
+		/* coalesced with the pending one */
+		__sync_add_and_fetch(&dbus_signals_dropped, 1);
 		return;
 	}
-	album = keyvals_get_val(player_info.ti->comments, "album");
-	if (!album)
-		album = "";
-	artist = keyvals_get_val(player_info.ti->comments, "artist");
-	if (!artist)
-		artist = "";
-	track_name = keyvals_get_val(player_info.ti->comments, "title");
-	if (!track_name)
-		track_name = "";
-	tn = keyvals_get_val(player_info.ti->comments, "tracknumber");
-	if (!tn)
-		tn = "0";
-
-	secs = player_info.ti->duration;
-	pos = player_info.pos;
-
-	/* Sending the Now Playing Signal */
-	g_signal_emit(obj,
-		sig_num, 0,
-		a,
-		artist,
-		track_name,
-		album,
-		atoi(tn),
-		secs,
-		pos);
-	
-	player_info_unlock();
+	if (old == 0)
+		g_idle_add(emit_pending, NULL);
 }
@@ -30,7 +30,12 @@ typedef struct {
 } DBusCmusClass;
 
 
+/* NowPlaying signals sent and merged with an earlier pending one */
+extern volatile unsigned int dbus_signals_emitted;
+extern volatile unsigned int dbus_signals_dropped;
+
 GType cmus_get_type(void);
+/* queues a signal, can be called from any thread */
 void cmus_dbus_hook(enum dbus_actions);
 void cmus_dbus_start(void);
 void cmus_dbus_stop(void);
@@ -0,0 +1,493 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "dir_walk.h"
+#include "load_dir.h"
+#include "locking.h"
+#include "list.h"
+#include "gbuf.h"
+#include "path.h"
+#include "xmalloc.h"
+#include "debug.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <stdint.h>
+
+/* glibc doesn't always have a getdents64() wrapper */
+struct linux_dirent64 {
+	uint64_t d_ino;
+	int64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+#define GETDENTS_BUF_SIZE (64 * 1024)
+#endif
+
+/* mode from d_type, 0 if unknown */
+#ifdef DTTOIF
+#define D_TYPE_MODE(type) DTTOIF(type)
+#else
+#define D_TYPE_MODE(type) 0
+#endif
+
+#define NR_WALK_THREADS 4
+
+enum {
+	WD_QUEUED,
+	WD_LISTING,
+	WD_DONE
+};
+
+struct walk_dir {
+	/* in dir_walk.queue while WD_QUEUED */
+	struct list_head node;
+	int state;
+
+	char *path;
+
+	/* sorted, set when state is WD_DONE */
+	struct dir_entry **ents;
+	int nr_ents;
+};
+
+struct walk_frame {
+	struct walk_dir *dir;
+	/* queued sub-directories, indexed like dir->ents */
+	struct walk_dir **subdirs;
+	int pos;
+};
+
+struct dir_walk {
+	char *root;
+	int reverse;
+	void (*dir_cb)(const char *dir);
+
+	/* protects queue, quit and walk_dir.state */
+	pthread_mutex_t mutex;
+	pthread_cond_t queue_cond;
+	pthread_cond_t done_cond;
+	struct list_head queue;
+	int quit;
+	/* files in listed directories */
+	int nr_found;
+
+	pthread_t threads[NR_WALK_THREADS];
+	int nr_threads;
+
+	/* used only by the thread calling dir_walk_next() */
+	struct walk_frame *stack;
+	int depth;
+	int stack_alloc;
+	struct gbuf path;
+};
+
+#define walk_lock(w) cmus_mutex_lock(&(w)->mutex)
+#define walk_unlock(w) cmus_mutex_unlock(&(w)->mutex)
+
+static int dir_entry_cmp(const void *ap, const void *bp)
+{
+	struct dir_entry *a = *(struct dir_entry **)ap;
+	struct dir_entry *b = *(struct dir_entry **)bp;
+
+	return strcmp(a->name, b->name);
+}
+
+static int dir_entry_cmp_reverse(const void *ap, const void *bp)
+{
+	struct dir_entry *a = *(struct dir_entry **)ap;
+	struct dir_entry *b = *(struct dir_entry **)bp;
+
+	return strcmp(b->name, a->name);
+}
+
+static int points_within(const char *target, const char *root)
+{
+	int tlen = strlen(target);
+	int rlen = strlen(root);
+
+	if (rlen > tlen)
+		return 0;
+	if (strncmp(target, root, rlen))
+		return 0;
+	/* root can be "/" */
+	return root[rlen - 1] == '/' || target[rlen] == '/' || !target[rlen];
+}
+
+static char *join_path(const char *dir, const char *name)
+{
+	int dlen = strlen(dir);
+	int nlen = strlen(name);
+	char *str = xnew(char, dlen + 1 + nlen + 1);
+
+	memcpy(str, dir, dlen);
+	/* "/" + "name" must not become "//name" */
+	if (dlen == 0 || dir[dlen - 1] != '/')
+		str[dlen++] = '/';
+	memcpy(str + dlen, name, nlen + 1);
+	return str;
+}
+
+static int link_points_within(struct dir_walk *w, struct walk_dir *wd,
+		int fd, const char *name)
+{
+	char buf[1024];
+	char *target;
+	int rc;
+
+	rc = readlinkat(fd, name, buf, sizeof(buf));
+	if (rc < 0 || rc == sizeof(buf))
+		return 1;
+	buf[rc] = 0;
+
+	target = path_absolute_cwd(buf, wd->path);
+	rc = points_within(target, w->root);
+	if (rc) {
+		/* symlink points withing the root */
+		d_print("%s/%s -> %s points within %s. ignoring\n",
+				wd->path, name, target, w->root);
+	}
+	free(target);
+	return rc;
+}
+
+/* @mode is from d_type, 0 if unknown */
+static void add_entry(struct dir_walk *w, struct walk_dir *wd, int fd,
+		const char *name, mode_t mode, struct ptr_array *array)
+{
+	struct dir_entry *ent;
+	struct stat st;
+	int size;
+
+	/* hidden files, "." and ".." */
+	if (name[0] == '.')
+		return;
+
+	if (mode == 0) {
+		if (fstatat(fd, name, &st, AT_SYMLINK_NOFOLLOW))
+			return;
+		mode = st.st_mode;
+	}
+	if (S_ISLNK(mode)) {
+		/* argh. must stat the target */
+		if (fstatat(fd, name, &st, 0))
+			return;
+		if (link_points_within(w, wd, fd, name))
+			return;
+		mode = st.st_mode;
+	}
+
+	size = strlen(name) + 1;
+	ent = xmalloc(sizeof(struct dir_entry) + size);
+	ent->mode = mode;
+	memcpy(ent->name, name, size);
+	ptr_array_add(array, ent);
+}
+
+/* can be run in any thread, doesn't touch walk state */
+static void list_dir(struct dir_walk *w, struct walk_dir *wd)
+{
+	PTR_ARRAY(array);
+	int fd;
+
+	fd = open(wd->path, O_RDONLY | O_DIRECTORY);
+	if (fd == -1) {
+		d_print("error: opening %s: %s\n", wd->path, strerror(errno));
+		goto out;
+	}
+
+#ifdef __linux__
+	{
+		char *buf = xnew(char, GETDENTS_BUF_SIZE);
+
+		while (1) {
+			int pos, rc;
+
+			rc = syscall(SYS_getdents64, fd, buf, GETDENTS_BUF_SIZE);
+			if (rc == -1 && errno == EINTR)
+				continue;
+			if (rc <= 0)
+				break;
+
+			for (pos = 0; pos < rc; ) {
+				struct linux_dirent64 *de = (struct linux_dirent64 *)(buf + pos);
+
+				add_entry(w, wd, fd, de->d_name, D_TYPE_MODE(de->d_type), &array);
+				pos += de->d_reclen;
+			}
+		}
+		free(buf);
+		close(fd);
+	}
+#else
+	{
+		DIR *d = fdopendir(fd);
+		struct dirent *de;
+
+		if (!d) {
+			close(fd);
+			goto out;
+		}
+		while ((de = readdir(d)))
+			add_entry(w, wd, fd, de->d_name, D_TYPE_MODE(de->d_type), &array);
+		closedir(d);
+	}
+#endif
+
+	if (w->reverse) {
+		ptr_array_sort(&array, dir_entry_cmp_reverse);
+	} else {
+		ptr_array_sort(&array, dir_entry_cmp);
+	}
+out:
+	wd->ents = array.ptrs;
+	wd->nr_ents = array.count;
+}
+
+/* walk must be locked */
+static void walk_listed(struct dir_walk *w, struct walk_dir *wd)
+{
+	int i;
+
+	for (i = 0; i < wd->nr_ents; i++) {
+		if (!S_ISDIR(wd->ents[i]->mode))
+			w->nr_found++;
+	}
+	wd->state = WD_DONE;
+}
+
+static void *walk_thread(void *arg)
+{
+	struct dir_walk *w = arg;
+
+	walk_lock(w);
+	while (!w->quit) {
+		struct walk_dir *wd;
+
+		if (list_empty(&w->queue)) {
+			pthread_cond_wait(&w->queue_cond, &w->mutex);
+			continue;
+		}
+
+		wd = container_of(w->queue.next, struct walk_dir, node);
+		list_del(&wd->node);
+		wd->state = WD_LISTING;
+		walk_unlock(w);
+
+		list_dir(w, wd);
+
+		walk_lock(w);
+		walk_listed(w, wd);
+		pthread_cond_broadcast(&w->done_cond);
+	}
+	walk_unlock(w);
+	return NULL;
+}
+
+static struct walk_dir *walk_dir_new(char *path)
+{
+	struct walk_dir *wd = xnew(struct walk_dir, 1);
+
+	wd->state = WD_QUEUED;
+	wd->path = path;
+	wd->ents = NULL;
+	wd->nr_ents = 0;
+	return wd;
+}
+
+static void walk_dir_free(struct walk_dir *wd)
+{
+	int i;
+
+	for (i = 0; i < wd->nr_ents; i++)
+		free(wd->ents[i]);
+	free(wd->ents);
+	free(wd->path);
+	free(wd);
+}
+
+static void walk_wait(struct dir_walk *w, struct walk_dir *wd)
+{
+	walk_lock(w);
+	if (wd->state == WD_QUEUED) {
+		/* no thread got to it yet */
+		list_del(&wd->node);
+		wd->state = WD_LISTING;
+		walk_unlock(w);
+
+		list_dir(w, wd);
+
+		walk_lock(w);
+		walk_listed(w, wd);
+	}
+	while (wd->state != WD_DONE)
+		pthread_cond_wait(&w->done_cond, &w->mutex);
+	walk_unlock(w);
+}
+
+/* @wd must be listed */
+static void walk_push(struct dir_walk *w, struct walk_dir *wd)
+{
+	struct walk_frame *f;
+	int i;
+
+	if (w->depth == w->stack_alloc) {
+		w->stack_alloc = w->stack_alloc * 2 + 8;
+		w->stack = xrenew(struct walk_frame, w->stack, w->stack_alloc);
+	}
+	if (w->dir_cb)
+		w->dir_cb(wd->path);
+
+	f = &w->stack[w->depth++];
+	f->dir = wd;
+	f->subdirs = xnew0(struct walk_dir *, wd->nr_ents);
+	f->pos = 0;
+
+	for (i = 0; i < wd->nr_ents; i++) {
+		if (S_ISDIR(wd->ents[i]->mode))
+			f->subdirs[i] = walk_dir_new(join_path(wd->path, wd->ents[i]->name));
+	}
+
+	/* first sub-directory is needed first, queue it at the head */
+	walk_lock(w);
+	for (i = wd->nr_ents - 1; i >= 0; i--) {
+		if (f->subdirs[i])
+			list_add(&f->subdirs[i]->node, &w->queue);
+	}
+	pthread_cond_broadcast(&w->queue_cond);
+	walk_unlock(w);
+}
+
+/* worker threads must not be running or nothing may be queued */
+static void walk_pop(struct dir_walk *w)
+{
+	struct walk_frame *f = &w->stack[--w->depth];
+	int i;
+
+	for (i = 0; i < f->dir->nr_ents; i++) {
+		if (f->subdirs[i])
+			walk_dir_free(f->subdirs[i]);
+	}
+	free(f->subdirs);
+	walk_dir_free(f->dir);
+}
+
+struct dir_walk *dir_walk_new(const char *root, int reverse,
+		void (*dir_cb)(const char *dir))
+{
+	struct dir_walk *w = xnew(struct dir_walk, 1);
+	struct walk_dir *wd;
+	int i;
+
+	w->root = xstrdup(root);
+	w->reverse = reverse;
+	w->dir_cb = dir_cb;
+	pthread_mutex_init(&w->mutex, NULL);
+	pthread_cond_init(&w->queue_cond, NULL);
+	pthread_cond_init(&w->done_cond, NULL);
+	list_init(&w->queue);
+	w->quit = 0;
+	w->nr_found = 0;
+	w->stack = NULL;
+	w->depth = 0;
+	w->stack_alloc = 0;
+	w->path.buffer = gbuf_empty_buffer;
+	w->path.alloc = 0;
+	w->path.len = 0;
+
+	w->nr_threads = 0;
+	for (i = 0; i < NR_WALK_THREADS; i++) {
+		int rc = pthread_create(&w->threads[w->nr_threads], NULL, walk_thread, w);
+
+		if (rc) {
+			/* dir_walk_next() lists the directories itself */
+			d_print("pthread_create: %s\n", strerror(rc));
+			break;
+		}
+		w->nr_threads++;
+	}
+
+	wd = walk_dir_new(xstrdup(root));
+	list_dir(w, wd);
+	walk_lock(w);
+	walk_listed(w, wd);
+	walk_unlock(w);
+	walk_push(w, wd);
+	return w;
+}
+
+const char *dir_walk_next(struct dir_walk *w)
+{
+	while (w->depth) {
+		struct walk_frame *f = &w->stack[w->depth - 1];
+		struct walk_dir *wd = f->dir;
+		struct walk_dir *sub;
+		int i;
+
+		if (f->pos == wd->nr_ents) {
+			walk_pop(w);
+			continue;
+		}
+
+		i = f->pos++;
+		sub = f->subdirs[i];
+		if (sub) {
+			f->subdirs[i] = NULL;
+			walk_wait(w, sub);
+			walk_push(w, sub);
+			continue;
+		}
+
+		gbuf_clear(&w->path);
+		gbuf_add_str(&w->path, wd->path);
+		if (w->path.len == 0 || w->path.buffer[w->path.len - 1] != '/')
+			gbuf_add_ch(&w->path, '/');
+		gbuf_add_str(&w->path, wd->ents[i]->name);
+		return w->path.buffer;
+	}
+	return NULL;
+}
+
+int dir_walk_found(struct dir_walk *w)
+{
+	int nr;
+
+	walk_lock(w);
+	nr = w->nr_found;
+	walk_unlock(w);
+	return nr;
+}
+
+void dir_walk_free(struct dir_walk *w)
+{
+	int i;
+
+	walk_lock(w);
+	w->quit = 1;
+	pthread_cond_broadcast(&w->queue_cond);
+	walk_unlock(w);
+	for (i = 0; i < w->nr_threads; i++)
+		pthread_join(w->threads[i], NULL);
+
+	while (w->depth)
+		walk_pop(w);
+	free(w->stack);
+	gbuf_free(&w->path);
+	pthread_cond_destroy(&w->queue_cond);
+	pthread_cond_destroy(&w->done_cond);
+	pthread_mutex_destroy(&w->mutex);
+	free(w->root);
+	free(w);
+}
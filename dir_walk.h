@@ -0,0 +1,32 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _DIR_WALK_H
+#define _DIR_WALK_H
+
+struct dir_walk;
+
+/*
+ * Recursive directory walk.  Files are returned in the same order as a
+ * depth-first walk that sorts each directory by name (reverse order if
+ * @reverse is set).  Sub-directories are listed ahead of time by a small
+ * pool of threads.
+ *
+ * Hidden files and symlinks pointing within @root are skipped.
+ *
+ * @dir_cb, if not NULL, is called for every directory entered.
+ */
+struct dir_walk *dir_walk_new(const char *root, int reverse,
+		void (*dir_cb)(const char *dir));
+
+/* returns next file or NULL, the string is valid until next call */
+const char *dir_walk_next(struct dir_walk *w);
+
+/* number of files found so far, including the ones not returned yet */
+int dir_walk_found(struct dir_walk *w);
+
+/* can be called before the walk has finished */
+void dir_walk_free(struct dir_walk *w);
+
+#endif
@@ -13,6 +13,7 @@
 #include "xmalloc.h"
 
 pthread_mutex_t editable_mutex = CMUS_MUTEX_INITIALIZER;
+int editable_durations_changed = 0;
 
 static const struct searchable_ops simple_search_ops = {
 	.get_prev = simple_track_get_prev,
@@ -38,6 +39,7 @@ void editable_init(struct editable *e, void (*free_track)(struct list_head *item
 	e->nr_tracks = 0;
 	e->nr_marked = 0;
 	e->total_time = 0;
+	e->generation = 0;
 	e->sort_keys = xnew(const char *, 1);
 	e->sort_keys[0] = NULL;
 	e->sort_str[0] = 0;
@@ -56,14 +58,15 @@ void editable_add(struct editable *e, struct simple_track *track)
 {
 	sorted_list_add_track(&e->head, track, e->sort_keys);
 	e->nr_tracks++;
-	if (track->info->duration != -1)
-		e->total_time += track->info->duration;
+	e->generation++;
+	track->duration = track->info->duration;
+	if (track->duration != -1)
+		e->total_time += track->duration;
 	window_changed(e->win);
 }
 
 void editable_remove_track(struct editable *e, struct simple_track *track)
 {
-	struct track_info *ti = track->info;
 	struct iter iter;
 
 	editable_track_to_iter(e, track, &iter);
@@ -71,14 +74,34 @@ void editable_remove_track(struct editable *e, struct simple_track *track)
 
 	e->nr_tracks--;
 	e->nr_marked -= track->marked;
-	if (ti->duration != -1)
-		e->total_time -= ti->duration;
+	e->generation++;
+	if (track->duration != -1)
+		e->total_time -= track->duration;
 
 	list_del(&track->node);
 
 	e->free_track(&track->node);
 }
 
+void editable_update_durations(struct editable *e)
+{
+	struct simple_track *t;
+	int changed = 0;
+
+	list_for_each_entry(t, &e->head, node) {
+		if (t->duration == t->info->duration)
+			continue;
+		if (t->duration != -1)
+			e->total_time -= t->duration;
+		t->duration = t->info->duration;
+		if (t->duration != -1)
+			e->total_time += t->duration;
+		changed = 1;
+	}
+	if (changed)
+		window_changed(e->win);
+}
+
 void editable_remove_sel(struct editable *e)
 {
 	struct simple_track *t;
@@ -115,6 +138,7 @@ void editable_sort(struct editable *e)
 {
 	sort_keys = e->sort_keys;
 	list_mergesort(&e->head, list_cmp);
+	e->generation++;
 	window_changed(e->win);
 	window_goto_top(e->win);
 }
@@ -171,6 +195,7 @@ static void move_item(struct editable *e, struct list_head *head, struct list_he
 
 	list_del(item);
 	list_add(item, head);
+	e->generation++;
 }
 
 static void move_sel(struct editable *e, struct list_head *after)
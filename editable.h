@@ -16,6 +16,8 @@ struct editable {
 	unsigned int nr_tracks;
 	unsigned int nr_marked;
 	unsigned int total_time;
+	/* increased when a track is added, removed or moved */
+	unsigned int generation;
 	const char **sort_keys;
 	char sort_str[128];
 	struct searchable *searchable;
@@ -25,10 +27,18 @@ struct editable {
 
 extern pthread_mutex_t editable_mutex;
 
+/*
+ * set when the duration of a track_info changes, protected by
+ * editable_lock().  call editable_update_durations() for every editable
+ */
+extern int editable_durations_changed;
+
 void editable_init(struct editable *e, void (*free_track)(struct list_head *item));
 void editable_add(struct editable *e, struct simple_track *track);
 void editable_remove_track(struct editable *e, struct simple_track *track);
 void editable_remove_sel(struct editable *e);
+/* adds changed track durations to total_time */
+void editable_update_durations(struct editable *e);
 void editable_sort(struct editable *e);
 void editable_set_sort_keys(struct editable *e, const char **keys);
 void editable_toggle_mark(struct editable *e);
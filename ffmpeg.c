@@ -335,11 +335,9 @@ static int set_comment(struct keyval *comment, int i, const char *key, const cha
 	return i + 1;
 }
 
-static int ffmpeg_read_comments(struct input_plugin_data *ip_data, struct keyval **comments)
+static void get_comments(AVFormatContext *ic, struct keyval **comments)
 {
 	char buff[16];
-	struct ffmpeg_private *priv = ip_data->private;
-	AVFormatContext *ic = priv->input_context;
 	int i = 0;
 
 	*comments = xnew0(struct keyval, NUM_FFMPEG_KEYS + 1);
@@ -358,7 +356,13 @@ static int ffmpeg_read_comments(struct input_plugin_data *ip_data, struct keyval
 		snprintf(buff, sizeof(buff), "%d", ic->track);
 		i = set_comment(*comments, i, "tracknumber", buff);
 	}
+}
+
+static int ffmpeg_read_comments(struct input_plugin_data *ip_data, struct keyval **comments)
+{
+	struct ffmpeg_private *priv = ip_data->private;
 
+	get_comments(priv->input_context, comments);
 	return 0;
 }
 
@@ -368,13 +372,42 @@ static int ffmpeg_duration(struct input_plugin_data *ip_data)
 	return priv->input_context->duration / 1000000L;
 }
 
+/*
+ * av_find_stream_info() decodes packets, skip it.  the duration is
+ * usually in the container header (ASF), otherwise ffmpeg_open() is used
+ */
+static int ffmpeg_read_info(struct input_plugin_data *ip_data,
+		struct keyval **comments, int *duration)
+{
+	AVFormatContext *ic;
+	int err;
+
+	ffmpeg_init();
+
+	err = av_open_input_file(&ic, ip_data->filename, NULL, 0, NULL);
+	if (err < 0) {
+		d_print("av_open failed: %d\n", err);
+		return -IP_ERROR_FILE_FORMAT;
+	}
+	if (ic->duration == AV_NOPTS_VALUE || ic->duration <= 0) {
+		av_close_input_file(ic);
+		return -IP_ERROR_FUNCTION_NOT_SUPPORTED;
+	}
+
+	get_comments(ic, comments);
+	*duration = ic->duration / 1000000L;
+	av_close_input_file(ic);
+	return 0;
+}
+
 const struct input_plugin_ops ip_ops = {
 	.open = ffmpeg_open,
 	.close = ffmpeg_close,
 	.read = ffmpeg_read,
 	.seek = ffmpeg_seek,
 	.read_comments = ffmpeg_read_comments,
-	.duration = ffmpeg_duration
+	.duration = ffmpeg_duration,
+	.read_info = ffmpeg_read_info
 };
 
 const char *const ip_extensions[] = { "wma", NULL };
@@ -26,8 +26,13 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <errno.h>
 
+/* atomic_file buffer is written in chunks of this size */
+#define ATOMIC_FILE_CHUNK (64 * 1024)
+
 ssize_t read_all(int fd, void *buf, size_t count)
 {
 	char *buffer = buf;
@@ -184,3 +189,67 @@ int file_for_each_line(const char *filename,
 	}
 	return 0;
 }
+
+int atomic_file_open(struct atomic_file *f, const char *filename)
+{
+	int size = strlen(filename) + 5;
+
+	/* same directory, rename() can't cross filesystems */
+	f->tmp = xnew(char, size);
+	snprintf(f->tmp, size, "%s.tmp", filename);
+	f->fd = open(f->tmp, O_CREAT | O_WRONLY | O_TRUNC, 0666);
+	if (f->fd == -1) {
+		free(f->tmp);
+		return -1;
+	}
+	f->filename = xstrdup(filename);
+	f->error = 0;
+	f->buf.buffer = gbuf_empty_buffer;
+	f->buf.alloc = 0;
+	f->buf.len = 0;
+	gbuf_grow(&f->buf, ATOMIC_FILE_CHUNK);
+	return 0;
+}
+
+static void write_buf(struct atomic_file *f)
+{
+	if (!f->error && write_all(f->fd, f->buf.buffer, f->buf.len) == -1)
+		f->error = errno;
+	gbuf_clear(&f->buf);
+}
+
+int atomic_file_flush(struct atomic_file *f)
+{
+	if (f->buf.len >= ATOMIC_FILE_CHUNK)
+		write_buf(f);
+	return f->error ? -1 : 0;
+}
+
+int atomic_file_close(struct atomic_file *f)
+{
+	int rc = 0;
+
+	if (f->buf.len)
+		write_buf(f);
+	gbuf_free(&f->buf);
+
+	if (f->error) {
+		errno = f->error;
+		rc = -1;
+	}
+	if (rc == 0)
+		rc = fsync(f->fd);
+	if (close(f->fd) && rc == 0)
+		rc = -1;
+	if (rc == 0)
+		rc = rename(f->tmp, f->filename);
+	if (rc) {
+		int saved_errno = errno;
+
+		unlink(f->tmp);
+		errno = saved_errno;
+	}
+	free(f->tmp);
+	free(f->filename);
+	return rc ? -1 : 0;
+}
@@ -20,6 +20,8 @@
 #ifndef _FILE_H
 #define _FILE_H
 
+#include "gbuf.h"
+
 #include <unistd.h>
 #include <sys/mman.h>
 
@@ -43,4 +45,31 @@ int file_for_each_line(const char *filename,
 		int (*cb)(void *data, const char *line),
 		void *data);
 
+/*
+ * Replaces a file atomically.  Data is written to FILENAME.tmp in the
+ * same directory and renamed over @filename when the file is complete,
+ * the old file is kept if anything fails.
+ */
+struct atomic_file {
+	char *filename;
+	char *tmp;
+	int fd;
+	/* errno of the first failed write, 0 if none */
+	int error;
+	/* append here, written out in chunks by atomic_file_flush() */
+	struct gbuf buf;
+};
+
+/* returns -1 and sets errno if the temporary file can't be created */
+int atomic_file_open(struct atomic_file *f, const char *filename);
+
+/* writes f->buf if it is full.  returns -1 if any write has failed */
+int atomic_file_flush(struct atomic_file *f);
+
+/*
+ * writes the rest of f->buf, syncs and renames the file over the old
+ * one.  frees @f, returns -1 and sets errno on failure
+ */
+int atomic_file_close(struct atomic_file *f);
+
 #endif
@@ -273,6 +273,28 @@ static FLAC__StreamDecoderWriteStatus write_cb(const Dec *dec, const FLAC__Frame
 	return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
 
+static struct keyval *get_comments(const FLAC__StreamMetadata *metadata)
+{
+	GROWING_KEYVALS(c);
+	int i, nr;
+
+	nr = metadata->data.vorbis_comment.num_comments;
+	for (i = 0; i < nr; i++) {
+		const char *str = metadata->data.vorbis_comment.comments[i].entry;
+		char *key, *val;
+
+		val = strchr(str, '=');
+		if (!val)
+			continue;
+		key = xstrndup(str, val - str);
+		val = xstrdup(val + 1);
+		comments_add(&c, key, val);
+		free(key);
+	}
+	keyvals_terminate(&c);
+	return c.keyvals;
+}
+
 /* You should make a copy of metadata with FLAC__metadata_object_clone() if you will
  * need it elsewhere. Since metadata blocks can potentially be large, by
  * default the decoder only calls the metadata callback for the STREAMINFO
@@ -318,24 +340,7 @@ static void metadata_cb(const Dec *dec, const FLAC__StreamMetadata *metadata, vo
 		if (priv->comments) {
 			d_print("Ignoring\n");
 		} else {
-			GROWING_KEYVALS(c);
-			int i, nr;
-
-			nr = metadata->data.vorbis_comment.num_comments;
-			for (i = 0; i < nr; i++) {
-				const char *str = metadata->data.vorbis_comment.comments[i].entry;
-				char *key, *val;
-
-				val = strchr(str, '=');
-				if (!val)
-					continue;
-				key = xstrndup(str, val - str);
-				val = xstrdup(val + 1);
-				comments_add(&c, key, val);
-				free(key);
-			}
-			keyvals_terminate(&c);
-			priv->comments = c.keyvals;
+			priv->comments = get_comments(metadata);
 		}
 		break;
 	default:
@@ -532,13 +537,59 @@ static int flac_duration(struct input_plugin_data *ip_data)
 	return priv->duration;
 }
 
+/* walks the metadata blocks only, audio frames are never touched */
+static int flac_read_info(struct input_plugin_data *ip_data,
+		struct keyval **comments, int *duration)
+{
+	FLAC__Metadata_SimpleIterator *it;
+
+	it = FLAC__metadata_simple_iterator_new();
+	if (it == NULL)
+		return -IP_ERROR_INTERNAL;
+	if (!FLAC__metadata_simple_iterator_init(it, ip_data->filename, 1, 0)) {
+		FLAC__metadata_simple_iterator_delete(it);
+		return -IP_ERROR_FILE_FORMAT;
+	}
+
+	*comments = NULL;
+	*duration = -1;
+	do {
+		FLAC__MetadataType type = FLAC__metadata_simple_iterator_get_block_type(it);
+		FLAC__StreamMetadata *metadata;
+
+		if (type != FLAC__METADATA_TYPE_STREAMINFO &&
+		    type != FLAC__METADATA_TYPE_VORBIS_COMMENT)
+			continue;
+
+		metadata = FLAC__metadata_simple_iterator_get_block(it);
+		if (metadata == NULL)
+			continue;
+
+		if (type == FLAC__METADATA_TYPE_STREAMINFO) {
+			const FLAC__StreamMetadata_StreamInfo *si = &metadata->data.stream_info;
+
+			if (si->total_samples && si->sample_rate)
+				*duration = si->total_samples / si->sample_rate;
+		} else if (*comments == NULL) {
+			*comments = get_comments(metadata);
+		}
+		FLAC__metadata_object_delete(metadata);
+	} while (FLAC__metadata_simple_iterator_next(it));
+	FLAC__metadata_simple_iterator_delete(it);
+
+	if (*comments == NULL)
+		*comments = xnew0(struct keyval, 1);
+	return 0;
+}
+
 const struct input_plugin_ops ip_ops = {
 	.open = flac_open,
 	.close = flac_close,
 	.read = flac_read,
 	.seek = flac_seek,
 	.read_comments = flac_read_comments,
-	.duration = flac_duration
+	.duration = flac_duration,
+	.read_info = flac_read_info
 };
 
 const char * const ip_extensions[] = { "flac", "fla", NULL };
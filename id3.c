@@ -449,23 +449,6 @@ static int v2_4_0_frame_header_parse(struct v2_frame_header *header, const char
 	return 1;
 }
 
-static int read_all(int fd, char *buf, size_t size)
-{
-	size_t pos = 0;
-
-	while (pos < size) {
-		int rc = read(fd, buf + pos, size - pos);
-
-		if (rc == -1) {
-			if (errno == EINTR || errno == EAGAIN)
-				continue;
-			return -1;
-		}
-		pos += rc;
-	}
-	return 0;
-}
-
 static char *parse_genre(const char *str)
 {
 	int parenthesis = 0;
@@ -507,10 +490,24 @@ static char *parse_genre(const char *str)
 	return xstrdup(str);
 }
 
-/* http://www.id3.org/id3v2.4.0-structure.txt */
+/* how the body of a frame is decoded */
+enum frame_type {
+	FRAME_TEXT,
+	/* key is in the description */
+	FRAME_TXXX,
+	/* language before the text */
+	FRAME_COMMENT
+};
+
+/*
+ * http://www.id3.org/id3v2.4.0-structure.txt
+ *
+ * frames cmus decodes, everything else (APIC, GEOB, PRIV...) is skipped
+ */
 static struct {
 	const char name[8];
 	enum id3_key key;
+	enum frame_type type;
 } frame_tab[] = {
 	/* 2.4.0 */
 	{ "TDRC", ID3_DATE }, // recording date
@@ -539,6 +536,10 @@ static struct {
 	{ "TPA",  ID3_DISC },
 	{ "TRK",  ID3_TRACK },
 
+	{ "TXXX", NUM_ID3_KEYS, FRAME_TXXX },
+	{ "COMM", ID3_COMMENT, FRAME_COMMENT },
+	{ "COM",  ID3_COMMENT, FRAME_COMMENT },
+
 	{ "", -1 }
 };
 
@@ -711,14 +712,18 @@ static void v2_add_frame(struct id3tag *id3, struct v2_frame_header *fh, const c
 		return;
 
 	idx = frame_tab_index(fh->id);
-	if (idx >= 0) {
+	if (idx < 0)
+		return;
+	switch (frame_tab[idx].type) {
+	case FRAME_TEXT:
 		decode_normal(id3, buf, len, encoding, frame_tab[idx].key);
-	} else if (!strncmp(fh->id, "TXXX", 4)) {
+		break;
+	case FRAME_TXXX:
 		decode_txxx(id3, buf, len, encoding);
-	} else if (!strncmp(fh->id, "COMM", 4)) {
-		decode_comment(id3, buf, len, encoding);
-	} else if (!strncmp(fh->id, "COM", 4)) {
+		break;
+	case FRAME_COMMENT:
 		decode_comment(id3, buf, len, encoding);
+		break;
 	}
 }
 
@@ -750,16 +755,70 @@ static void unsync(unsigned char *buf, int *lenp)
 	*lenp = d;
 }
 
-static int v2_read(struct id3tag *id3, int fd, const struct v2_header *header)
+/* frame bodies of one tag may use at most this much memory */
+#define V2_MAX_TAG_MEM (1024 * 1024)
+
+/* frames not in frame_tab aren't even read */
+static int v2_frame_wanted(const struct v2_frame_header *fh)
+{
+	return frame_tab_index(fh->id) >= 0;
+}
+
+static int v2_frame_header_parse(struct v2_frame_header *fh,
+		const struct v2_header *header, const char *buf)
+{
+	if (header->ver_major == 2)
+		return v2_2_0_frame_header_parse(fh, buf);
+	if (header->ver_major == 3)
+		return v2_3_0_frame_header_parse(fh, buf);
+	/* assume v2.4 */
+	return v2_4_0_frame_header_parse(fh, buf);
+}
+
+/* buf is modified if the frame is unsynchronized */
+static void v2_frame(struct id3tag *id3, const struct v2_header *header,
+		struct v2_frame_header *fh, char *buf)
+{
+	int len = fh->size;
+
+	if (header->ver_major >= 4) {
+		if (fh->flags & V2_FRAME_LEN_INDICATOR) {
+			/* 4 byte sync safe data length */
+			if (len < 4)
+				return;
+			buf += 4;
+			len -= 4;
+		}
+		/* in 2.4 unsynchronization is done per frame */
+		if (header->flags & V2_HEADER_UNSYNC)
+			fh->flags |= V2_FRAME_UNSYNC;
+	}
+	if (fh->flags & V2_FRAME_UNSYNC)
+		unsync((unsigned char *)buf, &len);
+	if (len < 1)
+		return;
+	fh->size = len;
+	v2_add_frame(id3, fh, buf);
+}
+
+/*
+ * whole tag is unsynchronized (< 2.4), frame headers can't be read
+ * before removing the unsynchronization
+ */
+static int v2_read_unsync(struct id3tag *id3, struct tag_probe *tp, off_t offset,
+		const struct v2_header *header)
 {
 	char *buf;
 	int rc, buf_size;
 	int frame_start, i;
 	int frame_header_size;
 
+	/* text frames are normally first, cut off the rest */
 	buf_size = header->size;
+	if (buf_size > V2_MAX_TAG_MEM)
+		buf_size = V2_MAX_TAG_MEM;
 	buf = xnew(char, buf_size);
-	rc = read_all(fd, buf, buf_size);
+	rc = tag_probe_read(tp, offset, buf, buf_size);
 	if (rc) {
 		free(buf);
 		return rc;
@@ -778,12 +837,9 @@ static int v2_read(struct id3tag *id3, int fd, const struct v2_header *header)
 		/* should check if update flag is set */
 	}
 
-	if (header->flags & V2_HEADER_UNSYNC) {
-		int len = buf_size - frame_start;
-
-		unsync((unsigned char *)(buf + frame_start), &len);
-		buf_size = len + frame_start;
-	}
+	i = buf_size - frame_start;
+	unsync((unsigned char *)(buf + frame_start), &i);
+	buf_size = i + frame_start;
 
 	frame_header_size = 10;
 	if (header->ver_major == 2)
@@ -794,17 +850,8 @@ static int v2_read(struct id3tag *id3, int fd, const struct v2_header *header)
 		struct v2_frame_header fh;
 		int len;
 
-		if (header->ver_major == 2) {
-			if (!v2_2_0_frame_header_parse(&fh, buf + i))
-				break;
-		} else if (header->ver_major == 3) {
-			if (!v2_3_0_frame_header_parse(&fh, buf + i))
-				break;
-		} else {
-			/* assume v2.4 */
-			if (!v2_4_0_frame_header_parse(&fh, buf + i))
-				break;
-		}
+		if (!v2_frame_header_parse(&fh, header, buf + i))
+			break;
 
 		i += frame_header_size;
 		if (fh.size > buf_size - i) {
@@ -813,13 +860,8 @@ static int v2_read(struct id3tag *id3, int fd, const struct v2_header *header)
 		}
 
 		len = fh.size;
-		if (fh.flags & V2_FRAME_UNSYNC) {
-			int tmp = len;
-
-			unsync((unsigned char *)(buf + i), &tmp);
-			fh.size = tmp;
-		}
-		v2_add_frame(id3, &fh, buf + i);
+		if (v2_frame_wanted(&fh))
+			v2_frame(id3, header, &fh, buf + i);
 		i += len;
 	}
 
@@ -827,6 +869,74 @@ static int v2_read(struct id3tag *id3, int fd, const struct v2_header *header)
 	return 0;
 }
 
+/*
+ * reads frame headers one by one and only the bodies of frames we use,
+ * so big pictures etc. are never read
+ */
+static int v2_read(struct id3tag *id3, struct tag_probe *tp, off_t offset,
+		const struct v2_header *header)
+{
+	char hbuf[10];
+	off_t pos, end;
+	int frame_header_size;
+	int mem = 0;
+
+	if (header->flags & V2_HEADER_UNSYNC && header->ver_major < 4)
+		return v2_read_unsync(id3, tp, offset, header);
+
+	pos = offset;
+	end = offset + header->size;
+	if (header->flags & V2_HEADER_EXTENDED) {
+		struct v2_extended_header ext;
+
+		if (tag_probe_read(tp, pos, hbuf, 4))
+			return -1;
+		if (!v2_extended_header_parse(&ext, hbuf) || ext.size > header->size) {
+			id3_debug("extended header corrupted\n");
+			return -2;
+		}
+		pos += ext.size;
+		/* should check if update flag is set */
+	}
+
+	frame_header_size = 10;
+	if (header->ver_major == 2)
+		frame_header_size = 6;
+
+	while (pos < end - frame_header_size) {
+		struct v2_frame_header fh;
+		char *buf;
+
+		if (tag_probe_read(tp, pos, hbuf, frame_header_size))
+			return -1;
+		if (!v2_frame_header_parse(&fh, header, hbuf))
+			break;
+
+		pos += frame_header_size;
+		if (fh.size > end - pos) {
+			id3_debug("frame too big\n");
+			break;
+		}
+
+		if (!v2_frame_wanted(&fh) || mem + fh.size > V2_MAX_TAG_MEM) {
+			id3_debug("skipping %d bytes\n", fh.size);
+			pos += fh.size;
+			continue;
+		}
+
+		buf = xnew(char, fh.size);
+		if (tag_probe_read(tp, pos, buf, fh.size)) {
+			free(buf);
+			return -1;
+		}
+		pos += fh.size;
+		mem += fh.size;
+		v2_frame(id3, header, &fh, buf);
+		free(buf);
+	}
+	return 0;
+}
+
 int id3_tag_size(const char *buf, int buf_size)
 {
 	struct v2_header header;
@@ -858,32 +968,26 @@ void id3_free(struct id3tag *id3)
 		free(id3->v2[i]);
 }
 
-int id3_read_tags(struct id3tag *id3, int fd, unsigned int flags)
+int id3_read_tags_probe(struct id3tag *id3, struct tag_probe *tp, unsigned int flags)
 {
-	off_t off;
+	const char *buf;
 	int rc;
 
 	if (flags & ID3_V2) {
 		struct v2_header header;
-		char buf[138];
 
-		rc = read_all(fd, buf, 10);
-		if (rc)
-			goto rc_error;
-		if (v2_header_parse(&header, buf)) {
-			rc = v2_read(id3, fd, &header);
+		buf = tag_probe_peek(tp, 0, 10);
+		if (buf && v2_header_parse(&header, buf)) {
+			rc = v2_read(id3, tp, 10, &header);
 			if (rc)
-				goto rc_error;
+				return rc;
 			/* get v1 if needed */
 		} else {
 			/* get v2 from end and optionally v1 */
 
-			off = lseek(fd, -138, SEEK_END);
-			if (off == -1)
-				goto error;
-			rc = read_all(fd, buf, 138);
-			if (rc)
-				goto rc_error;
+			buf = tag_probe_peek(tp, tp->size - 138, 138);
+			if (buf == NULL)
+				goto v1;
 
 			if (is_v1(buf + 10)) {
 				if (flags & ID3_V1) {
@@ -892,38 +996,39 @@ int id3_read_tags(struct id3tag *id3, int fd, unsigned int flags)
 				}
 				if (v2_footer_parse(&header, buf)) {
 					/* footer at end of file - 128 */
-					off = lseek(fd, -(header.size + 138), SEEK_END);
-					if (off == -1)
-						goto error;
-					rc = v2_read(id3, fd, &header);
+					rc = v2_read(id3, tp, tp->size - header.size - 138, &header);
 					if (rc)
-						goto rc_error;
+						return rc;
 				}
 			} else if (v2_footer_parse(&header, buf + 128)) {
 				/* footer at end of file */
-				off = lseek(fd, -(header.size + 10), SEEK_END);
-				if (off == -1)
-					goto error;
-				rc = v2_read(id3, fd, &header);
+				rc = v2_read(id3, tp, tp->size - header.size - 10, &header);
 				if (rc)
-					goto rc_error;
+					return rc;
 			}
 			return 0;
 		}
 	}
+v1:
 	if (flags & ID3_V1) {
-		off = lseek(fd, -128, SEEK_END);
-		if (off == -1)
-			goto error;
-		rc = read_all(fd, id3->v1, 128);
-		if (rc)
-			goto rc_error;
-		id3->has_v1 = is_v1(id3->v1);
+		buf = tag_probe_peek(tp, tp->size - 128, 128);
+		if (buf) {
+			memcpy(id3->v1, buf, 128);
+			id3->has_v1 = is_v1(id3->v1);
+		}
 	}
 	return 0;
-error:
-	rc = -1;
-rc_error:
+}
+
+int id3_read_tags(struct id3tag *id3, int fd, unsigned int flags)
+{
+	struct tag_probe tp;
+	int rc;
+
+	if (tag_probe_init(&tp, fd))
+		return -1;
+	rc = id3_read_tags_probe(id3, &tp, flags);
+	tag_probe_free(&tp);
 	return rc;
 }
 
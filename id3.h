@@ -5,6 +5,8 @@
 #ifndef _ID3_H
 #define _ID3_H
 
+#include "tag_probe.h"
+
 #include <string.h>
 
 /* flags for id3_read_tags */
@@ -54,6 +56,7 @@ static inline void id3_init(struct id3tag *id3)
 
 void id3_free(struct id3tag *id3);
 int id3_read_tags(struct id3tag *id3, int fd, unsigned int flags);
+int id3_read_tags_probe(struct id3tag *id3, struct tag_probe *tp, unsigned int flags);
 char *id3_get_comment(struct id3tag *id3, enum id3_key key);
 
 #endif
@@ -0,0 +1,211 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "index.h"
+#include "cache.h"
+#include "cmus.h"
+#include "dir_walk.h"
+#include "job_stats.h"
+#include "path.h"
+#include "prog.h"
+#include "utils.h"
+#include "xmalloc.h"
+#include "debug.h"
+
+#include <sys/time.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdio.h>
+#include <errno.h>
+#include <pthread.h>
+
+#define MAX_INDEX_THREADS 64
+/* filenames waiting to be read */
+#define INDEX_QUEUE_SIZE 256
+
+static pthread_mutex_t index_mutex = CMUS_MUTEX_INITIALIZER;
+static pthread_cond_t queue_not_empty = PTHREAD_COND_INITIALIZER;
+static pthread_cond_t queue_not_full = PTHREAD_COND_INITIALIZER;
+static char *queue[INDEX_QUEUE_SIZE];
+static int queue_head = 0;
+static int queue_count = 0;
+static int walk_done = 0;
+
+static int nr_files = 0;
+static int nr_errors = 0;
+
+#define index_lock() cmus_mutex_lock(&index_mutex)
+#define index_unlock() cmus_mutex_unlock(&index_mutex)
+
+static void queue_push(char *filename)
+{
+	index_lock();
+	while (queue_count == INDEX_QUEUE_SIZE)
+		pthread_cond_wait(&queue_not_full, &index_mutex);
+	queue[(queue_head + queue_count) % INDEX_QUEUE_SIZE] = filename;
+	queue_count++;
+	pthread_cond_signal(&queue_not_empty);
+	index_unlock();
+}
+
+/* returns NULL when all files have been read */
+static char *queue_pop(void)
+{
+	char *filename = NULL;
+
+	index_lock();
+	while (queue_count == 0 && !walk_done)
+		pthread_cond_wait(&queue_not_empty, &index_mutex);
+	if (queue_count) {
+		filename = queue[queue_head];
+		queue_head = (queue_head + 1) % INDEX_QUEUE_SIZE;
+		queue_count--;
+		pthread_cond_signal(&queue_not_full);
+	}
+	index_unlock();
+	return filename;
+}
+
+static void *index_thread(void *arg)
+{
+	char *filename;
+
+	while ((filename = queue_pop())) {
+		struct track_info *ti;
+		time_t mtime;
+
+		cache_lock();
+		ti = cache_get_ti(filename);
+		cache_unlock();
+
+		/* same check as update-cache, the cached tags may be stale */
+		mtime = file_get_mtime(filename);
+		if (ti && mtime != -1 && ti->mtime != mtime) {
+			struct track_info *new = cache_read_ti(filename, mtime);
+
+			d_print("mtime changed: %s\n", filename);
+			cache_lock();
+			cache_replace_ti(ti, new);
+			cache_unlock();
+			track_info_unref(ti);
+			ti = new;
+		}
+
+		if (ti) {
+			/* exact duration of VBR files, saves the scan later */
+			cache_scan_ti(ti);
+			track_info_unref(ti);
+		} else {
+			warn("%s: couldn't read tags\n", filename);
+		}
+
+		index_lock();
+		if (ti) {
+			nr_files++;
+		} else {
+			nr_errors++;
+		}
+		index_unlock();
+		free(filename);
+	}
+	return NULL;
+}
+
+static void print_codec(const char *codec, unsigned int files, uint64_t usec)
+{
+	printf("  %-8s %8u files %8.1f s\n", codec, files, usec / 1e6);
+}
+
+static double now(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int index_main(char **dirs, const char *cache_file)
+{
+	pthread_t threads[MAX_INDEX_THREADS];
+	struct job_stats js;
+	double start, secs;
+	int i, nr_threads, rc = 0;
+
+	if (dirs[0] == NULL) {
+		warn("--index requires at least one directory\n");
+		return 1;
+	}
+
+	if (cache_file)
+		cache_set_filename(cache_file);
+	if (cache_init())
+		warn_errno("reading cache");
+	cmus_init_playable();
+
+	/* tag reading is mostly CPU bound once the files are in page cache */
+	nr_threads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nr_threads < 1)
+		nr_threads = 1;
+	if (nr_threads > MAX_INDEX_THREADS)
+		nr_threads = MAX_INDEX_THREADS;
+
+	start = now();
+	for (i = 0; i < nr_threads; i++) {
+		int err = pthread_create(&threads[i], NULL, index_thread, NULL);
+
+		if (err) {
+			if (i == 0)
+				die("pthread_create: %s\n", strerror(err));
+			nr_threads = i;
+			break;
+		}
+	}
+
+	for (i = 0; dirs[i]; i++) {
+		struct dir_walk *w;
+		const char *filename;
+		struct stat st;
+		char *root;
+
+		if (stat(dirs[i], &st)) {
+			warn_errno("%s", dirs[i]);
+			rc = 1;
+			continue;
+		}
+		if (!S_ISDIR(st.st_mode)) {
+			warn("%s: not a directory\n", dirs[i]);
+			rc = 1;
+			continue;
+		}
+		root = path_absolute(dirs[i]);
+		w = dir_walk_new(root, 0, NULL);
+		while ((filename = dir_walk_next(w))) {
+			if (cmus_is_playable(filename))
+				queue_push(xstrdup(filename));
+		}
+		dir_walk_free(w);
+		free(root);
+	}
+
+	index_lock();
+	walk_done = 1;
+	pthread_cond_broadcast(&queue_not_empty);
+	index_unlock();
+	for (i = 0; i < nr_threads; i++)
+		pthread_join(threads[i], NULL);
+	secs = now() - start;
+
+	if (cache_close()) {
+		warn_errno("writing cache");
+		rc = 1;
+	}
+
+	job_stats_get(&js);
+	printf("%d files, %d errors, %u read (%u already cached) in %.1f s using %d threads\n",
+			nr_files, nr_errors, js.cache_misses, js.cache_hits, secs, nr_threads);
+	printf("time spent reading tags:\n");
+	job_stats_for_each_codec(print_codec);
+	return rc || nr_errors ? 1 : 0;
+}
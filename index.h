@@ -0,0 +1,19 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _INDEX_H
+#define _INDEX_H
+
+/*
+ * cmus --index: read tags of all files under @dirs into the track cache
+ * without starting the UI.  Input plugins must be loaded.
+ *
+ * @dirs:       NULL terminated
+ * @cache_file: NULL for ~/.cmus/cache
+ *
+ * returns exit code
+ */
+int index_main(char **dirs, const char *cache_file);
+
+#endif
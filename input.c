@@ -427,6 +427,19 @@ static void ip_init(struct input_plugin *ip, char *filename)
 	ip->data.remote = is_url(filename);
 }
 
+/* like ip_init() but keeps seek index settings for the next ip_open() */
+static void ip_reset(struct input_plugin *ip)
+{
+	char *seek_idx = ip->data.seek_idx;
+	int seek_idx_size = ip->data.seek_idx_size;
+	unsigned int exact = ip->data.exact;
+
+	ip_init(ip, ip->data.filename);
+	ip->data.seek_idx = seek_idx;
+	ip->data.seek_idx_size = seek_idx_size;
+	ip->data.exact = exact;
+}
+
 struct input_plugin *ip_new(const char *filename)
 {
 	struct input_plugin *ip = xnew(struct input_plugin, 1);
@@ -439,6 +452,7 @@ void ip_delete(struct input_plugin *ip)
 {
 	if (ip->open)
 		ip_close(ip);
+	free(ip->data.seek_idx);
 	free(ip->data.filename);
 	free(ip);
 }
@@ -469,7 +483,7 @@ int ip_open(struct input_plugin *ip)
 		if (ip->data.fd != -1)
 			close(ip->data.fd);
 		free(ip->data.metadata);
-		ip_init(ip, ip->data.filename);
+		ip_reset(ip);
 		return rc;
 	}
 	ip->open = 1;
@@ -515,7 +529,7 @@ int ip_close(struct input_plugin *ip)
 	free(ip->data.metadata);
 	free(ip->http_reason);
 
-	ip_init(ip, ip->data.filename);
+	ip_reset(ip);
 	return rc;
 }
 
@@ -593,6 +607,30 @@ int ip_read_comments(struct input_plugin *ip, struct keyval **comments)
 	return ip->ops->read_comments(&ip->data, comments);
 }
 
+int ip_read_info(struct input_plugin *ip, struct keyval **comments, int *duration)
+{
+	const struct input_plugin_ops *ops;
+	int rc;
+
+	BUG_ON(ip->open);
+	if (ip->data.remote)
+		return -IP_ERROR_FUNCTION_NOT_SUPPORTED;
+
+	ops = get_ops_by_filename(ip->data.filename);
+	if (ops == NULL)
+		return -IP_ERROR_UNRECOGNIZED_FILE_TYPE;
+	if (ops->read_info == NULL)
+		return -IP_ERROR_FUNCTION_NOT_SUPPORTED;
+
+	/* most libraries open the file by name, not opened here */
+	ip->ops = ops;
+	rc = ops->read_info(&ip->data, comments, duration);
+	if (ip->data.fd != -1)
+		close(ip->data.fd);
+	ip_reset(ip);
+	return rc;
+}
+
 int ip_duration(struct input_plugin *ip)
 {
 	if (ip->data.remote)
@@ -604,6 +642,38 @@ int ip_duration(struct input_plugin *ip)
 	return ip->duration;
 }
 
+void ip_set_exact(struct input_plugin *ip)
+{
+	BUG_ON(ip->open);
+	free(ip->data.seek_idx);
+	ip->data.seek_idx = NULL;
+	ip->data.seek_idx_size = 0;
+	ip->data.exact = 1;
+}
+
+void ip_set_seek_idx(struct input_plugin *ip, const char *buf, int size)
+{
+	BUG_ON(ip->open);
+	free(ip->data.seek_idx);
+	ip->data.seek_idx = xmalloc(size);
+	memcpy(ip->data.seek_idx, buf, size);
+	ip->data.seek_idx_size = size;
+	ip->data.exact = 0;
+}
+
+const char *ip_get_seek_idx(struct input_plugin *ip, int *size)
+{
+	BUG_ON(!ip->open);
+	*size = ip->data.seek_idx_size;
+	return ip->data.seek_idx;
+}
+
+int ip_duration_estimated(struct input_plugin *ip)
+{
+	BUG_ON(!ip->open);
+	return ip->data.duration_estimated;
+}
+
 sample_format_t ip_get_sf(struct input_plugin *ip)
 {
 	BUG_ON(!ip->open);
@@ -52,6 +52,33 @@ int ip_read_comments(struct input_plugin *ip, struct keyval **comments);
 
 int ip_duration(struct input_plugin *ip);
 
+/*
+ * reads comments and duration of a local file without opening the decoder
+ * call instead of ip_open(), @ip stays closed
+ *
+ * errors: IP_ERROR_{FUNCTION_NOT_SUPPORTED, ERRNO, FILE_FORMAT}
+ */
+int ip_read_info(struct input_plugin *ip, struct keyval **comments, int *duration);
+
+/*
+ * call before ip_open()
+ *
+ * ip_set_exact: scan whole file (slow) to get exact duration and seek index
+ * ip_set_seek_idx: use seek index from an earlier exact scan
+ */
+void ip_set_exact(struct input_plugin *ip);
+void ip_set_seek_idx(struct input_plugin *ip, const char *buf, int size);
+
+/*
+ * seek index built by exact open, NULL if the plugin does not support it
+ */
+const char *ip_get_seek_idx(struct input_plugin *ip, int *size);
+
+/*
+ * returns: 1 if duration is estimated and ip_set_exact() would help
+ */
+int ip_duration_estimated(struct input_plugin *ip);
+
 sample_format_t ip_get_sf(struct input_plugin *ip);
 const char *ip_get_filename(struct input_plugin *ip);
 const char *ip_get_metadata(struct input_plugin *ip);
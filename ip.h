@@ -55,6 +55,17 @@ struct input_plugin_data {
 
 	unsigned int remote : 1;
 	unsigned int metadata_changed : 1;
+	/* decode whole file for exact duration and seek index */
+	unsigned int exact : 1;
+
+	/*
+	 * opaque seek index and exact duration
+	 *
+	 * set by ip-layer before open (saved in the track cache) or by
+	 * plugin when exact is set
+	 */
+	char *seek_idx;
+	int seek_idx_size;
 
 	/* shoutcast */
 	int counter;
@@ -64,6 +75,8 @@ struct input_plugin_data {
 	/* filled by plugin */
 	sample_format_t sf;
 	void *private;
+	/* duration is a guess, opening with exact set would fix it */
+	unsigned int duration_estimated : 1;
 };
 
 struct input_plugin_ops {
@@ -74,6 +87,14 @@ struct input_plugin_ops {
 	int (*read_comments)(struct input_plugin_data *ip_data,
 			struct keyval **comments);
 	int (*duration)(struct input_plugin_data *ip_data);
+
+	/*
+	 * optional, reads comments and duration from container headers
+	 * without setting up the decoder.  fd is -1, readers which need it
+	 * open filename themselves.  private is not used.
+	 */
+	int (*read_info)(struct input_plugin_data *ip_data,
+			struct keyval **comments, int *duration);
 };
 
 /* symbols exported by plugin */
@@ -3,222 +3,389 @@
 #include "cache.h"
 #include "xmalloc.h"
 #include "debug.h"
+#include "dir_walk.h"
 #include "load_dir.h"
-#include "path.h"
+#include "watch.h"
 #include "editable.h"
 #include "play_queue.h"
 #include "lib.h"
 #include "utils.h"
 #include "file.h"
+#include "stat_batch.h"
+#include "job_stats.h"
+#include "lib_snapshot.h"
 #include "cache.h"
+#include "locking.h"
 
 #include <string.h>
+#include <stdio.h>
 #include <unistd.h>
 #include <errno.h>
 
-static struct track_info *ti_buffer[32];
-static int ti_buffer_fill;
-static struct add_data *jd;
+/* give up on a file if stat() takes longer than this (dead mount) */
+#define STAT_TIMEOUT_MS 10000
+/* changes applied to the cache and library per lock */
+#define CACHE_CHANGE_BATCH 64
+/* playlist lines looked up in the cache per lock */
+#define PL_BATCH_SIZE 256
 
-static void flush_ti_buffer(void)
+/* error_msg() isn't thread-safe, see job_get_add_error() */
+static pthread_mutex_t add_error_mutex = CMUS_MUTEX_INITIALIZER;
+static char *add_error;
+
+static void flush_ti_buffer(struct add_data *jd)
 {
 	int i;
 
 	editable_lock();
-	for (i = 0; i < ti_buffer_fill; i++) {
-		jd->add(ti_buffer[i]);
-		track_info_unref(ti_buffer[i]);
+	for (i = 0; i < jd->ti_buffer_fill; i++) {
+		/*
+		 * worker_remove_jobs() doesn't wait for us.  checking under
+		 * editable lock makes sure nothing is added after the view
+		 * has been cleared
+		 */
+		if (!worker_cancelling())
+			jd->add(jd->ti_buffer[i]);
+		track_info_unref(jd->ti_buffer[i]);
 	}
 	editable_unlock();
-	ti_buffer_fill = 0;
+	jd->ti_buffer_fill = 0;
+}
+
+static void add_ti(struct add_data *jd, struct track_info *ti)
+{
+	if (jd->ti_buffer_fill == ADD_TI_BUFFER_SIZE)
+		flush_ti_buffer(jd);
+	jd->ti_buffer[jd->ti_buffer_fill++] = ti;
+}
+
+/* takes the reference of @ti */
+static void update_data_add(struct update_data *d, struct track_info *ti)
+{
+	if (d->size == d->used) {
+		if (d->size == 0)
+			d->size = 16;
+		d->size *= 2;
+		d->ti = xrenew(struct track_info *, d->ti, d->size);
+	}
+	d->ti[d->used++] = ti;
 }
 
-static void add_ti(struct track_info *ti)
+static void add_scan_ti(struct add_data *jd, struct track_info *ti)
 {
-	if (ti_buffer_fill == sizeof(ti_buffer) / sizeof(ti_buffer[0]))
-		flush_ti_buffer();
-	ti_buffer[ti_buffer_fill++] = ti;
+	struct update_data *d = jd->scan_data;
+
+	if (!d) {
+		d = xnew(struct update_data, 1);
+		d->size = 0;
+		d->used = 0;
+		d->ti = NULL;
+		jd->scan_data = d;
+	}
+	track_info_ref(ti);
+	update_data_add(d, ti);
 }
 
-static void add_url(const char *filename)
+static void add_url(struct add_data *jd, const char *filename)
 {
-	add_ti(track_info_url_new(filename));
+	job_stats_processed();
+	add_ti(jd, track_info_url_new(filename));
 }
 
 /* add file to the playlist
  *
  * @filename: absolute filename with extraneous slashes stripped
  */
-static void add_file(const char *filename)
+static void add_file(struct add_data *jd, const char *filename)
 {
 	struct track_info *ti;
 
+	job_stats_processed();
 	cache_lock();
 	ti = cache_get_ti(filename);
+	if (ti && ti->duration_estimated)
+		add_scan_ti(jd, ti);
 	cache_unlock();
 
-	if (ti)
-		add_ti(ti);
-}
-
-static int dir_entry_cmp(const void *ap, const void *bp)
-{
-	struct dir_entry *a = *(struct dir_entry **)ap;
-	struct dir_entry *b = *(struct dir_entry **)bp;
-
-	return strcmp(a->name, b->name);
+	if (ti) {
+		if (jd->add == lib_add_track)
+			watch_add_file(filename);
+		add_ti(jd, ti);
+	}
 }
 
-static int dir_entry_cmp_reverse(const void *ap, const void *bp)
+static void add_dir(struct add_data *jd, const char *dirname)
 {
-	struct dir_entry *a = *(struct dir_entry **)ap;
-	struct dir_entry *b = *(struct dir_entry **)bp;
-
-	return strcmp(b->name, a->name);
+	struct dir_walk *w;
+	const char *filename;
+	int found = 0;
+
+	w = dir_walk_new(dirname, jd->add == play_queue_prepend,
+			jd->add == lib_add_track ? watch_add_dir : NULL);
+	while (!worker_cancelling() && (filename = dir_walk_next(w))) {
+		/* the walk threads list directories ahead of us */
+		int n = dir_walk_found(w);
+
+		if (n > found) {
+			job_stats_discovered(n - found);
+			found = n;
+		}
+		add_file(jd, filename);
+	}
+	dir_walk_free(w);
 }
 
-static int points_within(const char *target, const char *root)
+static int collect_line(void *data, const char *line)
 {
-	int tlen = strlen(target);
-	int rlen = strlen(root);
-
-	if (rlen > tlen)
-		return 0;
-	if (strncmp(target, root, rlen))
-		return 0;
-	return target[rlen] == '/' || !target[rlen];
+	ptr_array_add(data, xstrdup(line));
+	return 0;
 }
 
-static void add_dir(const char *dirname, const char *root)
+/*
+ * track_infos of up to PL_BATCH_SIZE files and URLs, NULL if a file
+ * can't be read
+ */
+static void get_tis(struct add_data *jd, char **filenames, int nr,
+		struct track_info **tis)
 {
-	struct directory dir;
-	struct dir_entry **ents;
-	const char *name;
-	PTR_ARRAY(array);
-	int i;
+	struct track_info *file_tis[PL_BATCH_SIZE];
+	char *files[PL_BATCH_SIZE];
+	int i, nr_files = 0;
 
-	if (dir_open(&dir, dirname)) {
-		d_print("error: opening %s: %s\n", dirname, strerror(errno));
-		return;
+	for (i = 0; i < nr; i++) {
+		if (!is_url(filenames[i]))
+			files[nr_files++] = filenames[i];
+	}
+	if (nr_files) {
+		if (jd->read_pool == NULL)
+			jd->read_pool = read_pool_new();
+		cache_get_tis(jd->read_pool, files, nr_files, file_tis,
+				worker_cancelling);
 	}
-	while ((name = dir_read(&dir))) {
-		struct dir_entry *ent;
-		int size;
-
-		if (name[0] == '.')
-			continue;
 
-		if (dir.is_link) {
-			char buf[1024];
-			char *target;
-			int rc = readlink(dir.path, buf, sizeof(buf));
-
-			if (rc < 0 || rc == sizeof(buf))
-				continue;
-			buf[rc] = 0;
-			target = path_absolute_cwd(buf, dirname);
-			if (points_within(target, root)) {
-				/* symlink points withing the root */
-				d_print("%s -> %s points within %s. ignoring\n",
-						dir.path, target, root);
-				free(target);
-				continue;
-			}
-			free(target);
+	nr_files = 0;
+	for (i = 0; i < nr; i++) {
+		if (is_url(filenames[i])) {
+			tis[i] = track_info_url_new(filenames[i]);
+		} else {
+			tis[i] = file_tis[nr_files++];
 		}
-
-		size = strlen(name) + 1;
-		ent = xmalloc(sizeof(struct dir_entry) + size);
-		ent->mode = dir.st.st_mode;
-		memcpy(ent->name, name, size);
-		ptr_array_add(&array, ent);
 	}
-	dir_close(&dir);
+}
 
-	if (jd->add == play_queue_prepend) {
-		ptr_array_sort(&array, dir_entry_cmp_reverse);
-	} else {
-		ptr_array_sort(&array, dir_entry_cmp);
-	}
-	ents = array.ptrs;
-	for (i = 0; i < array.count; i++) {
-		if (!worker_cancelling()) {
-			/* abuse dir.path because
-			 *  - it already contains dirname + '/'
-			 *  - it is guaranteed to be large enough
-			 */
-			int len = strlen(ents[i]->name);
-
-			memcpy(dir.path + dir.len, ents[i]->name, len + 1);
-			if (S_ISDIR(ents[i]->mode)) {
-				add_dir(dir.path, root);
-			} else {
-				add_file(dir.path);
-			}
-		}
-		free(ents[i]);
+static void add_scan_tis(struct add_data *jd, struct track_info **tis, int nr)
+{
+	int i;
+
+	cache_lock();
+	for (i = 0; i < nr; i++) {
+		if (tis[i] && tis[i]->duration_estimated)
+			add_scan_ti(jd, tis[i]);
 	}
-	free(ents);
+	cache_unlock();
 }
 
-static int handle_line(void *data, const char *line)
+/* @lines are in the order they are added */
+static void add_pl_lines(struct add_data *jd, char **lines, int nr)
 {
-	if (worker_cancelling())
-		return 1;
+	struct track_info *tis[PL_BATCH_SIZE];
+	int i;
 
-	if (is_url(line)) {
-		add_url(line);
-	} else {
-		add_file(line);
+	get_tis(jd, lines, nr, tis);
+	add_scan_tis(jd, tis, nr);
+
+	for (i = 0; i < nr; i++) {
+		job_stats_processed();
+		if (tis[i] == NULL)
+			continue;
+		if (jd->add == lib_add_track && !is_url(lines[i]))
+			watch_add_file(lines[i]);
+		/* dropped by flush_ti_buffer() if cancelled */
+		add_ti(jd, tis[i]);
 	}
-	return 0;
 }
 
-static void add_pl(const char *filename)
+static void add_pl(struct add_data *jd, const char *filename)
 {
+	PTR_ARRAY(lines);
 	char *buf;
-	int size, reverse;
+	char **ptrs;
+	int i, size;
 
+	/* buf is NULL for an empty file */
 	buf = mmap_file(filename, &size);
-	if (size == -1)
+	if (size == -1 || buf == NULL)
 		return;
 
-	if (buf) {
-		/* beautiful hack */
-		reverse = jd->add == play_queue_prepend;
-
-		cmus_playlist_for_each(buf, size, reverse, handle_line, NULL);
-		munmap(buf, size);
+	/* beautiful hack */
+	cmus_playlist_for_each(buf, size, jd->add == play_queue_prepend,
+			collect_line, &lines);
+	munmap(buf, size);
+	job_stats_discovered(lines.count);
+
+	ptrs = lines.ptrs;
+	for (i = 0; i < lines.count; i += PL_BATCH_SIZE) {
+		if (worker_cancelling())
+			break;
+		add_pl_lines(jd, ptrs + i, min(lines.count - i, PL_BATCH_SIZE));
 	}
+	for (i = 0; i < lines.count; i++)
+		free(ptrs[i]);
+	free(ptrs);
 }
 
-void do_add_job(void *data)
+static void add_name(struct add_data *jd, enum file_type type, const char *name)
 {
-	jd = data;
-	switch (jd->type) {
+	switch (type) {
 	case FILE_TYPE_URL:
-		add_url(jd->name);
+		job_stats_discovered(1);
+		add_url(jd, name);
 		break;
 	case FILE_TYPE_PL:
-		add_pl(jd->name);
+		add_pl(jd, name);
 		break;
 	case FILE_TYPE_DIR:
-		add_dir(jd->name, jd->name);
+		add_dir(jd, name);
 		break;
 	case FILE_TYPE_FILE:
-		add_file(jd->name);
+		job_stats_discovered(1);
+		add_file(jd, name);
 		break;
 	case FILE_TYPE_INVALID:
 		break;
 	}
-	if (ti_buffer_fill)
-		flush_ti_buffer();
-	jd = NULL;
+}
+
+static void set_add_error(const char *name, int err)
+{
+	char buf[512];
+
+	snprintf(buf, sizeof(buf), "adding '%s': %s", name, strerror(err));
+	d_print("%s\n", buf);
+	cmus_mutex_lock(&add_error_mutex);
+	free(add_error);
+	add_error = xstrdup(buf);
+	cmus_mutex_unlock(&add_error_mutex);
+}
+
+char *job_get_add_error(void)
+{
+	char *msg;
+
+	cmus_mutex_lock(&add_error_mutex);
+	msg = add_error;
+	add_error = NULL;
+	cmus_mutex_unlock(&add_error_mutex);
+	return msg;
+}
+
+static void add_names(struct add_data *jd)
+{
+	int i;
+
+	for (i = 0; jd->names[i] && !worker_cancelling(); i++) {
+		const char *name = jd->names[i];
+		enum file_type type;
+		char *absolute;
+
+		/* type is detected here to keep stat() out of the main thread */
+		type = cmus_detect_ft(name, &absolute);
+		if (type == FILE_TYPE_INVALID) {
+			set_add_error(name, errno);
+			continue;
+		}
+		add_name(jd, type, absolute);
+		free(absolute);
+	}
+}
+
+/* tracks of the library snapshot, returns -1 if there is none */
+static int add_lib_snapshot(struct add_data *jd)
+{
+	struct track_info **tis;
+	char **filenames;
+	int *pos;
+	int i, nr;
+
+	nr = lib_snapshot_read(jd->name, &filenames, &pos);
+	if (nr == -1)
+		return -1;
+	job_stats_discovered(nr);
+
+	tis = xnew0(struct track_info *, nr);
+	for (i = 0; i < nr && !worker_cancelling(); i += PL_BATCH_SIZE)
+		get_tis(jd, filenames + i, min(nr - i, PL_BATCH_SIZE), tis + i);
+	add_scan_tis(jd, tis, nr);
+
+	for (i = 0; i < nr; i++) {
+		job_stats_processed();
+		if (tis[i] && !is_url(filenames[i]))
+			watch_add_file(filenames[i]);
+	}
+
+	/* the views are built in one go, appending is fast */
+	editable_lock();
+	if (!worker_cancelling())
+		lib_add_snapshot(tis, pos, nr);
+	editable_unlock();
+
+	for (i = 0; i < nr; i++) {
+		if (tis[i])
+			track_info_unref(tis[i]);
+	}
+	free(tis);
+	free(pos);
+	free_str_array(filenames);
+	return 0;
+}
+
+static void add_job_done(struct add_data *jd)
+{
+	if (jd->ti_buffer_fill)
+		flush_ti_buffer(jd);
+	if (jd->read_pool) {
+		read_pool_free(jd->read_pool);
+		jd->read_pool = NULL;
+	}
+
+	if (jd->scan_data) {
+		worker_add_job(JOB_TYPE_SCAN, do_scan_job, free_scan_job, jd->scan_data);
+		jd->scan_data = NULL;
+	}
+}
+
+void do_add_job(void *data)
+{
+	struct add_data *jd = data;
+
+	if (jd->names) {
+		add_names(jd);
+	} else {
+		add_name(jd, jd->type, jd->name);
+	}
+	add_job_done(jd);
+}
+
+void do_load_lib_job(void *data)
+{
+	struct add_data *jd = data;
+
+	if (add_lib_snapshot(jd))
+		add_pl(jd, jd->name);
+	add_job_done(jd);
 }
 
 void free_add_job(void *data)
 {
 	struct add_data *d = data;
+
+	if (d->names) {
+		int i;
+
+		for (i = 0; d->names[i]; i++)
+			free(d->names[i]);
+		free(d->names);
+	}
 	free(d->name);
 	free(d);
 }
@@ -233,6 +400,11 @@ void do_update_job(void *data)
 		struct stat s;
 		int rc;
 
+		if (worker_cancelling()) {
+			track_info_unref(ti);
+			continue;
+		}
+
 		/* stat follows symlinks, lstat does not */
 		rc = stat(ti->filename, &s);
 		if (rc || ti->mtime != s.st_mtime) {
@@ -263,34 +435,321 @@ void free_update_job(void *data)
 	free(d);
 }
 
+struct cache_change {
+	struct track_info *old;
+	/* NULL if deleted */
+	struct track_info *new;
+};
+
+/* replace changed tracks in the cache and library, locks are held briefly */
+static void apply_cache_changes(struct cache_change *changes, int nr)
+{
+	int i;
+
+	cache_lock();
+	editable_lock();
+	for (i = 0; i < nr; i++) {
+		struct track_info *old = changes[i].old;
+		struct track_info *new = changes[i].new;
+
+		/* could have been removed while we were not holding the lock */
+		if (cache_replace_ti(old, new)) {
+			if (lib_remove(old) && new)
+				lib_add_track(new);
+			// FIXME: other views
+		}
+	}
+	editable_unlock();
+	cache_unlock();
+
+	for (i = 0; i < nr; i++) {
+		track_info_unref(changes[i].old);
+		if (changes[i].new)
+			track_info_unref(changes[i].new);
+	}
+}
+
 void do_update_cache_job(void *data)
 {
+	struct cache_change changes[CACHE_CHANGE_BATCH];
+	struct stat_result *res;
 	struct track_info **tis;
-	int i, count;
+	char **filenames;
+	int i, count, nr_changes = 0;
 
 	cache_lock();
-	tis = cache_refresh(&count);
-	editable_lock();
+	tis = cache_get_all(&count);
+	cache_unlock();
+
+	/* no locks held while stat()ing */
+	filenames = xnew(char *, count);
+	for (i = 0; i < count; i++)
+		filenames[i] = tis[i]->filename;
+	res = stat_batch(filenames, count, STAT_TIMEOUT_MS, worker_cancelling);
+	free(filenames);
+
 	for (i = 0; i < count; i++) {
-		struct track_info *new, *old = tis[i];
+		struct track_info *ti = tis[i];
+		struct track_info *new = NULL;
 
-		if (!old)
+		if (!res || worker_cancelling() || res[i].err == ETIMEDOUT) {
+			/* can't tell, keep it */
+			track_info_unref(ti);
 			continue;
+		}
+		if (!res[i].err && res[i].mtime == ti->mtime) {
+			track_info_unref(ti);
+			continue;
+		}
 
-		new = old->next;
-		if (lib_remove(old) && new)
-			lib_add_track(new);
-		// FIXME: other views
-
-		track_info_unref(old);
-		if (new)
-			track_info_unref(new);
+		if (!res[i].err) {
+			d_print("mtime changed: %s\n", ti->filename);
+			new = cache_read_ti(ti->filename, res[i].mtime);
+		} else {
+			d_print("removing dead file %s\n", ti->filename);
+		}
+		changes[nr_changes].old = ti;
+		changes[nr_changes].new = new;
+		if (++nr_changes == CACHE_CHANGE_BATCH) {
+			apply_cache_changes(changes, nr_changes);
+			nr_changes = 0;
+		}
 	}
-	editable_unlock();
-	cache_unlock();
+	if (nr_changes)
+		apply_cache_changes(changes, nr_changes);
+	free(res);
 	free(tis);
 }
 
 void free_update_cache_job(void *data)
 {
 }
+
+/* number of files scanned before giving other jobs a chance to run */
+#define SCAN_BATCH 8
+
+void do_scan_job(void *data)
+{
+	struct update_data *d = data;
+	struct update_data *rest;
+	int i, n = min(d->used, SCAN_BATCH);
+
+	for (i = 0; i < n && !worker_cancelling(); i++) {
+		cache_scan_ti(d->ti[i]);
+		track_info_unref(d->ti[i]);
+	}
+	d->used -= i;
+	memmove(d->ti, d->ti + i, d->used * sizeof(struct track_info *));
+	if (!d->used || worker_cancelling())
+		return;
+
+	/* low priority, continue after the jobs added meanwhile */
+	rest = xnew(struct update_data, 1);
+	rest->size = d->size;
+	rest->used = d->used;
+	rest->ti = d->ti;
+	d->used = 0;
+	d->ti = NULL;
+	worker_add_job(JOB_TYPE_SCAN, do_scan_job, free_scan_job, rest);
+}
+
+void free_scan_job(void *data)
+{
+	struct update_data *d = data;
+	int i;
+
+	for (i = 0; i < d->used; i++)
+		track_info_unref(d->ti[i]);
+	free(d->ti);
+	free(d);
+}
+
+struct watch_match {
+	/* sorted WATCH_CHANGED paths */
+	char **changed;
+	int nr_changed;
+	/* set if changed[i] is in the library */
+	char *found;
+
+	/* sorted WATCH_GONE and WATCH_RESCAN paths */
+	char **dirs;
+	int nr_dirs;
+
+	struct update_data *update;
+};
+
+static int path_cmp(const void *ap, const void *bp)
+{
+	return strcmp(*(char **)ap, *(char **)bp);
+}
+
+/* is @filename or any of its parent directories in @paths */
+static int path_or_parent_in(char **paths, int nr, const char *filename)
+{
+	char *buf, *slash;
+	int rc = 0;
+
+	if (nr == 0)
+		return 0;
+
+	buf = xstrdup(filename);
+	while (1) {
+		if (bsearch(&buf, paths, nr, sizeof(char *), path_cmp)) {
+			rc = 1;
+			break;
+		}
+		slash = strrchr(buf, '/');
+		if (slash == NULL || slash == buf)
+			break;
+		*slash = 0;
+	}
+	free(buf);
+	return rc;
+}
+
+/* is @ti changed or in a changed directory */
+static int watch_match(struct watch_match *m, struct track_info *ti)
+{
+	char **p = NULL;
+
+	if (m->nr_changed)
+		p = bsearch(&ti->filename, m->changed, m->nr_changed, sizeof(char *), path_cmp);
+	if (p) {
+		m->found[p - m->changed] = 1;
+		return 1;
+	}
+	return path_or_parent_in(m->dirs, m->nr_dirs, ti->filename);
+}
+
+static int watch_collect_cb(void *data, struct track_info *ti)
+{
+	struct ptr_array *tis = data;
+
+	if (is_url(ti->filename))
+		return 0;
+	track_info_ref(ti);
+	ptr_array_add(tis, ti);
+	return 0;
+}
+
+void do_watch_job(void *data)
+{
+	struct watch_data *wd = data;
+	struct watch_match m;
+	PTR_ARRAY(tis);
+	struct track_info **ptrs;
+	int i;
+
+	m.changed = xnew(char *, wd->nr);
+	m.nr_changed = 0;
+	m.dirs = xnew(char *, wd->nr);
+	m.nr_dirs = 0;
+	for (i = 0; i < wd->nr; i++) {
+		struct watch_event *e = &wd->events[i];
+
+		switch (e->type) {
+		case WATCH_CHANGED:
+			m.changed[m.nr_changed++] = e->path;
+			break;
+		case WATCH_GONE:
+		case WATCH_RESCAN:
+			m.dirs[m.nr_dirs++] = e->path;
+			break;
+		case WATCH_DIR_ADDED:
+			break;
+		}
+	}
+	qsort(m.changed, m.nr_changed, sizeof(char *), path_cmp);
+	qsort(m.dirs, m.nr_dirs, sizeof(char *), path_cmp);
+	m.found = xnew0(char, m.nr_changed + 1);
+	m.update = xnew0(struct update_data, 1);
+
+	/* one pass over the library for the whole batch, matched unlocked */
+	editable_lock();
+	lib_for_each(watch_collect_cb, &tis);
+	editable_unlock();
+
+	ptrs = tis.ptrs;
+	for (i = 0; i < tis.count; i++) {
+		struct track_info *ti = ptrs[i];
+
+		if (watch_match(&m, ti))
+			update_data_add(m.update, ti);
+		else
+			track_info_unref(ti);
+	}
+	free(ptrs);
+
+	/* removes deleted files and re-adds modified ones */
+	do_update_job(m.update);
+	free_update_job(m.update);
+	if (worker_cancelling())
+		goto out;
+
+	for (i = 0; i < m.nr_changed; i++) {
+		if (!m.found[i] && cmus_is_playable(m.changed[i]))
+			cmus_add(lib_add_track, m.changed[i], FILE_TYPE_FILE, JOB_TYPE_LIB);
+	}
+	for (i = 0; i < wd->nr; i++) {
+		struct watch_event *e = &wd->events[i];
+
+		if (e->type == WATCH_DIR_ADDED || e->type == WATCH_RESCAN)
+			cmus_add(lib_add_track, e->path, FILE_TYPE_DIR, JOB_TYPE_LIB);
+	}
+out:
+	free(m.changed);
+	free(m.dirs);
+	free(m.found);
+}
+
+void free_watch_job(void *data)
+{
+	struct watch_data *wd = data;
+	int i;
+
+	for (i = 0; i < wd->nr; i++)
+		free(wd->events[i].path);
+	free(wd->events);
+	free(wd);
+}
+
+static int watch_lib_cb(void *data, struct track_info *ti)
+{
+	struct ptr_array *dirs = data;
+	const char *slash;
+
+	if (is_url(ti->filename))
+		return 0;
+	slash = strrchr(ti->filename, '/');
+	if (slash == NULL || slash == ti->filename)
+		return 0;
+
+	/* lib_for_each() isn't sorted, duplicates are removed later */
+	ptr_array_add(dirs, xstrndup(ti->filename, slash - ti->filename));
+	return 0;
+}
+
+void do_watch_lib_job(void *data)
+{
+	PTR_ARRAY(dirs);
+	char **ptrs;
+	int i;
+
+	editable_lock();
+	lib_for_each(watch_lib_cb, &dirs);
+	editable_unlock();
+
+	ptrs = dirs.ptrs;
+	ptr_array_sort(&dirs, path_cmp);
+	for (i = 0; i < dirs.count; i++) {
+		if (i == 0 || strcmp(ptrs[i], ptrs[i - 1]))
+			watch_add_dir(ptrs[i]);
+	}
+	for (i = 0; i < dirs.count; i++)
+		free(ptrs[i]);
+	free(ptrs);
+}
+
+void free_watch_lib_job(void *data)
+{
+}
@@ -3,23 +3,48 @@
 
 #include "cmus.h"
 
+struct update_data {
+	size_t size;
+	size_t used;
+	struct track_info **ti;
+};
+
+#define ADD_TI_BUFFER_SIZE 32
+
 struct add_data {
 	enum file_type type;
 	char *name;
+	/* NULL terminated, used instead of name and type if not NULL */
+	char **names;
 	add_ti_cb add;
-};
 
-struct update_data {
-	size_t size;
-	size_t used;
-	struct track_info **ti;
+	/* state of do_add_job(), jobs of different types run in parallel */
+	struct track_info *ti_buffer[ADD_TI_BUFFER_SIZE];
+	int ti_buffer_fill;
+	/* tracks with estimated duration, scanned later */
+	struct update_data *scan_data;
+	/* created by the first playlist batch, freed when the job is done */
+	struct read_pool *read_pool;
 };
 
 void do_add_job(void *data);
 void free_add_job(void *data);
+/*
+ * newest error of an add job, reported by the main thread with
+ * error_msg().  returns NULL if there is none, free the result
+ */
+char *job_get_add_error(void);
+/* library at startup: the snapshot if it is up to date, else @name (lib.pl) */
+void do_load_lib_job(void *data);
 void do_update_job(void *data);
 void free_update_job(void *data);
 void do_update_cache_job(void *data);
 void free_update_cache_job(void *data);
+void do_scan_job(void *data);
+void free_scan_job(void *data);
+void do_watch_job(void *data);
+void free_watch_job(void *data);
+void do_watch_lib_job(void *data);
+void free_watch_lib_job(void *data);
 
 #endif
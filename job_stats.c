@@ -0,0 +1,181 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "job_stats.h"
+#include "worker.h"
+#include "cmus.h"
+#include "locking.h"
+#include "utils.h"
+
+#include <sys/time.h>
+#include <string.h>
+#include <pthread.h>
+
+struct codec_stats {
+	char name[16];
+	unsigned int files;
+	uint64_t usec;
+};
+
+#define NR_CODECS 32
+
+static pthread_mutex_t stats_mutex = CMUS_MUTEX_INITIALIZER;
+static struct job_stats stats;
+static struct codec_stats codecs[NR_CODECS];
+static int nr_codecs = 0;
+
+/* start of the current busy period */
+static uint64_t busy_start;
+static unsigned int base_discovered;
+static unsigned int base_processed;
+
+#define stats_lock() cmus_mutex_lock(&stats_mutex)
+#define stats_unlock() cmus_mutex_unlock(&stats_mutex)
+
+static uint64_t now_usec(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * (uint64_t)1000000 + tv.tv_usec;
+}
+
+/* stats must be locked */
+static void mark_busy(void)
+{
+	if (stats.busy)
+		return;
+	stats.busy = 1;
+	busy_start = now_usec();
+	base_discovered = stats.discovered;
+	base_processed = stats.processed;
+}
+
+void job_stats_discovered(int nr)
+{
+	stats_lock();
+	mark_busy();
+	stats.discovered += nr;
+	stats_unlock();
+}
+
+void job_stats_processed(void)
+{
+	stats_lock();
+	mark_busy();
+	stats.processed++;
+	stats_unlock();
+}
+
+void job_stats_cache(int hit)
+{
+	stats_lock();
+	if (hit) {
+		stats.cache_hits++;
+	} else {
+		stats.cache_misses++;
+	}
+	stats_unlock();
+}
+
+void job_stats_scanned(const char *codec, uint64_t usec)
+{
+	int i;
+
+	stats_lock();
+	stats.scanned++;
+	for (i = 0; i < nr_codecs; i++) {
+		if (!strcmp(codecs[i].name, codec))
+			break;
+	}
+	if (i == nr_codecs && nr_codecs < NR_CODECS) {
+		strncpy(codecs[i].name, codec, sizeof(codecs[i].name) - 1);
+		codecs[i].name[sizeof(codecs[i].name) - 1] = 0;
+		codecs[i].files = 0;
+		codecs[i].usec = 0;
+		nr_codecs++;
+	}
+	if (i < nr_codecs) {
+		codecs[i].files++;
+		codecs[i].usec += usec;
+	}
+	stats_unlock();
+}
+
+void job_stats_bytes(uint64_t bytes)
+{
+	stats_lock();
+	stats.bytes_read += bytes;
+	stats_unlock();
+}
+
+int job_stats_busy(void)
+{
+	/* low priority duration scans run long after the files were added */
+	return worker_has_job(JOB_TYPE_LIB) || worker_has_job(JOB_TYPE_PL) ||
+		worker_has_job(JOB_TYPE_QUEUE);
+}
+
+void job_stats_get(struct job_stats *s)
+{
+	int busy = job_stats_busy();
+
+	stats_lock();
+	if (!busy)
+		stats.busy = 0;
+	*s = stats;
+	s->batch_discovered = 0;
+	s->batch_processed = 0;
+	s->rate = 0;
+	s->eta = -1;
+	if (stats.busy) {
+		double secs = (now_usec() - busy_start) / 1e6;
+		int remaining;
+
+		s->batch_discovered = stats.discovered - base_discovered;
+		s->batch_processed = stats.processed - base_processed;
+		remaining = s->batch_discovered - s->batch_processed;
+		if (secs > 0)
+			s->rate = s->batch_processed / secs;
+		if (s->rate > 0)
+			s->eta = max(remaining, 0) / s->rate + 0.5;
+	}
+	stats_unlock();
+}
+
+void job_stats_for_each_codec(void (*cb)(const char *codec, unsigned int files,
+			uint64_t usec))
+{
+	int i;
+
+	stats_lock();
+	for (i = 0; i < nr_codecs; i++)
+		cb(codecs[i].name, codecs[i].files, codecs[i].usec);
+	stats_unlock();
+}
+
+void job_stats_format(struct gbuf *buf)
+{
+	struct job_stats s;
+	int i;
+
+	job_stats_get(&s);
+	gbuf_addf(buf, "jobs busy %d\n", s.busy);
+	gbuf_addf(buf, "jobs discovered %u\n", s.discovered);
+	gbuf_addf(buf, "jobs processed %u\n", s.processed);
+	gbuf_addf(buf, "jobs scanned %u\n", s.scanned);
+	gbuf_addf(buf, "jobs cache_hits %u\n", s.cache_hits);
+	gbuf_addf(buf, "jobs cache_misses %u\n", s.cache_misses);
+	gbuf_addf(buf, "jobs bytes_read %llu\n", (unsigned long long)s.bytes_read);
+	gbuf_addf(buf, "jobs files_per_sec %.1f\n", s.rate);
+	gbuf_addf(buf, "jobs eta %d\n", s.eta);
+
+	stats_lock();
+	for (i = 0; i < nr_codecs; i++) {
+		/* files and milliseconds spent reading tags */
+		gbuf_addf(buf, "jobs codec %s %u %llu\n", codecs[i].name, codecs[i].files,
+				(unsigned long long)(codecs[i].usec / 1000));
+	}
+	stats_unlock();
+}
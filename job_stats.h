@@ -0,0 +1,57 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _JOB_STATS_H
+#define _JOB_STATS_H
+
+#include "gbuf.h"
+
+#include <stdint.h>
+
+/*
+ * Counters for the background jobs (adding files, updating the cache,
+ * scanning durations).  Totals are kept since startup, rate and ETA are
+ * for the jobs run since the worker was last idle.
+ */
+struct job_stats {
+	/* files found by add jobs (directory walks, playlists) */
+	unsigned int discovered;
+	/* files handled by add jobs */
+	unsigned int processed;
+	/* files whose tags were read */
+	unsigned int scanned;
+	unsigned int cache_hits;
+	unsigned int cache_misses;
+	/* bytes read by the ID3 and APE tag readers */
+	uint64_t bytes_read;
+
+	int busy;
+	/* discovered and processed since the worker was idle */
+	unsigned int batch_discovered;
+	unsigned int batch_processed;
+	/* files processed per second, 0 if not busy */
+	double rate;
+	/* seconds, -1 if unknown */
+	int eta;
+};
+
+void job_stats_discovered(int nr);
+void job_stats_processed(void);
+void job_stats_cache(int hit);
+/* @codec: file extension, @usec: time spent reading tags */
+void job_stats_scanned(const char *codec, uint64_t usec);
+void job_stats_bytes(uint64_t bytes);
+
+/* jobs that add files are queued or running, JOB_TYPE_SCAN doesn't count */
+int job_stats_busy(void);
+
+void job_stats_get(struct job_stats *s);
+
+void job_stats_for_each_codec(void (*cb)(const char *codec, unsigned int files,
+			uint64_t usec));
+
+/* "jobs <key> <value>\n" lines for cmus-remote and D-Bus */
+void job_stats_format(struct gbuf *buf);
+
+#endif
@@ -6,6 +6,8 @@
 #include "editable.h"
 #include "track_info.h"
 #include "options.h"
+#include "slab.h"
+#include "ti_hash.h"
 #include "xmalloc.h"
 #include "debug.h"
 #include "dbus-server.h"
@@ -22,6 +24,8 @@ static LIST_HEAD(lib_shuffle_head);
 static struct expr *filter = NULL;
 static int remove_from_hash = 1;
 
+static SLAB(tree_track_slab, struct tree_track);
+
 static inline struct tree_track *to_sorted(const struct list_head *item)
 {
 	return (struct tree_track *)container_of(item, struct simple_track, node);
@@ -48,7 +52,7 @@ static void shuffle_add(struct tree_track *track)
 
 static void views_add_track(struct track_info *ti)
 {
-	struct tree_track *track = xnew(struct tree_track, 1);
+	struct tree_track *track = slab_alloc(&tree_track_slab);
 
 	/* NOTE: does not ref ti */
 	simple_track_init((struct simple_track *)track, ti);
@@ -61,71 +65,24 @@ static void views_add_track(struct track_info *ti)
 	editable_add(&lib_editable, (struct simple_track *)track);
 }
 
-struct fh_entry {
-	struct fh_entry *next;
-
-	/* ref count is increased when added to this hash */
-	struct track_info *ti;
-};
-
-#define FH_SIZE (1024)
-static struct fh_entry *ti_hash[FH_SIZE] = { NULL, };
-
-/* this is from glib */
-static unsigned int str_hash(const char *str)
-{
-	unsigned int hash = 0;
-	int i;
-
-	for (i = 0; str[i]; i++)
-		hash = (hash << 5) - hash + str[i];
-	return hash;
-}
+/* ref count is increased when added to this hash */
+static TI_HASH(lib_hash);
 
 static int hash_insert(struct track_info *ti)
 {
-	const char *filename = ti->filename;
-	unsigned int pos = str_hash(filename) % FH_SIZE;
-	struct fh_entry **entryp;
-	struct fh_entry *e;
-
-	entryp = &ti_hash[pos];
-	e = *entryp;
-	while (e) {
-		if (strcmp(e->ti->filename, filename) == 0) {
-			/* found, don't insert */
-			return 0;
-		}
-		e = e->next;
-	}
-
-	e = xnew(struct fh_entry, 1);
+	if (!ti_hash_insert(&lib_hash, ti))
+		return 0;
 	track_info_ref(ti);
-	e->ti = ti;
-	e->next = *entryp;
-	*entryp = e;
 	return 1;
 }
 
 static void hash_remove(struct track_info *ti)
 {
-	const char *filename = ti->filename;
-	unsigned int pos = str_hash(filename) % FH_SIZE;
-	struct fh_entry **entryp;
-
-	entryp = &ti_hash[pos];
-	while (1) {
-		struct fh_entry *e = *entryp;
-
-		BUG_ON(e == NULL);
-		if (strcmp(e->ti->filename, filename) == 0) {
-			*entryp = e->next;
-			track_info_unref(e->ti);
-			free(e);
-			break;
-		}
-		entryp = &e->next;
-	}
+	struct track_info *e = ti_hash_lookup(&lib_hash, ti->filename, ti->hash);
+
+	BUG_ON(e == NULL);
+	ti_hash_remove(&lib_hash, e);
+	track_info_unref(e);
 }
 
 void lib_add_track(struct track_info *ti)
@@ -289,7 +246,7 @@ static void free_lib_track(struct list_head *item)
 	tree_remove(track);
 
 	track_info_unref(ti);
-	free(track);
+	slab_free(&tree_track_slab, track);
 }
 
 void lib_init(void)
@@ -364,6 +321,46 @@ struct track_info *sorted_set_selected(void)
 	return lib_set_track(iter_to_sorted_track(&sel));
 }
 
+void lib_add_snapshot(struct track_info **tis, const int *pos, int nr)
+{
+	struct tree_track **sorted = xnew0(struct tree_track *, nr);
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		struct track_info *ti = tis[i];
+		struct tree_track *track;
+
+		if (ti == NULL || !hash_insert(ti))
+			continue;
+		if (filter && !expr_eval(filter, ti))
+			continue;
+
+		track = slab_alloc(&tree_track_slab);
+		simple_track_init((struct simple_track *)track, ti);
+		track_info_ref(ti);
+		/* shuffled once when all tracks have been added */
+		list_add_tail(&track->shuffle_track.node, &lib_shuffle_head);
+
+		if (pos[i] >= 0 && pos[i] < nr && !sorted[pos[i]]) {
+			/* saved in tree order */
+			tree_append_track(track);
+			sorted[pos[i]] = track;
+		} else {
+			/* was filtered out when the snapshot was saved */
+			tree_add_track(track);
+			editable_add(&lib_editable, (struct simple_track *)track);
+		}
+	}
+
+	/* in sort order editable_add() compares only with the last track */
+	for (i = 0; i < nr; i++) {
+		if (sorted[i])
+			editable_add(&lib_editable, (struct simple_track *)sorted[i]);
+	}
+	free(sorted);
+	lib_reshuffle();
+}
+
 void lib_set_filter(struct expr *expr)
 {
 	static const char *tmp_keys[1] = { NULL };
@@ -389,17 +386,11 @@ void lib_set_filter(struct expr *expr)
 	sort_keys = lib_editable.sort_keys;
 	lib_editable.sort_keys = tmp_keys;
 
-	for (i = 0; i < FH_SIZE; i++) {
-		struct fh_entry *e;
-
-		e = ti_hash[i];
-		while (e) {
-			struct track_info *ti = e->ti;
+	for (i = 0; i < lib_hash.size; i++) {
+		struct track_info *ti = lib_hash.slots[i];
 
-			if (filter == NULL || expr_eval(filter, ti))
-				views_add_track(ti);
-			e = e->next;
-		}
+		if (ti && (filter == NULL || expr_eval(filter, ti)))
+			views_add_track(ti);
 	}
 
 	/* enable sorting */
@@ -442,18 +433,11 @@ void lib_clear_store(void)
 {
 	int i;
 
-	for (i = 0; i < FH_SIZE; i++) {
-		struct fh_entry *e, *next;
-
-		e = ti_hash[i];
-		while (e) {
-			next = e->next;
-			track_info_unref(e->ti);
-			free(e);
-			e = next;
-		}
-		ti_hash[i] = NULL;
+	for (i = 0; i < lib_hash.size; i++) {
+		if (lib_hash.slots[i])
+			track_info_unref(lib_hash.slots[i]);
 	}
+	ti_hash_free(&lib_hash);
 }
 
 void sorted_sel_current(void)
@@ -466,7 +450,7 @@ void sorted_sel_current(void)
 	}
 }
 
-static int ti_cmp(const void *a, const void *b)
+int lib_ti_cmp(const void *a, const void *b)
 {
 	const struct track_info *ai = *(const struct track_info **)a;
 	const struct track_info *bi = *(const struct track_info **)b;
@@ -476,34 +460,14 @@ static int ti_cmp(const void *a, const void *b)
 
 int lib_for_each(int (*cb)(void *data, struct track_info *ti), void *data)
 {
-	int i, rc = 0, count = 0, size = 1024;
-	struct track_info **tis;
-
-	tis = xnew(struct track_info *, size);
-
-	/* collect all track_infos */
-	for (i = 0; i < FH_SIZE; i++) {
-		struct fh_entry *e;
+	int i, rc;
 
-		e = ti_hash[i];
-		while (e) {
-			if (count == size) {
-				size *= 2;
-				tis = xrenew(struct track_info *, tis, size);
-			}
-			tis[count++] = e->ti;
-			e = e->next;
-		}
-	}
-
-	/* sort to speed up playlist loading */
-	qsort(tis, count, sizeof(struct track_info *), ti_cmp);
-	for (i = 0; i < count; i++) {
-		rc = cb(data, tis[i]);
+	for (i = 0; i < lib_hash.size; i++) {
+		if (lib_hash.slots[i] == NULL)
+			continue;
+		rc = cb(data, lib_hash.slots[i]);
 		if (rc)
-			break;
+			return rc;
 	}
-
-	free(tis);
-	return rc;
+	return 0;
 }
@@ -78,16 +78,32 @@ void tree_init(void);
 struct track_info *lib_set_next(void);
 struct track_info *lib_set_prev(void);
 void lib_add_track(struct track_info *track_info);
+/*
+ * adds the tracks of a library snapshot (see lib_snapshot.h) by appending
+ * them to the views.  editable lock must be held
+ *
+ * @tis  in tree order, NULL entries are skipped
+ * @pos  position of each track in the sorted view, -1 if unknown
+ */
+void lib_add_snapshot(struct track_info **tis, const int *pos, int nr);
 void lib_set_filter(struct expr *expr);
 int lib_remove(struct track_info *ti);
 void lib_clear_store(void);
 void lib_reshuffle(void);
 void lib_set_view(int view);
+/* all tracks, also filtered ones, in no particular order */
 int lib_for_each(int (*cb)(void *data, struct track_info *ti), void *data);
+/* qsort() compare function for struct track_info ** in sort order */
+int lib_ti_cmp(const void *a, const void *b);
 
 struct track_info *tree_set_selected(void);
 void tree_sort_artists(void);
 void tree_add_track(struct tree_track *track);
+/*
+ * like tree_add_track() but fast if @track belongs after the last track
+ * of the tree.  the track order within an album is not checked
+ */
+void tree_append_track(struct tree_track *track);
 void tree_remove(struct tree_track *track);
 void tree_remove_sel(void);
 void tree_toggle_active_window(void);
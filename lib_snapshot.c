@@ -0,0 +1,248 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "lib_snapshot.h"
+#include "lib.h"
+#include "cache.h"
+#include "misc.h"
+#include "file.h"
+#include "gbuf.h"
+#include "load_dir.h"
+#include "options.h"
+#include "xmalloc.h"
+#include "xstrjoin.h"
+#include "utils.h"
+#include "debug.h"
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define SNAPSHOT_MAGIC "cmus-lib-snapshot 1"
+
+struct sorted_pos {
+	const struct track_info *ti;
+	int pos;
+};
+
+struct save_data {
+	struct atomic_file file;
+	struct sorted_pos *sorted;
+	int nr_sorted;
+};
+
+static char *snapshot_filename(void)
+{
+	return xstrjoin(cmus_config_dir, "/lib.snapshot");
+}
+
+static void add_file_key(struct gbuf *buf, const char *name, const struct stat *st)
+{
+	/* rename() gives a new inode, mtime alone isn't exact enough */
+	gbuf_addf(buf, " %s=%lu,%lld,%ld", name, (unsigned long)st->st_ino,
+			(long long)st->st_size, (long)st->st_mtime);
+}
+
+/* what the snapshot depends on, NULL if lib.pl or the cache doesn't exist */
+static char *snapshot_key(const char *lib_pl)
+{
+	const char *cache = cache_get_filename();
+	struct stat lib_st, cache_st;
+	GBUF(buf);
+
+	if (cache == NULL || stat(lib_pl, &lib_st) || stat(cache, &cache_st))
+		return NULL;
+
+	gbuf_addf(&buf, "sort=%s fuzzy=%d", lib_editable.sort_str, fuzzy_artist_sort);
+	add_file_key(&buf, "lib", &lib_st);
+	add_file_key(&buf, "cache", &cache_st);
+	return gbuf_steal(&buf);
+}
+
+static int sorted_pos_cmp(const void *a, const void *b)
+{
+	const struct track_info *ai = ((const struct sorted_pos *)a)->ti;
+	const struct track_info *bi = ((const struct sorted_pos *)b)->ti;
+
+	return ai < bi ? -1 : ai > bi;
+}
+
+static int sorted_pos_get(struct save_data *d, const struct track_info *ti)
+{
+	struct sorted_pos key, *found;
+
+	key.ti = ti;
+	found = bsearch(&key, d->sorted, d->nr_sorted, sizeof(key), sorted_pos_cmp);
+	return found ? found->pos : -1;
+}
+
+static int add_line(struct save_data *d, int pos, const char *filename)
+{
+	gbuf_addf(&d->file.buf, "%d\t%s\n", pos, filename);
+	return atomic_file_flush(&d->file);
+}
+
+/* tracks not in the views */
+static int add_filtered_cb(void *data, struct track_info *ti)
+{
+	struct save_data *d = data;
+
+	if (sorted_pos_get(d, ti) != -1)
+		return 0;
+	return add_line(d, -1, ti->filename);
+}
+
+static int write_tracks(struct save_data *d)
+{
+	struct artist *artist;
+	struct album *album;
+	struct tree_track *track;
+
+	list_for_each_entry(artist, &lib_artist_head, node) {
+		list_for_each_entry(album, &artist->album_head, node) {
+			list_for_each_entry(track, &album->track_head, node) {
+				const struct track_info *ti = tree_track_info(track);
+
+				if (add_line(d, sorted_pos_get(d, ti), ti->filename))
+					return -1;
+			}
+		}
+	}
+	return lib_for_each(add_filtered_cb, d);
+}
+
+int lib_snapshot_save(const char *lib_pl)
+{
+	struct save_data d;
+	struct simple_track *t;
+	char *key, *filename;
+	int rc;
+
+	filename = snapshot_filename();
+	key = snapshot_key(lib_pl);
+	if (key == NULL) {
+		unlink(filename);
+		free(filename);
+		return -1;
+	}
+
+	if (atomic_file_open(&d.file, filename)) {
+		d_print("saving library snapshot: %s\n", strerror(errno));
+		free(filename);
+		free(key);
+		return -1;
+	}
+	free(filename);
+
+	d.sorted = xnew(struct sorted_pos, lib_editable.nr_tracks);
+	d.nr_sorted = 0;
+	list_for_each_entry(t, &lib_editable.head, node) {
+		d.sorted[d.nr_sorted].ti = t->info;
+		d.sorted[d.nr_sorted].pos = d.nr_sorted;
+		d.nr_sorted++;
+	}
+	qsort(d.sorted, d.nr_sorted, sizeof(struct sorted_pos), sorted_pos_cmp);
+
+	gbuf_addf(&d.file.buf, "%s\n%s\n", SNAPSHOT_MAGIC, key);
+	/* a failed write is reported by atomic_file_close() */
+	write_tracks(&d);
+	free(d.sorted);
+	free(key);
+
+	rc = atomic_file_close(&d.file);
+	if (rc)
+		d_print("saving library snapshot: %s\n", strerror(errno));
+	return rc;
+}
+
+/* returns length of the next line starting at *@linep, or -1 */
+static int next_line(const char **bufp, const char *end, const char **linep)
+{
+	const char *line = *bufp, *nl;
+
+	if (line >= end)
+		return -1;
+	nl = memchr(line, '\n', end - line);
+	if (nl == NULL)
+		return -1;
+	*linep = line;
+	*bufp = nl + 1;
+	return nl - line;
+}
+
+static int line_equal(const char *line, int len, const char *str)
+{
+	return len == strlen(str) && !memcmp(line, str, len);
+}
+
+int lib_snapshot_read(const char *lib_pl, char ***filenamesp, int **posp)
+{
+	PTR_ARRAY(filenames);
+	const char *ptr, *end, *line;
+	char *filename, *key, *buf;
+	int *pos = NULL;
+	int size, len, nr = 0, alloc = 0;
+
+	filename = snapshot_filename();
+	key = snapshot_key(lib_pl);
+	buf = key ? mmap_file(filename, &size) : NULL;
+	free(filename);
+	if (buf == NULL) {
+		free(key);
+		return -1;
+	}
+
+	ptr = buf;
+	end = buf + size;
+	len = next_line(&ptr, end, &line);
+	if (len == -1 || !line_equal(line, len, SNAPSHOT_MAGIC))
+		goto out_of_date;
+	len = next_line(&ptr, end, &line);
+	if (len == -1 || !line_equal(line, len, key)) {
+		d_print("library snapshot is out of date\n");
+		goto out_of_date;
+	}
+
+	while ((len = next_line(&ptr, end, &line)) != -1) {
+		const char *tab = memchr(line, '\t', len);
+		char num[16];
+		long int val;
+
+		if (tab == NULL || tab - line >= sizeof(num))
+			goto corrupt;
+		memcpy(num, line, tab - line);
+		num[tab - line] = 0;
+		if (str_to_int(num, &val))
+			goto corrupt;
+		if (nr == alloc) {
+			alloc = alloc ? alloc * 2 : 1024;
+			pos = xrenew(int, pos, alloc);
+		}
+		pos[nr++] = val;
+		tab++;
+		ptr_array_add(&filenames, xstrndup(tab, line + len - tab));
+	}
+	if (ptr != end)
+		goto corrupt;
+
+	munmap(buf, size);
+	free(key);
+	ptr_array_plug(&filenames);
+	*filenamesp = filenames.ptrs;
+	*posp = pos;
+	return nr;
+corrupt:
+	d_print("library snapshot is corrupt\n");
+	ptr_array_plug(&filenames);
+	free_str_array(filenames.ptrs);
+	free(pos);
+out_of_date:
+	munmap(buf, size);
+	free(key);
+	return -1;
+}
@@ -0,0 +1,31 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _LIB_SNAPSHOT_H
+#define _LIB_SNAPSHOT_H
+
+/*
+ * Library snapshot, saved on exit next to lib.pl.  Lists all tracks of the
+ * library in tree view order together with their positions in the sorted
+ * view, so that the views can be rebuilt at startup by appending instead
+ * of inserting every track.
+ *
+ * The snapshot is used only if lib.pl, the track cache, lib_sort and
+ * fuzzy_artist_sort are the same as when it was saved.  Otherwise lib.pl
+ * is loaded as usual.
+ */
+
+/* call after lib.pl and the cache have been written.  returns 0 or -1 */
+int lib_snapshot_save(const char *lib_pl);
+
+/*
+ * reads the snapshot if it matches @lib_pl.  returns number of tracks or
+ * -1 if there is no usable snapshot
+ *
+ * @filenames  filenames in tree order, free with free_str_array()
+ * @pos        sorted view positions, -1 for tracks filtered out
+ */
+int lib_snapshot_read(const char *lib_pl, char ***filenames, int **pos);
+
+#endif
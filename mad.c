@@ -69,7 +69,8 @@ static int mad_open(struct input_plugin_data *ip_data)
 	struct nomad_info info;
 	int rc, fast;
 
-	fast = 1;
+	/* full scan is slow, it's done in the background (ip_set_exact) */
+	fast = !ip_data->exact;
 	rc = nomad_open_callbacks(&nomad, ip_data, fast, &callbacks);
 	switch (rc) {
 	case -NOMAD_ERROR_ERRNO:
@@ -79,7 +80,16 @@ static int mad_open(struct input_plugin_data *ip_data)
 	}
 	ip_data->private = nomad;
 
+	if (ip_data->exact) {
+		free(ip_data->seek_idx);
+		ip_data->seek_idx_size = nomad_get_seek_idx(nomad, &ip_data->seek_idx);
+	} else if (ip_data->seek_idx) {
+		if (nomad_set_seek_idx(nomad, ip_data->seek_idx, ip_data->seek_idx_size))
+			d_print("invalid seek index for %s\n", ip_data->filename);
+	}
+
 	nomad_info(nomad, &info);
+	ip_data->duration_estimated = info.estimated;
 
 	/* always 16-bit signed little-endian */
 	ip_data->sf = sf_rate(info.sample_rate) | sf_channels(info.channels) |
@@ -117,8 +127,9 @@ static int mad_seek(struct input_plugin_data *ip_data, double offset)
 static int mad_read_comments(struct input_plugin_data *ip_data,
 		struct keyval **comments)
 {
+	struct tag_probe tp;
 	struct id3tag id3;
-	int fd, rc, save, i;
+	int fd, rc, i;
 	APETAG(ape);
 	GROWING_KEYVALS(c);
 
@@ -128,14 +139,21 @@ static int mad_read_comments(struct input_plugin_data *ip_data,
 	}
 	d_print("filename: %s\n", ip_data->filename);
 
+	/* one probe for both ID3 and APE tags */
+	if (tag_probe_init(&tp, fd)) {
+		d_print("error: %s\n", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
 	id3_init(&id3);
-	rc = id3_read_tags(&id3, fd, ID3_V1 | ID3_V2);
-	save = errno;
-	close(fd);
-	errno = save;
+	rc = id3_read_tags_probe(&id3, &tp, ID3_V1 | ID3_V2);
 	if (rc) {
 		if (rc == -1) {
 			d_print("error: %s\n", strerror(errno));
+			id3_free(&id3);
+			tag_probe_free(&tp);
+			close(fd);
 			return -1;
 		}
 		d_print("corrupted tag?\n");
@@ -152,7 +170,7 @@ static int mad_read_comments(struct input_plugin_data *ip_data,
 next:
 	id3_free(&id3);
 
-	rc = ape_read_tags(&ape, ip_data->fd, 0);
+	rc = ape_read_tags_probe(&ape, &tp, 0);
 	if (rc < 0)
 		goto out;
 
@@ -167,6 +185,8 @@ next:
 
 out:
 	ape_free(&ape);
+	tag_probe_free(&tp);
+	close(fd);
 
 	keyvals_terminate(&c);
 	*comments = c.keyvals;
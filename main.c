@@ -6,9 +6,11 @@
 #include "file.h"
 #include "path.h"
 #include "xmalloc.h"
+#include "gbuf.h"
 
 #include <unistd.h>
 #include <fcntl.h>
+#include <poll.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <sys/un.h>
@@ -96,6 +98,32 @@ static void send_cmd(const char *format, ...)
 	write_line(buf);
 }
 
+/* copies status updates to stdout, each update ends with an empty line */
+static void watch(const char *interval)
+{
+	char buf[8192];
+	char cmd[64];
+
+	snprintf(cmd, sizeof(cmd), "subscribe %s\n", interval ? interval : "");
+	if (write_all(sock, cmd, strlen(cmd)) == -1)
+		die_errno("write");
+
+	while (1) {
+		int rc = read(sock, buf, sizeof(buf));
+
+		if (rc < 0) {
+			if (errno == EINTR)
+				continue;
+			die_errno("read");
+		}
+		/* cmus exited */
+		if (!rc)
+			return;
+		if (write_all(1, buf, rc) == -1)
+			die_errno("write");
+	}
+}
+
 static void remote_connect(const char *address)
 {
 	union {
@@ -157,8 +185,10 @@ static void remote_connect(const char *address)
 		die_errno("connect");
 	}
 
-	if (passwd)
-		send_cmd("%s\n", passwd);
+	/* the password line isn't answered */
+	if (passwd && (write_all(sock, passwd, strlen(passwd)) == -1 ||
+				write_all(sock, "\n", 1) == -1))
+		die_errno("write");
 }
 
 static char *file_url_absolute(const char *str)
@@ -174,6 +204,231 @@ static char *file_url_absolute(const char *str)
 	return absolute;
 }
 
+/* --batch {{{ */
+
+/* requests sent before waiting for their answers */
+#define BATCH_WINDOW 64
+/* max size of an add-batch request */
+#define BATCH_ADD_SIZE (64 * 1024)
+
+/* requests not yet written to sock */
+static GBUF(batch_out);
+static size_t batch_out_pos;
+/* requests sent or queued but not answered */
+static int batch_pending;
+/* add-batch request being built, not in batch_out yet */
+static GBUF(batch_add);
+static int batch_add_flag;
+
+static void add_escaped_name(struct gbuf *buf, const char *name)
+{
+	for (; *name; name++) {
+		if (*name == '\\') {
+			gbuf_add_str(buf, "\\\\");
+		} else if (*name == '\t') {
+			gbuf_add_str(buf, "\\t");
+		} else if (*name == '\n') {
+			gbuf_add_str(buf, "\\n");
+		} else {
+			gbuf_add_ch(buf, *name);
+		}
+	}
+}
+
+static void batch_add_flush(void)
+{
+	if (batch_add.len == 0)
+		return;
+	gbuf_add_bytes(&batch_out, batch_add.buffer, batch_add.len);
+	gbuf_add_ch(&batch_out, '\n');
+	gbuf_clear(&batch_add);
+	batch_pending++;
+}
+
+/*
+ * "add [-l|-p|-q|-Q] NAME" can be merged into an add-batch request.
+ * returns the flag (0 if none) or -1
+ */
+static int parse_add(const char *line, const char **name)
+{
+	int flag = 0;
+
+	if (strncmp(line, "add ", 4))
+		return -1;
+	line += 4;
+	if (line[0] == '-') {
+		if (!strchr("lpqQ", line[1]) || line[1] == 0 || line[2] != ' ')
+			return -1;
+		flag = line[1];
+		line += 3;
+	}
+	/* ~ is expanded only by add */
+	if (line[0] == 0 || line[0] == '~' || line[0] == '-' || line[0] == ' ')
+		return -1;
+	*name = line;
+	return flag;
+}
+
+/*
+ * queues requests for complete lines in @in, returns number of bytes used.
+ * stops when BATCH_WINDOW requests are waiting for answers
+ */
+static size_t batch_queue_lines(char *in, size_t len, int eof)
+{
+	size_t pos = 0;
+
+	while (pos < len) {
+		char *line = in + pos;
+		char *nl = memchr(line, '\n', len - pos);
+		const char *name;
+		size_t line_len;
+		int flag;
+
+		if (nl == NULL) {
+			if (!eof)
+				break;
+			/* last line without newline */
+			nl = in + len;
+		}
+		line_len = nl - line;
+		*nl = 0;
+
+		flag = parse_add(line, &name);
+		if (flag != -1 && batch_add.len && flag == batch_add_flag &&
+				batch_add.len + line_len < BATCH_ADD_SIZE) {
+			gbuf_add_ch(&batch_add, '\t');
+			add_escaped_name(&batch_add, name);
+		} else {
+			if (batch_pending >= BATCH_WINDOW) {
+				if (nl < in + len)
+					*nl = '\n';
+				break;
+			}
+			batch_add_flush();
+			if (flag != -1) {
+				batch_add_flag = flag;
+				gbuf_add_str(&batch_add, "add-batch ");
+				if (flag)
+					gbuf_addf(&batch_add, "-%c ", flag);
+				add_escaped_name(&batch_add, name);
+			} else {
+				gbuf_add_bytes(&batch_out, line, line_len);
+				gbuf_add_ch(&batch_out, '\n');
+				batch_pending++;
+			}
+		}
+		pos += line_len + 1;
+	}
+	if (pos > len)
+		pos = len;
+	/* don't wait for more add lines, stdin may be slow */
+	batch_add_flush();
+	return pos;
+}
+
+/* writes answers to stdout without the empty lines that end them */
+static void batch_read_answers(void)
+{
+	static int line_start = 1;
+	char buf[8192];
+	int rc, i, start = 0;
+
+	rc = read(sock, buf, sizeof(buf));
+	if (rc == -1) {
+		if (errno == EINTR || errno == EAGAIN)
+			return;
+		die_errno("read");
+	}
+	if (rc == 0)
+		die("unexpected EOF\n");
+
+	for (i = 0; i < rc; i++) {
+		if (buf[i] == '\n' && line_start) {
+			if (write_all(1, buf + start, i - start) == -1)
+				die_errno("write");
+			start = i + 1;
+			batch_pending--;
+			continue;
+		}
+		line_start = buf[i] == '\n';
+	}
+	if (write_all(1, buf + start, rc - start) == -1)
+		die_errno("write");
+}
+
+/*
+ * sends raw commands from stdin over one connection without waiting for
+ * each answer, consecutive add commands are sent as add-batch requests
+ */
+static void batch(void)
+{
+	GBUF(in);
+	size_t in_pos = 0;
+	int eof = 0;
+
+	while (!eof || in_pos < in.len || batch_pending) {
+		struct pollfd fds[2];
+		int nr_fds = 1;
+
+		in_pos += batch_queue_lines(in.buffer + in_pos, in.len - in_pos, eof);
+		if (in_pos == in.len) {
+			gbuf_clear(&in);
+			in_pos = 0;
+		}
+
+		fds[0].fd = sock;
+		fds[0].events = POLLIN;
+		if (batch_out_pos < batch_out.len)
+			fds[0].events |= POLLOUT;
+		/* no more lines until some answers have been read */
+		if (!eof && batch_pending < BATCH_WINDOW) {
+			fds[1].fd = 0;
+			fds[1].events = POLLIN;
+			nr_fds = 2;
+		}
+
+		if (poll(fds, nr_fds, -1) == -1) {
+			if (errno == EINTR)
+				continue;
+			die_errno("poll");
+		}
+
+		if (fds[0].revents & POLLOUT) {
+			int rc = write(sock, batch_out.buffer + batch_out_pos,
+					batch_out.len - batch_out_pos);
+
+			if (rc == -1 && errno != EINTR && errno != EAGAIN)
+				die_errno("write");
+			if (rc > 0)
+				batch_out_pos += rc;
+			if (batch_out_pos == batch_out.len) {
+				gbuf_clear(&batch_out);
+				batch_out_pos = 0;
+			}
+		}
+		if (fds[0].revents & (POLLIN | POLLHUP | POLLERR))
+			batch_read_answers();
+		if (nr_fds == 2 && fds[1].revents) {
+			int rc;
+
+			gbuf_grow(&in, 65536);
+			rc = read(0, in.buffer + in.len, 65536);
+			if (rc == -1) {
+				if (errno != EINTR && errno != EAGAIN)
+					die_errno("read");
+			} else if (rc == 0) {
+				eof = 1;
+			} else {
+				in.len += rc;
+				in.buffer[in.len] = 0;
+			}
+		}
+	}
+	gbuf_free(&in);
+}
+
+/* }}} */
+
 enum flags {
 	FLAG_SERVER,
 	FLAG_PASSWD,
@@ -191,14 +446,17 @@ enum flags {
 	FLAG_VOLUME,
 	FLAG_SEEK,
 	FLAG_QUERY,
+	FLAG_WATCH,
+	FLAG_INTERVAL,
 
 	FLAG_LIBRARY,
 	FLAG_PLAYLIST,
 	FLAG_QUEUE,
 	FLAG_CLEAR,
 
-	FLAG_RAW
-#define NR_FLAGS (FLAG_RAW + 1)
+	FLAG_RAW,
+	FLAG_BATCH
+#define NR_FLAGS (FLAG_BATCH + 1)
 };
 
 static struct option options[NR_FLAGS + 1] = {
@@ -218,6 +476,8 @@ static struct option options[NR_FLAGS + 1] = {
 	{ 'v', "volume", 1 },
 	{ 'k', "seek", 1 },
 	{ 'Q', "query", 0 },
+	{ 'W', "watch", 0 },
+	{ 0, "interval", 1 },
 
 	{ 'l', "library", 0 },
 	{ 'P', "playlist", 0 },
@@ -225,6 +485,7 @@ static struct option options[NR_FLAGS + 1] = {
 	{ 'c', "clear", 0 },
 
 	{ 'C', "raw", 0 },
+	{ 0, "batch", 0 },
 	{ 0, NULL, 0 }
 };
 
@@ -255,6 +516,10 @@ static const char *usage =
 "  -v, --volume VOL     vol VOL\n"
 "  -k, --seek SEEK      seek SEEK\n"
 "  -Q, --query          get player status (same as -C status)\n"
+"  -W, --watch          print player status and then changes to it until\n"
+"                       cmus exits\n"
+"      --interval MS    position update interval for --watch (default 1000,\n"
+"                       0 disables)\n"
 "\n"
 "  -l, --library        modify library instead of playlist\n"
 "  -P, --playlist       modify playlist (default)\n"
@@ -265,6 +530,8 @@ static const char *usage =
 "\n"
 "Raw mode:\n"
 "  -C, --raw            treat arguments (instead of stdin) as raw commands\n"
+"      --batch          send raw commands from stdin without waiting for each\n"
+"                       answer\n"
 "\n"
 "  By default cmus-remote reads raw commands from stdin (one command per line).\n"
 "\n"
@@ -277,6 +544,7 @@ int main(int argc, char *argv[])
 	char *play_file = NULL;
 	char *volume = NULL;
 	char *seek = NULL;
+	char *interval = NULL;
 	int query = 0;
 	int i, nr_cmds = 0;
 	int context = 'p';
@@ -317,6 +585,12 @@ int main(int argc, char *argv[])
 			query = 1;
 			nr_cmds++;
 			break;
+		case FLAG_WATCH:
+			nr_cmds++;
+			break;
+		case FLAG_INTERVAL:
+			interval = arg;
+			break;
 		case FLAG_FILE:
 			play_file = arg;
 			nr_cmds++;
@@ -343,11 +617,15 @@ int main(int argc, char *argv[])
 		case FLAG_RAW:
 			raw_args = 1;
 			break;
+		case FLAG_BATCH:
+			break;
 		}
 	}
 
 	if (nr_cmds && raw_args)
 		die("don't mix raw and cooked stuff\n");
+	if (flags[FLAG_BATCH] && (nr_cmds || raw_args || argv[0]))
+		die("--batch reads commands from stdin only\n");
 
 	if (server == NULL) {
 		const char *config_dir = getenv("CMUS_HOME");
@@ -372,6 +650,11 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 
+	if (flags[FLAG_BATCH]) {
+		batch();
+		return 0;
+	}
+
 	if (nr_cmds == 0 && argv[0] == NULL) {
 		char line[512];
 
@@ -382,11 +665,29 @@ int main(int argc, char *argv[])
 
 	if (flags[FLAG_CLEAR])
 		send_cmd("clear -%c\n", context);
-	for (i = 0; argv[i]; i++) {
-		char *filename = file_url_absolute(argv[i]);
-
-		send_cmd("add -%c %s\n", context, filename);
-		free(filename);
+	if (argv[0]) {
+		GBUF(buf);
+
+		/* all files in as few add-batch requests as possible */
+		for (i = 0; argv[i]; i++) {
+			char *filename = file_url_absolute(argv[i]);
+
+			if (buf.len && buf.len + strlen(filename) >= BATCH_ADD_SIZE) {
+				gbuf_add_ch(&buf, '\n');
+				write_line(buf.buffer);
+				gbuf_clear(&buf);
+			}
+			if (buf.len) {
+				gbuf_add_ch(&buf, '\t');
+			} else {
+				gbuf_addf(&buf, "add-batch -%c ", context);
+			}
+			add_escaped_name(&buf, filename);
+			free(filename);
+		}
+		gbuf_add_ch(&buf, '\n');
+		write_line(buf.buffer);
+		gbuf_free(&buf);
 	}
 	if (flags[FLAG_REPEAT])
 		send_cmd("toggle repeat\n");
@@ -410,5 +711,7 @@ int main(int argc, char *argv[])
 		send_cmd("seek %s\n", seek);
 	if (query)
 		send_cmd("status\n");
+	if (flags[FLAG_WATCH])
+		watch(interval);
 	return 0;
 }
@@ -307,10 +307,8 @@ static int mp4_seek(struct input_plugin_data *ip_data, double offset)
 	return 0;
 }
 
-static int mp4_read_comments(struct input_plugin_data *ip_data,
-		struct keyval **comments)
+static struct keyval *get_comments(MP4FileHandle handle)
 {
-	struct mp4_private *priv;
 	uint16_t meta_num, meta_total;
 	uint8_t val;
 	/*uint8_t *ustr;
@@ -318,25 +316,23 @@ static int mp4_read_comments(struct input_plugin_data *ip_data,
 	char *str;
 	GROWING_KEYVALS(c);
 
-	priv = ip_data->private;
-
 	/* MP4GetMetadata* provides malloced pointers, and the data
 	 * is in UTF-8 (or at least it should be). */
-	if (MP4GetMetadataArtist(priv->mp4.handle, &str))
+	if (MP4GetMetadataArtist(handle, &str))
 		comments_add(&c, "artist", str);
-	if (MP4GetMetadataAlbum(priv->mp4.handle, &str))
+	if (MP4GetMetadataAlbum(handle, &str))
 		comments_add(&c, "album", str);
-	if (MP4GetMetadataName(priv->mp4.handle, &str))
+	if (MP4GetMetadataName(handle, &str))
 		comments_add(&c, "title", str);
-	if (MP4GetMetadataGenre(priv->mp4.handle, &str))
+	if (MP4GetMetadataGenre(handle, &str))
 		comments_add(&c, "genre", str);
-	if (MP4GetMetadataYear(priv->mp4.handle, &str))
+	if (MP4GetMetadataYear(handle, &str))
 		comments_add(&c, "date", str);
 
-	if (MP4GetMetadataCompilation(priv->mp4.handle, &val))
+	if (MP4GetMetadataCompilation(handle, &val))
 		comments_add_const(&c, "compilation", val ? "yes" : "no");
 #if 0
-	if (MP4GetBytesProperty(priv->mp4.handle, "moov.udta.meta.ilst.aART.data", &ustr, &size)) {
+	if (MP4GetBytesProperty(handle, "moov.udta.meta.ilst.aART.data", &ustr, &size)) {
 		char *xstr;
 
 		/* What's this?
@@ -357,46 +353,87 @@ static int mp4_read_comments(struct input_plugin_data *ip_data,
 		free(xstr);
 	}
 #endif
-	if (MP4GetMetadataTrack(priv->mp4.handle, &meta_num, &meta_total)) {
+	if (MP4GetMetadataTrack(handle, &meta_num, &meta_total)) {
 		char buf[6];
 		snprintf(buf, 6, "%u", meta_num);
 		comments_add_const(&c, "tracknumber", buf);
 	}
-	if (MP4GetMetadataDisk(priv->mp4.handle, &meta_num, &meta_total)) {
+	if (MP4GetMetadataDisk(handle, &meta_num, &meta_total)) {
 		char buf[6];
 		snprintf(buf, 6, "%u", meta_num);
 		comments_add_const(&c, "discnumber", buf);
 	}
 
 	keyvals_terminate(&c);
-	*comments = c.keyvals;
-	return 0;
+	return c.keyvals;
 }
 
-static int mp4_duration(struct input_plugin_data *ip_data)
+static int mp4_read_comments(struct input_plugin_data *ip_data,
+		struct keyval **comments)
 {
 	struct mp4_private *priv;
-	uint32_t scale;
-	uint64_t duration;
 
 	priv = ip_data->private;
+	*comments = get_comments(priv->mp4.handle);
+	return 0;
+}
 
-	scale = MP4GetTrackTimeScale(priv->mp4.handle, priv->mp4.track);
+static int get_duration(MP4FileHandle handle, MP4TrackId track)
+{
+	uint32_t scale;
+	uint64_t duration;
+
+	scale = MP4GetTrackTimeScale(handle, track);
 	if (scale == 0)
 		return 0;
 
-	duration = MP4GetTrackDuration(priv->mp4.handle, priv->mp4.track);
+	duration = MP4GetTrackDuration(handle, track);
 
 	return duration / scale;
 }
 
+static int mp4_duration(struct input_plugin_data *ip_data)
+{
+	struct mp4_private *priv;
+
+	priv = ip_data->private;
+	return get_duration(priv->mp4.handle, priv->mp4.track);
+}
+
+/* parses the atoms only, the AAC decoder is not set up */
+static int mp4_read_info(struct input_plugin_data *ip_data,
+		struct keyval **comments, int *duration)
+{
+	MP4FileHandle handle;
+	MP4TrackId track;
+
+	handle = MP4Read(ip_data->filename, 0);
+	if (!handle) {
+		d_print("MP4Read failed\n");
+		return -IP_ERROR_FILE_FORMAT;
+	}
+
+	track = mp4_get_track(handle);
+	if (track == MP4_INVALID_TRACK_ID) {
+		d_print("MP4FindTrackId failed\n");
+		MP4Close(handle);
+		return -IP_ERROR_FILE_FORMAT;
+	}
+
+	*comments = get_comments(handle);
+	*duration = get_duration(handle, track);
+	MP4Close(handle);
+	return 0;
+}
+
 const struct input_plugin_ops ip_ops = {
 	.open = mp4_open,
 	.close = mp4_close,
 	.read = mp4_read,
 	.seek = mp4_seek,
 	.read_comments = mp4_read_comments,
-	.duration = mp4_duration
+	.duration = mp4_duration,
+	.read_info = mp4_read_info
 };
 
 const char * const ip_extensions[] = { "mp4", "m4a", "m4b", NULL };
@@ -0,0 +1,777 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "mpris.h"
+#include "status.h"
+#include "server.h"
+#include "xstrjoin.h"
+#include "xmalloc.h"
+#include "debug.h"
+
+#include <glib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define MPRIS_PATH	"/org/mpris/MediaPlayer2"
+#define MPRIS_NAME	"org.mpris.MediaPlayer2.cmus"
+#define ROOT_IFACE	"org.mpris.MediaPlayer2"
+#define PLAYER_IFACE	"org.mpris.MediaPlayer2.Player"
+#define NO_TRACK	"/org/mpris/MediaPlayer2/TrackList/NoTrack"
+
+/* not defined by old libdbus versions */
+#ifndef DBUS_ERROR_UNKNOWN_PROPERTY
+#define DBUS_ERROR_UNKNOWN_PROPERTY "org.freedesktop.DBus.Error.UnknownProperty"
+#endif
+#ifndef DBUS_ERROR_PROPERTY_READ_ONLY
+#define DBUS_ERROR_PROPERTY_READ_ONLY "org.freedesktop.DBus.Error.PropertyReadOnly"
+#endif
+
+/* how often the status generation is checked, milliseconds */
+#define POLL_INTERVAL 200
+
+static const char introspection_xml[] =
+	DBUS_INTROSPECT_1_0_XML_DOCTYPE_DECL_NODE
+	"<node>\n"
+	" <interface name=\"org.freedesktop.DBus.Introspectable\">\n"
+	"  <method name=\"Introspect\">\n"
+	"   <arg name=\"data\" direction=\"out\" type=\"s\"/>\n"
+	"  </method>\n"
+	" </interface>\n"
+	" <interface name=\"org.freedesktop.DBus.Properties\">\n"
+	"  <method name=\"Get\">\n"
+	"   <arg name=\"interface\" direction=\"in\" type=\"s\"/>\n"
+	"   <arg name=\"property\" direction=\"in\" type=\"s\"/>\n"
+	"   <arg name=\"value\" direction=\"out\" type=\"v\"/>\n"
+	"  </method>\n"
+	"  <method name=\"GetAll\">\n"
+	"   <arg name=\"interface\" direction=\"in\" type=\"s\"/>\n"
+	"   <arg name=\"properties\" direction=\"out\" type=\"a{sv}\"/>\n"
+	"  </method>\n"
+	"  <method name=\"Set\">\n"
+	"   <arg name=\"interface\" direction=\"in\" type=\"s\"/>\n"
+	"   <arg name=\"property\" direction=\"in\" type=\"s\"/>\n"
+	"   <arg name=\"value\" direction=\"in\" type=\"v\"/>\n"
+	"  </method>\n"
+	"  <signal name=\"PropertiesChanged\">\n"
+	"   <arg name=\"interface\" type=\"s\"/>\n"
+	"   <arg name=\"changed_properties\" type=\"a{sv}\"/>\n"
+	"   <arg name=\"invalidated_properties\" type=\"as\"/>\n"
+	"  </signal>\n"
+	" </interface>\n"
+	" <interface name=\"" ROOT_IFACE "\">\n"
+	"  <method name=\"Raise\"/>\n"
+	"  <method name=\"Quit\"/>\n"
+	"  <property name=\"CanQuit\" type=\"b\" access=\"read\"/>\n"
+	"  <property name=\"CanRaise\" type=\"b\" access=\"read\"/>\n"
+	"  <property name=\"HasTrackList\" type=\"b\" access=\"read\"/>\n"
+	"  <property name=\"Identity\" type=\"s\" access=\"read\"/>\n"
+	"  <property name=\"SupportedUriSchemes\" type=\"as\" access=\"read\"/>\n"
+	"  <property name=\"SupportedMimeTypes\" type=\"as\" access=\"read\"/>\n"
+	" </interface>\n"
+	" <interface name=\"" PLAYER_IFACE "\">\n"
+	"  <method name=\"Next\"/>\n"
+	"  <method name=\"Previous\"/>\n"
+	"  <method name=\"Pause\"/>\n"
+	"  <method name=\"PlayPause\"/>\n"
+	"  <method name=\"Stop\"/>\n"
+	"  <method name=\"Play\"/>\n"
+	"  <method name=\"Seek\">\n"
+	"   <arg name=\"Offset\" direction=\"in\" type=\"x\"/>\n"
+	"  </method>\n"
+	"  <method name=\"SetPosition\">\n"
+	"   <arg name=\"TrackId\" direction=\"in\" type=\"o\"/>\n"
+	"   <arg name=\"Position\" direction=\"in\" type=\"x\"/>\n"
+	"  </method>\n"
+	"  <method name=\"OpenUri\">\n"
+	"   <arg name=\"Uri\" direction=\"in\" type=\"s\"/>\n"
+	"  </method>\n"
+	"  <signal name=\"Seeked\">\n"
+	"   <arg name=\"Position\" type=\"x\"/>\n"
+	"  </signal>\n"
+	"  <property name=\"PlaybackStatus\" type=\"s\" access=\"read\"/>\n"
+	"  <property name=\"LoopStatus\" type=\"s\" access=\"readwrite\"/>\n"
+	"  <property name=\"Rate\" type=\"d\" access=\"readwrite\"/>\n"
+	"  <property name=\"Shuffle\" type=\"b\" access=\"readwrite\"/>\n"
+	"  <property name=\"Metadata\" type=\"a{sv}\" access=\"read\"/>\n"
+	"  <property name=\"Volume\" type=\"d\" access=\"readwrite\"/>\n"
+	"  <property name=\"Position\" type=\"x\" access=\"read\"/>\n"
+	"  <property name=\"MinimumRate\" type=\"d\" access=\"read\"/>\n"
+	"  <property name=\"MaximumRate\" type=\"d\" access=\"read\"/>\n"
+	"  <property name=\"CanGoNext\" type=\"b\" access=\"read\"/>\n"
+	"  <property name=\"CanGoPrevious\" type=\"b\" access=\"read\"/>\n"
+	"  <property name=\"CanPlay\" type=\"b\" access=\"read\"/>\n"
+	"  <property name=\"CanPause\" type=\"b\" access=\"read\"/>\n"
+	"  <property name=\"CanSeek\" type=\"b\" access=\"read\"/>\n"
+	"  <property name=\"CanControl\" type=\"b\" access=\"read\"/>\n"
+	" </interface>\n"
+	"</node>\n";
+
+static DBusConnection *connection;
+
+/*
+ * property cache.  clients are told about changes from this snapshot to
+ * the next one before they can see the new values
+ */
+static struct status_snapshot *cached;
+static char track_path[64] = NO_TRACK;
+static unsigned int track_nr = 0;
+static int seek_requested = 0;
+
+/* value helpers {{{ */
+
+static const char *option_value(const struct status_snapshot *s, const char *name)
+{
+	int i;
+
+	for (i = 0; i < NR_STATUS_OPTIONS; i++) {
+		if (!strcmp(status_option_names[i], name))
+			return s->options[i];
+	}
+	return "";
+}
+
+static int option_true(const struct status_snapshot *s, const char *name)
+{
+	return !strcmp(option_value(s, name), "true");
+}
+
+static void append_variant(DBusMessageIter *iter, int type, const void *val)
+{
+	char sig[2] = { type, 0 };
+	DBusMessageIter v;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, sig, &v);
+	dbus_message_iter_append_basic(&v, type, val);
+	dbus_message_iter_close_container(iter, &v);
+}
+
+static void append_string(DBusMessageIter *iter, const char *str)
+{
+	append_variant(iter, DBUS_TYPE_STRING, &str);
+}
+
+static void append_bool(DBusMessageIter *iter, int val)
+{
+	dbus_bool_t b = val;
+
+	append_variant(iter, DBUS_TYPE_BOOLEAN, &b);
+}
+
+static void append_double(DBusMessageIter *iter, double val)
+{
+	append_variant(iter, DBUS_TYPE_DOUBLE, &val);
+}
+
+static void append_int64(DBusMessageIter *iter, dbus_int64_t val)
+{
+	append_variant(iter, DBUS_TYPE_INT64, &val);
+}
+
+/* @strs: NULL terminated */
+static void append_string_array(DBusMessageIter *iter, const char * const *strs)
+{
+	DBusMessageIter v, a;
+	int i;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, "as", &v);
+	dbus_message_iter_open_container(&v, DBUS_TYPE_ARRAY, "s", &a);
+	for (i = 0; strs[i]; i++)
+		dbus_message_iter_append_basic(&a, DBUS_TYPE_STRING, &strs[i]);
+	dbus_message_iter_close_container(&v, &a);
+	dbus_message_iter_close_container(iter, &v);
+}
+
+static void dict_open_entry(DBusMessageIter *dict, DBusMessageIter *entry, const char *key)
+{
+	dbus_message_iter_open_container(dict, DBUS_TYPE_DICT_ENTRY, NULL, entry);
+	dbus_message_iter_append_basic(entry, DBUS_TYPE_STRING, &key);
+}
+
+static void dict_add_string(DBusMessageIter *dict, const char *key, const char *val)
+{
+	DBusMessageIter e;
+
+	dict_open_entry(dict, &e, key);
+	append_string(&e, val);
+	dbus_message_iter_close_container(dict, &e);
+}
+
+/* }}} */
+
+/* properties {{{ */
+
+static void get_playback_status(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	static const char * const names[] = { "Stopped", "Playing", "Paused" };
+
+	append_string(iter, names[s->status]);
+}
+
+static void get_loop_status(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	if (option_true(s, "repeat_current")) {
+		append_string(iter, "Track");
+	} else if (option_true(s, "repeat")) {
+		append_string(iter, "Playlist");
+	} else {
+		append_string(iter, "None");
+	}
+}
+
+static void get_shuffle(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	append_bool(iter, option_true(s, "shuffle"));
+}
+
+static void get_metadata(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	DBusMessageIter v, dict, e;
+	const char *path = track_path;
+
+	dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT, "a{sv}", &v);
+	dbus_message_iter_open_container(&v, DBUS_TYPE_ARRAY, "{sv}", &dict);
+
+	dict_open_entry(&dict, &e, "mpris:trackid");
+	append_variant(&e, DBUS_TYPE_OBJECT_PATH, &path);
+	dbus_message_iter_close_container(&dict, &e);
+
+	if (s->ti) {
+		const char *title = s->title ? s->title : s->stream_title;
+		char *url;
+
+		if (s->duration > 0) {
+			dict_open_entry(&dict, &e, "mpris:length");
+			append_int64(&e, (dbus_int64_t)s->duration * 1000000);
+			dbus_message_iter_close_container(&dict, &e);
+		}
+		if (title)
+			dict_add_string(&dict, "xesam:title", title);
+		if (s->artist) {
+			const char *artists[] = { s->artist, NULL };
+
+			dict_open_entry(&dict, &e, "xesam:artist");
+			append_string_array(&e, artists);
+			dbus_message_iter_close_container(&dict, &e);
+		}
+		if (s->album)
+			dict_add_string(&dict, "xesam:album", s->album);
+		if (s->tracknumber) {
+			dbus_int32_t nr = atoi(s->tracknumber);
+
+			dict_open_entry(&dict, &e, "xesam:trackNumber");
+			append_variant(&e, DBUS_TYPE_INT32, &nr);
+			dbus_message_iter_close_container(&dict, &e);
+		}
+
+		if (s->ti->filename[0] == '/') {
+			url = xstrjoin("file://", s->ti->filename);
+		} else {
+			url = xstrdup(s->ti->filename);
+		}
+		dict_add_string(&dict, "xesam:url", url);
+		free(url);
+	}
+
+	dbus_message_iter_close_container(&v, &dict);
+	dbus_message_iter_close_container(iter, &v);
+}
+
+static double volume(const struct status_snapshot *s)
+{
+	if (s->vol_left < 0)
+		return 0;
+	return (s->vol_left + s->vol_right) / 200.0;
+}
+
+static void get_volume(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	append_double(iter, volume(s));
+}
+
+static void get_position(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	append_int64(iter, (dbus_int64_t)s->pos * 1000000);
+}
+
+static void get_rate(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	append_double(iter, 1.0);
+}
+
+static void get_true(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	append_bool(iter, 1);
+}
+
+static void get_false(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	append_bool(iter, 0);
+}
+
+static void get_can_seek(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	append_bool(iter, s->ti != NULL && s->duration > 0);
+}
+
+static void get_identity(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	append_string(iter, "cmus");
+}
+
+static void get_uri_schemes(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	static const char * const schemes[] = { "file", "http", NULL };
+
+	append_string_array(iter, schemes);
+}
+
+static void get_mime_types(DBusMessageIter *iter, const struct status_snapshot *s)
+{
+	static const char * const types[] = { NULL };
+
+	append_string_array(iter, types);
+}
+
+static int playback_status_changed(const struct status_snapshot *a, const struct status_snapshot *b)
+{
+	return a->status != b->status;
+}
+
+static int loop_status_changed(const struct status_snapshot *a, const struct status_snapshot *b)
+{
+	return option_true(a, "repeat") != option_true(b, "repeat") ||
+		option_true(a, "repeat_current") != option_true(b, "repeat_current");
+}
+
+static int shuffle_changed(const struct status_snapshot *a, const struct status_snapshot *b)
+{
+	return option_true(a, "shuffle") != option_true(b, "shuffle");
+}
+
+static int str_changed(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return a != b;
+	return strcmp(a, b);
+}
+
+static int metadata_changed(const struct status_snapshot *a, const struct status_snapshot *b)
+{
+	return a->ti != b->ti || a->duration != b->duration ||
+		str_changed(a->stream_title, b->stream_title);
+}
+
+static int volume_changed(const struct status_snapshot *a, const struct status_snapshot *b)
+{
+	return volume(a) != volume(b);
+}
+
+static int can_seek_changed(const struct status_snapshot *a, const struct status_snapshot *b)
+{
+	return (a->ti && a->duration > 0) != (b->ti && b->duration > 0);
+}
+
+/* setters get a variant of the type in the property table */
+
+static void set_loop_status(DBusMessageIter *v)
+{
+	const char *val;
+
+	dbus_message_iter_get_basic(v, &val);
+	if (!strcmp(val, "Track")) {
+		server_queue_command("set repeat_current=true");
+	} else if (!strcmp(val, "Playlist")) {
+		server_queue_command("set repeat_current=false");
+		server_queue_command("set repeat=true");
+	} else {
+		server_queue_command("set repeat_current=false");
+		server_queue_command("set repeat=false");
+	}
+}
+
+static void set_shuffle(DBusMessageIter *v)
+{
+	dbus_bool_t val;
+
+	dbus_message_iter_get_basic(v, &val);
+	server_queue_command(val ? "set shuffle=true" : "set shuffle=false");
+}
+
+static void set_volume(DBusMessageIter *v)
+{
+	char buf[32];
+	double val;
+
+	dbus_message_iter_get_basic(v, &val);
+	if (val < 0)
+		val = 0;
+	if (val > 1)
+		val = 1;
+	snprintf(buf, sizeof(buf), "vol %d%%", (int)(val * 100 + 0.5));
+	server_queue_command(buf);
+}
+
+static void set_rate(DBusMessageIter *v)
+{
+	/* only 1.0 is supported */
+}
+
+struct mpris_prop {
+	const char *iface;
+	const char *name;
+	void (*get)(DBusMessageIter *iter, const struct status_snapshot *s);
+	/* NULL if PropertiesChanged isn't sent */
+	int (*changed)(const struct status_snapshot *a, const struct status_snapshot *b);
+	/* NULL if read-only */
+	void (*set)(DBusMessageIter *v);
+	/* type of the variant passed to set */
+	int type;
+};
+
+static const struct mpris_prop props[] = {
+	{ ROOT_IFACE, "CanQuit", get_false, NULL, NULL, 0 },
+	{ ROOT_IFACE, "CanRaise", get_false, NULL, NULL, 0 },
+	{ ROOT_IFACE, "HasTrackList", get_false, NULL, NULL, 0 },
+	{ ROOT_IFACE, "Identity", get_identity, NULL, NULL, 0 },
+	{ ROOT_IFACE, "SupportedUriSchemes", get_uri_schemes, NULL, NULL, 0 },
+	{ ROOT_IFACE, "SupportedMimeTypes", get_mime_types, NULL, NULL, 0 },
+	{ PLAYER_IFACE, "PlaybackStatus", get_playback_status, playback_status_changed, NULL, 0 },
+	{ PLAYER_IFACE, "LoopStatus", get_loop_status, loop_status_changed, set_loop_status, DBUS_TYPE_STRING },
+	{ PLAYER_IFACE, "Rate", get_rate, NULL, set_rate, DBUS_TYPE_DOUBLE },
+	{ PLAYER_IFACE, "Shuffle", get_shuffle, shuffle_changed, set_shuffle, DBUS_TYPE_BOOLEAN },
+	{ PLAYER_IFACE, "Metadata", get_metadata, metadata_changed, NULL, 0 },
+	{ PLAYER_IFACE, "Volume", get_volume, volume_changed, set_volume, DBUS_TYPE_DOUBLE },
+	/* clients interpolate the position, changes are not signaled */
+	{ PLAYER_IFACE, "Position", get_position, NULL, NULL, 0 },
+	{ PLAYER_IFACE, "MinimumRate", get_rate, NULL, NULL, 0 },
+	{ PLAYER_IFACE, "MaximumRate", get_rate, NULL, NULL, 0 },
+	{ PLAYER_IFACE, "CanGoNext", get_true, NULL, NULL, 0 },
+	{ PLAYER_IFACE, "CanGoPrevious", get_true, NULL, NULL, 0 },
+	{ PLAYER_IFACE, "CanPlay", get_true, NULL, NULL, 0 },
+	{ PLAYER_IFACE, "CanPause", get_true, NULL, NULL, 0 },
+	{ PLAYER_IFACE, "CanSeek", get_can_seek, can_seek_changed, NULL, 0 },
+	{ PLAYER_IFACE, "CanControl", get_true, NULL, NULL, 0 },
+	{ NULL, NULL, NULL, NULL, NULL, 0 }
+};
+
+static const struct mpris_prop *find_prop(const char *iface, const char *name)
+{
+	int i;
+
+	for (i = 0; props[i].name; i++) {
+		if (!strcmp(props[i].iface, iface) && !strcmp(props[i].name, name))
+			return &props[i];
+	}
+	return NULL;
+}
+
+/* }}} */
+
+/* sends the changes from the cached snapshot to the current one */
+static void update_cache(void)
+{
+	struct status_snapshot *s;
+	DBusMessage *msg;
+	DBusMessageIter iter, dict, e;
+	const char *iface = PLAYER_IFACE;
+	int i, nr_changed = 0;
+
+	if (cached && cached->generation == status_generation())
+		return;
+
+	s = status_get();
+	if (cached == NULL) {
+		cached = s;
+		if (s->ti)
+			snprintf(track_path, sizeof(track_path), "/org/cmus/track/%u", ++track_nr);
+		return;
+	}
+
+	if (s->ti != cached->ti) {
+		if (s->ti) {
+			snprintf(track_path, sizeof(track_path), "/org/cmus/track/%u", ++track_nr);
+		} else {
+			strcpy(track_path, NO_TRACK);
+		}
+	}
+
+	msg = dbus_message_new_signal(MPRIS_PATH, DBUS_INTERFACE_PROPERTIES, "PropertiesChanged");
+	dbus_message_iter_init_append(msg, &iter);
+	dbus_message_iter_append_basic(&iter, DBUS_TYPE_STRING, &iface);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
+	for (i = 0; props[i].name; i++) {
+		if (!props[i].changed || !props[i].changed(cached, s))
+			continue;
+		dict_open_entry(&dict, &e, props[i].name);
+		props[i].get(&e, s);
+		dbus_message_iter_close_container(&dict, &e);
+		nr_changed++;
+	}
+	dbus_message_iter_close_container(&iter, &dict);
+	/* nothing is invalidated */
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "s", &dict);
+	dbus_message_iter_close_container(&iter, &dict);
+	if (nr_changed)
+		dbus_connection_send(connection, msg, NULL);
+	dbus_message_unref(msg);
+
+	if (seek_requested && s->pos != cached->pos) {
+		dbus_int64_t pos = (dbus_int64_t)s->pos * 1000000;
+
+		seek_requested = 0;
+		msg = dbus_message_new_signal(MPRIS_PATH, PLAYER_IFACE, "Seeked");
+		dbus_message_append_args(msg, DBUS_TYPE_INT64, &pos, DBUS_TYPE_INVALID);
+		dbus_connection_send(connection, msg, NULL);
+		dbus_message_unref(msg);
+	}
+
+	status_put(cached);
+	cached = s;
+}
+
+static gboolean poll_status(gpointer data)
+{
+	update_cache();
+	return TRUE;
+}
+
+void mpris_seek_requested(void)
+{
+	seek_requested = 1;
+}
+
+/* methods {{{ */
+
+static DBusMessage *props_get(DBusMessage *msg)
+{
+	const struct mpris_prop *prop;
+	const char *iface, *name;
+	DBusMessage *reply;
+	DBusMessageIter iter;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &iface,
+				DBUS_TYPE_STRING, &name, DBUS_TYPE_INVALID))
+		return dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, "expected (ss)");
+	prop = find_prop(iface, name);
+	if (prop == NULL)
+		return dbus_message_new_error(msg, DBUS_ERROR_UNKNOWN_PROPERTY, name);
+
+	reply = dbus_message_new_method_return(msg);
+	dbus_message_iter_init_append(reply, &iter);
+	prop->get(&iter, cached);
+	return reply;
+}
+
+static DBusMessage *props_get_all(DBusMessage *msg)
+{
+	const char *iface;
+	DBusMessage *reply;
+	DBusMessageIter iter, dict, e;
+	int i;
+
+	if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &iface, DBUS_TYPE_INVALID))
+		return dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, "expected (s)");
+
+	reply = dbus_message_new_method_return(msg);
+	dbus_message_iter_init_append(reply, &iter);
+	dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &dict);
+	for (i = 0; props[i].name; i++) {
+		if (strcmp(props[i].iface, iface))
+			continue;
+		dict_open_entry(&dict, &e, props[i].name);
+		props[i].get(&e, cached);
+		dbus_message_iter_close_container(&dict, &e);
+	}
+	dbus_message_iter_close_container(&iter, &dict);
+	return reply;
+}
+
+static DBusMessage *props_set(DBusMessage *msg)
+{
+	const struct mpris_prop *prop;
+	const char *iface, *name;
+	DBusMessageIter iter, v;
+
+	if (!dbus_message_iter_init(msg, &iter) ||
+			dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+		goto invalid;
+	dbus_message_iter_get_basic(&iter, &iface);
+	if (!dbus_message_iter_next(&iter) ||
+			dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_STRING)
+		goto invalid;
+	dbus_message_iter_get_basic(&iter, &name);
+	if (!dbus_message_iter_next(&iter) ||
+			dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_VARIANT)
+		goto invalid;
+	dbus_message_iter_recurse(&iter, &v);
+
+	prop = find_prop(iface, name);
+	if (prop == NULL)
+		return dbus_message_new_error(msg, DBUS_ERROR_UNKNOWN_PROPERTY, name);
+	if (prop->set == NULL)
+		return dbus_message_new_error(msg, DBUS_ERROR_PROPERTY_READ_ONLY, name);
+	if (dbus_message_iter_get_arg_type(&v) != prop->type)
+		goto invalid;
+
+	prop->set(&v);
+	return dbus_message_new_method_return(msg);
+invalid:
+	return dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, "expected (ssv)");
+}
+
+static void seek_to(dbus_int64_t usec, int relative)
+{
+	long long secs = usec / 1000000;
+	char buf[64];
+
+	if (relative) {
+		if (secs == 0)
+			return;
+		snprintf(buf, sizeof(buf), "seek %c%lld", secs < 0 ? '-' : '+', llabs(secs));
+	} else {
+		snprintf(buf, sizeof(buf), "seek %lld", secs);
+	}
+	server_queue_command(buf);
+}
+
+static DBusMessage *player_method(DBusMessage *msg)
+{
+	const char *member = dbus_message_get_member(msg);
+	enum player_status status = cached->status;
+
+	if (!strcmp(member, "Next")) {
+		server_queue_command("player-next");
+	} else if (!strcmp(member, "Previous")) {
+		server_queue_command("player-prev");
+	} else if (!strcmp(member, "Pause")) {
+		/* player-pause toggles */
+		if (status == PLAYER_STATUS_PLAYING)
+			server_queue_command("player-pause");
+	} else if (!strcmp(member, "PlayPause")) {
+		if (status == PLAYER_STATUS_STOPPED) {
+			server_queue_command("player-play");
+		} else {
+			server_queue_command("player-pause");
+		}
+	} else if (!strcmp(member, "Stop")) {
+		server_queue_command("player-stop");
+	} else if (!strcmp(member, "Play")) {
+		/* player-play would restart the track */
+		if (status == PLAYER_STATUS_PAUSED) {
+			server_queue_command("player-pause");
+		} else if (status == PLAYER_STATUS_STOPPED) {
+			server_queue_command("player-play");
+		}
+	} else if (!strcmp(member, "Seek")) {
+		dbus_int64_t offset;
+
+		if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_INT64, &offset, DBUS_TYPE_INVALID))
+			return dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, "expected (x)");
+		seek_to(offset, 1);
+	} else if (!strcmp(member, "SetPosition")) {
+		const char *path;
+		dbus_int64_t pos;
+
+		if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_OBJECT_PATH, &path,
+					DBUS_TYPE_INT64, &pos, DBUS_TYPE_INVALID))
+			return dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, "expected (ox)");
+		/* ignored if the track has changed */
+		if (!strcmp(path, track_path) && pos >= 0)
+			seek_to(pos, 0);
+	} else if (!strcmp(member, "OpenUri")) {
+		const char *uri;
+		char *cmd;
+
+		if (!dbus_message_get_args(msg, NULL, DBUS_TYPE_STRING, &uri, DBUS_TYPE_INVALID))
+			return dbus_message_new_error(msg, DBUS_ERROR_INVALID_ARGS, "expected (s)");
+		if (!strncmp(uri, "file://", 7))
+			uri += 7;
+		cmd = xstrjoin("player-play ", uri);
+		server_queue_command(cmd);
+		free(cmd);
+	} else {
+		return NULL;
+	}
+	return dbus_message_new_method_return(msg);
+}
+
+static DBusMessage *root_method(DBusMessage *msg)
+{
+	const char *member = dbus_message_get_member(msg);
+
+	/* CanRaise and CanQuit are false */
+	if (strcmp(member, "Raise") && strcmp(member, "Quit"))
+		return NULL;
+	return dbus_message_new_method_return(msg);
+}
+
+/* }}} */
+
+static DBusHandlerResult handle_message(DBusConnection *conn, DBusMessage *msg, void *data)
+{
+	DBusMessage *reply = NULL;
+
+	if (dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_CALL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+
+	/* clients must see PropertiesChanged before the new values */
+	update_cache();
+
+	if (dbus_message_is_method_call(msg, DBUS_INTERFACE_INTROSPECTABLE, "Introspect")) {
+		const char *xml = introspection_xml;
+
+		reply = dbus_message_new_method_return(msg);
+		dbus_message_append_args(reply, DBUS_TYPE_STRING, &xml, DBUS_TYPE_INVALID);
+	} else if (dbus_message_is_method_call(msg, DBUS_INTERFACE_PROPERTIES, "Get")) {
+		reply = props_get(msg);
+	} else if (dbus_message_is_method_call(msg, DBUS_INTERFACE_PROPERTIES, "GetAll")) {
+		reply = props_get_all(msg);
+	} else if (dbus_message_is_method_call(msg, DBUS_INTERFACE_PROPERTIES, "Set")) {
+		reply = props_set(msg);
+	} else if (dbus_message_has_interface(msg, PLAYER_IFACE)) {
+		reply = player_method(msg);
+	} else if (dbus_message_has_interface(msg, ROOT_IFACE)) {
+		reply = root_method(msg);
+	}
+
+	if (reply == NULL)
+		return DBUS_HANDLER_RESULT_NOT_YET_HANDLED;
+	dbus_connection_send(conn, reply, NULL);
+	dbus_message_unref(reply);
+	return DBUS_HANDLER_RESULT_HANDLED;
+}
+
+static const DBusObjectPathVTable vtable = {
+	.message_function = handle_message,
+};
+
+int mpris_init(DBusConnection *conn)
+{
+	DBusError err;
+	int rc;
+
+	connection = conn;
+	update_cache();
+
+	if (!dbus_connection_register_object_path(conn, MPRIS_PATH, &vtable, NULL)) {
+		d_print("couldn't register " MPRIS_PATH "\n");
+		return -1;
+	}
+
+	dbus_error_init(&err);
+	rc = dbus_bus_request_name(conn, MPRIS_NAME, DBUS_NAME_FLAG_DO_NOT_QUEUE, &err);
+	if (dbus_error_is_set(&err)) {
+		d_print("requesting " MPRIS_NAME ": %s\n", err.message);
+		dbus_error_free(&err);
+		return -1;
+	}
+	if (rc != DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+		d_print(MPRIS_NAME " is already taken\n");
+		return -1;
+	}
+
+	g_timeout_add(POLL_INTERVAL, poll_status, NULL);
+	return 0;
+}
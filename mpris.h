@@ -0,0 +1,22 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _MPRIS_H
+#define _MPRIS_H
+
+#include <dbus/dbus.h>
+
+/*
+ * MPRIS2 (org.mpris.MediaPlayer2 and org.mpris.MediaPlayer2.Player) on
+ * /org/mpris/MediaPlayer2.  Everything runs in the D-Bus thread,
+ * properties are read from the status snapshot, never from player_info.
+ */
+
+/* registers the object and requests org.mpris.MediaPlayer2.cmus */
+int mpris_init(DBusConnection *conn);
+
+/* a seek command was run, Seeked is sent when the position has changed */
+void mpris_seek_requested(void);
+
+#endif
@@ -31,12 +31,32 @@
 #include <unistd.h>
 #include <string.h>
 #include <errno.h>
+#include <stdint.h>
 
 struct seek_idx_entry {
 	off_t offset;
 	mad_timer_t timer;
 };
 
+/*
+ * persisted seek index (nomad_get_seek_idx), host byte order
+ *
+ * header followed by nr_entries records
+ */
+struct seek_idx_header {
+	uint32_t nr_frames;
+	uint32_t nr_entries;
+	/* exact duration */
+	uint32_t duration_ms;
+	uint32_t reserved;
+};
+
+struct seek_idx_record {
+	uint64_t offset;
+	int32_t seconds;
+	uint32_t fraction;
+};
+
 struct nomad {
 	struct mad_stream stream;
 	struct mad_frame frame;
@@ -288,6 +308,8 @@ static void calc_fast(struct nomad *nomad)
 		nomad->info.nr_frames = nomad->info.filesize /
 			(nomad->stream.next_frame - nomad->stream.this_frame);
 		mad_timer_multiply(&nomad->timer, nomad->info.nr_frames);
+		/* exact only for CBR files */
+		nomad->info.estimated = 1;
 	}
 }
 
@@ -643,3 +665,60 @@ double nomad_time_total(struct nomad *nomad)
 {
 	return nomad->info.duration;
 }
+
+int nomad_get_seek_idx(struct nomad *nomad, char **bufp)
+{
+	struct seek_idx_header *h;
+	struct seek_idx_record *r;
+	int i, size;
+
+	size = sizeof(*h) + nomad->seek_idx.size * sizeof(*r);
+	h = xmalloc(size);
+	h->nr_frames = nomad->info.nr_frames;
+	h->nr_entries = nomad->seek_idx.size;
+	h->duration_ms = nomad->info.duration * 1000.0 + 0.5;
+	h->reserved = 0;
+
+	r = (struct seek_idx_record *)(h + 1);
+	for (i = 0; i < nomad->seek_idx.size; i++) {
+		r[i].offset = nomad->seek_idx.table[i].offset;
+		r[i].seconds = nomad->seek_idx.table[i].timer.seconds;
+		r[i].fraction = nomad->seek_idx.table[i].timer.fraction;
+	}
+	*bufp = (char *)h;
+	return size;
+}
+
+int nomad_set_seek_idx(struct nomad *nomad, const char *buf, int size)
+{
+	const struct seek_idx_header *h = (const struct seek_idx_header *)buf;
+	const struct seek_idx_record *r;
+	int i;
+
+	if (size < sizeof(*h))
+		return -1;
+	if (size != sizeof(*h) + h->nr_entries * sizeof(*r))
+		return -1;
+	if (nomad->info.filesize == -1)
+		return -1;
+
+	nomad->info.nr_frames = h->nr_frames;
+	nomad->info.duration = h->duration_ms / 1000.0;
+	nomad->info.estimated = 0;
+
+	/* Xing TOC is used for seeking if present */
+	if (nomad->has_xing)
+		return 0;
+
+	r = (const struct seek_idx_record *)(h + 1);
+	free(nomad->seek_idx.table);
+	nomad->seek_idx.table = xnew(struct seek_idx_entry, h->nr_entries);
+	for (i = 0; i < h->nr_entries; i++) {
+		mad_timer_reset(&nomad->seek_idx.table[i].timer);
+		nomad->seek_idx.table[i].offset = r[i].offset;
+		nomad->seek_idx.table[i].timer.seconds = r[i].seconds;
+		nomad->seek_idx.table[i].timer.fraction = r[i].fraction;
+	}
+	nomad->seek_idx.size = h->nr_entries;
+	return 0;
+}
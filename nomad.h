@@ -49,6 +49,8 @@ struct nomad_info {
 	int filesize;
 	unsigned int joint_stereo : 1;
 	unsigned int dual_channel : 1;
+	/* duration guessed from the first frame, fast = 1 and no Xing header */
+	unsigned int estimated : 1;
 };
 
 enum {
@@ -76,4 +78,19 @@ int nomad_time_seek(struct nomad *nomad, double pos);
 double nomad_time_tell(struct nomad *nomad);
 double nomad_time_total(struct nomad *nomad);
 
+/*
+ * seek index and exact duration of a file opened with fast = 0,
+ * serialized into a malloced buffer in host byte order
+ *
+ * returns: size of *bufp
+ */
+int nomad_get_seek_idx(struct nomad *nomad, char **bufp);
+
+/*
+ * use seek index and exact duration saved by nomad_get_seek_idx()
+ *
+ * returns: 0 on success, -1 if @buf is invalid
+ */
+int nomad_set_seek_idx(struct nomad *nomad, const char *buf, int size);
+
 #endif
@@ -21,6 +21,10 @@
 #include "file.h"
 #include "prog.h"
 #include "output.h"
+#include "tag_probe.h"
+#include "watch.h"
+#include "worker.h"
+#include "status_program.h"
 #include "config/datadir.h"
 
 #include <stdio.h>
@@ -36,6 +40,7 @@
 
 char *output_plugin = NULL;
 char *status_display_program = NULL;
+int status_display_persistent = 0;
 char *server_password;
 int auto_reshuffle = 0;
 int confirm_run = 1;
@@ -370,12 +375,63 @@ static void get_status_display_program(unsigned int id, char *buf)
 
 static void set_status_display_program(unsigned int id, const char *buf)
 {
+	/* the old program must not get any more events */
+	status_program_stop();
 	free(status_display_program);
 	status_display_program = NULL;
 	if (buf[0])
 		status_display_program = xstrdup(buf);
 }
 
+static void get_status_display_persistent(unsigned int id, char *buf)
+{
+	strcpy(buf, bool_names[status_display_persistent]);
+}
+
+static void set_status_display_persistent(unsigned int id, const char *buf)
+{
+	int persistent;
+
+	if (!parse_bool(buf, &persistent))
+		return;
+	if (!persistent)
+		status_program_stop();
+	status_display_persistent = persistent;
+}
+
+static void toggle_status_display_persistent(unsigned int id)
+{
+	if (status_display_persistent)
+		status_program_stop();
+	status_display_persistent ^= 1;
+}
+
+static void get_tag_probe_size(unsigned int id, char *buf)
+{
+	buf_int(buf, tag_probe_size / 1024);
+}
+
+static void set_tag_probe_size(unsigned int id, const char *buf)
+{
+	int kb;
+
+	if (parse_int(buf, 1, 1024, &kb))
+		tag_probe_size = kb * 1024;
+}
+
+static void get_worker_threads(unsigned int id, char *buf)
+{
+	buf_int(buf, worker_threads);
+}
+
+static void set_worker_threads(unsigned int id, const char *buf)
+{
+	int val;
+
+	if (parse_int(buf, 1, 8, &val))
+		worker_set_threads(val);
+}
+
 /* }}} */
 
 /* callbacks for toggle options {{{ */
@@ -725,6 +781,38 @@ static void toggle_softvol(unsigned int id)
 	do_set_softvol(soft_vol ^ 1);
 }
 
+static void get_watch_library(unsigned int id, char *buf)
+{
+	strcpy(buf, bool_names[watch_library]);
+}
+
+static void do_set_watch_library(int watch)
+{
+	if (watch == watch_library)
+		return;
+	watch_library = watch;
+	if (watch_library) {
+		watch_enable();
+		cmus_watch_lib();
+	} else {
+		watch_disable();
+	}
+}
+
+static void set_watch_library(unsigned int id, const char *buf)
+{
+	int watch;
+
+	if (!parse_bool(buf, &watch))
+		return;
+	do_set_watch_library(watch);
+}
+
+static void toggle_watch_library(unsigned int id)
+{
+	do_set_watch_library(watch_library ^ 1);
+}
+
 /* }}} */
 
 /* special callbacks (id set) {{{ */
@@ -840,7 +928,11 @@ static const struct {
 	DT(shuffle)
 	DT(softvol)
 	DN(softvol_state)
+	DT(status_display_persistent)
 	DN(status_display_program)
+	DN(tag_probe_size)
+	DT(watch_library)
+	DN(worker_threads)
 	{ NULL, NULL, NULL, NULL }
 };
 
@@ -919,7 +1011,7 @@ void option_add(const char *name, unsigned int id, opt_get_cb get,
 	nr_options++;
 }
 
-struct cmus_opt *option_find(const char *name)
+struct cmus_opt *__option_find(const char *name)
 {
 	struct cmus_opt *opt;
 
@@ -927,10 +1019,18 @@ struct cmus_opt *option_find(const char *name)
 		if (strcmp(name, opt->name) == 0)
 			return opt;
 	}
-	error_msg("no such option %s", name);
 	return NULL;
 }
 
+struct cmus_opt *option_find(const char *name)
+{
+	struct cmus_opt *opt = __option_find(name);
+
+	if (opt == NULL)
+		error_msg("no such option %s", name);
+	return opt;
+}
+
 void option_set(const char *name, const char *value)
 {
 	struct cmus_opt *opt = option_find(name);
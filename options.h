@@ -83,6 +83,7 @@ enum {
 
 extern char *output_plugin;
 extern char *status_display_program;
+extern int status_display_persistent;
 extern char *server_password;
 extern int auto_reshuffle;
 extern int confirm_run;
@@ -131,6 +132,8 @@ void options_exit(void);
 
 void option_add(const char *name, unsigned int id, opt_get_cb get,
 		opt_set_cb set, opt_toggle_cb toggle);
+/* doesn't complain if @name isn't found */
+struct cmus_opt *__option_find(const char *name);
 struct cmus_opt *option_find(const char *name);
 void option_set(const char *name, const char *value);
 int parse_enum(const char *buf, int minval, int maxval, const char * const names[], int *val);
@@ -5,6 +5,7 @@
 #include "pl.h"
 #include "editable.h"
 #include "options.h"
+#include "slab.h"
 #include "xmalloc.h"
 #include "dbus-server.h"
 
@@ -12,6 +13,7 @@ struct editable pl_editable;
 struct simple_track *pl_cur_track = NULL;
 
 static LIST_HEAD(pl_shuffle_head);
+static SLAB(pl_track_slab, struct shuffle_track);
 
 static void pl_free_track(struct list_head *item)
 {
@@ -22,7 +24,7 @@ static void pl_free_track(struct list_head *item)
 
 	list_del(&((struct shuffle_track *)track)->node);
 	track_info_unref(track->info);
-	free(track);
+	slab_free(&pl_track_slab, track);
 }
 
 void pl_init(void)
@@ -104,7 +106,7 @@ void pl_sel_current(void)
 
 void pl_add_track(struct track_info *ti)
 {
-	struct shuffle_track *track = xnew(struct shuffle_track, 1);
+	struct shuffle_track *track = slab_alloc(&pl_track_slab);
 
 	track_info_ref(ti);
 	simple_track_init((struct simple_track *)track, ti);
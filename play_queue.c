@@ -14,7 +14,7 @@ static void pq_free_track(struct list_head *item)
 	struct simple_track *track = to_simple_track(item);
 
 	track_info_unref(track->info);
-	free(track);
+	simple_track_free(track);
 }
 
 void play_queue_init(void)
@@ -35,8 +35,10 @@ void play_queue_prepend(struct track_info *ti)
 
 	list_add(&t->node, &pq_editable.head);
 	pq_editable.nr_tracks++;
-	if (t->info->duration != -1)
-		pq_editable.total_time += t->info->duration;
+	pq_editable.generation++;
+	t->duration = t->info->duration;
+	if (t->duration != -1)
+		pq_editable.total_time += t->duration;
 	window_changed(pq_editable.win);
 }
 
@@ -58,9 +60,12 @@ struct track_info *play_queue_remove(void)
 
 	pq_editable.nr_marked -= t->marked;
 	pq_editable.nr_tracks--;
+	pq_editable.generation++;
+	if (t->duration != -1)
+		pq_editable.total_time -= t->duration;
 	list_del(&t->node);
 
 	info = t->info;
-	free(t);
+	simple_track_free(t);
 	return info;
 }
@@ -21,12 +21,14 @@
 #include "buffer.h"
 #include "input.h"
 #include "output.h"
+#include "cache.h"
 #include "sf.h"
 #include "utils.h"
 #include "xmalloc.h"
 #include "debug.h"
 #include "compiler.h"
 #include "dbus-server.h"
+#include "status.h"
 
 #include <stdlib.h>
 #include <pthread.h>
@@ -308,6 +310,13 @@ static inline int get_next(struct track_info **ti)
 
 /* updating player status {{{ */
 
+static inline void info_changed(void)
+{
+	status_update();
+	if (player_cbs->info_changed)
+		player_cbs->info_changed();
+}
+
 static inline void file_changed(struct track_info *ti)
 {
 	player_info_lock();
@@ -324,6 +333,7 @@ static inline void file_changed(struct track_info *ti)
 	player_info.metadata[0] = 0;
 	player_info.file_changed = 1;
 	player_info_unlock();
+	info_changed();
 }
 
 static inline void metadata_changed(void)
@@ -333,6 +343,7 @@ static inline void metadata_changed(void)
 	memcpy(player_info.metadata, ip_get_metadata(ip), 255 * 16 + 1);
 	player_info.metadata_changed = 1;
 	player_info_unlock();
+	info_changed();
 }
 
 static void player_error(const char *msg)
@@ -347,6 +358,7 @@ static void player_error(const char *msg)
 	free(player_info.error_msg);
 	player_info.error_msg = xstrdup(msg);
 	player_info_unlock();
+	info_changed();
 
 	d_print("ERROR: '%s'\n", msg);
 }
@@ -420,6 +432,7 @@ static void __consumer_position_update(void)
 		player_info.pos = pos;
 		player_info.position_changed = 1;
 		player_info_unlock();
+		status_update();
 	}
 }
 
@@ -441,6 +454,7 @@ static void __player_status_changed(void)
 	player_info.buffer_size = buffer_nr_chunks;
 	player_info.status_changed = 1;
 	player_info_unlock();
+	info_changed();
 }
 
 /* updating player status }}} */
@@ -499,6 +513,18 @@ static void __prebuffer(void)
 
 /* setting producer status {{{ */
 
+static struct input_plugin *ip_new_ti(struct track_info *ti)
+{
+	struct input_plugin *new_ip = ip_new(ti->filename);
+
+	/* seek index is filled in by the background scan job */
+	cache_lock();
+	if (ti->seek_idx)
+		ip_set_seek_idx(new_ip, ti->seek_idx, ti->seek_idx_size);
+	cache_unlock();
+	return new_ip;
+}
+
 static void __producer_play(void)
 {
 	if (producer_status == PS_UNLOADED) {
@@ -507,7 +533,7 @@ static void __producer_play(void)
 		if (get_next(&ti) == 0) {
 			int rc;
 
-			ip = ip_new(ti->filename);
+			ip = ip_new_ti(ti);
 			rc = ip_open(ip);
 			if (rc) {
 				player_ip_error(rc, "opening file `%s'", ti->filename);
@@ -571,7 +597,7 @@ static void __producer_pause(void)
 static void __producer_set_file(struct track_info *ti)
 {
 	__producer_unload();
-	ip = ip_new(ti->filename);
+	ip = ip_new_ti(ti);
 	producer_status = PS_STOPPED;
 	file_changed(ti);
 }
@@ -682,7 +708,7 @@ static void __consumer_handle_eof(void)
 
 	if (get_next(&ti) == 0) {
 		__producer_unload();
-		ip = ip_new(ti->filename);
+		ip = ip_new_ti(ti);
 		producer_status = PS_STOPPED;
 		/* PS_STOPPED, CS_PLAYING */
 		if (player_cont) {
@@ -1207,6 +1233,7 @@ void player_set_soft_volume(int l, int r)
 	soft_vol_l = l;
 	soft_vol_r = r;
 	consumer_unlock();
+	status_update();
 }
 
 void player_set_soft_vol(int soft)
@@ -49,6 +49,11 @@ enum replaygain {
 
 struct player_callbacks {
 	int (*get_next)(struct track_info **ti);
+	/*
+	 * optional, called from the player threads after file, metadata or
+	 * status has changed.  not called for position updates
+	 */
+	void (*info_changed)(void);
 };
 
 struct player_info {
@@ -0,0 +1,218 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "query.h"
+#include "lib.h"
+#include "pl.h"
+#include "play_queue.h"
+#include "editable.h"
+#include "filters.h"
+#include "expr.h"
+#include "keyval.h"
+#include "ui_curses.h"
+#include "xmalloc.h"
+
+#include <string.h>
+#include <stdlib.h>
+
+/* tracks looked at per editable_lock() */
+#define SLICE_SIZE 256
+
+/* tracks looked at per query, bounds the time spent on sparse filters */
+#define MAX_SCAN (64 * 1024)
+
+#define MAX_FIELDS 32
+
+/*
+ * Position of the last query in a view.  Paging through a view continues
+ * from here instead of walking the list from the start, as long as no
+ * track has been added, removed or moved since.  Protected by
+ * editable_lock().
+ */
+struct cursor {
+	const char *name;
+	struct editable *e;
+	unsigned int generation;
+	unsigned int pos;
+	/* track at pos, &e->head at the end, NULL if not set */
+	struct list_head *item;
+};
+
+static struct cursor cursors[] = {
+	{ "lib", &lib_editable, 0, 0, NULL },
+	{ "pl", &pl_editable, 0, 0, NULL },
+	{ "queue", &pq_editable, 0, 0, NULL },
+	{ NULL, NULL, 0, 0, NULL }
+};
+
+static struct cursor *find_cursor(const char *view)
+{
+	int i;
+
+	for (i = 0; cursors[i].name; i++) {
+		if (!strcmp(cursors[i].name, view))
+			return &cursors[i];
+	}
+	return NULL;
+}
+
+/* editable must be locked */
+static void cursor_seek(struct cursor *c, unsigned int pos)
+{
+	struct list_head *head = &c->e->head;
+
+	if (c->item == NULL || c->generation != c->e->generation || pos < c->pos) {
+		c->generation = c->e->generation;
+		if (pos > c->e->nr_tracks / 2) {
+			/* closer to the end */
+			c->pos = c->e->nr_tracks;
+			c->item = head;
+			while (c->pos > pos) {
+				c->item = c->item->prev;
+				c->pos--;
+			}
+			return;
+		}
+		c->pos = 0;
+		c->item = head->next;
+	}
+	while (c->pos < pos && c->item != head) {
+		c->item = c->item->next;
+		c->pos++;
+	}
+}
+
+static void add_escaped(struct gbuf *buf, const char *str)
+{
+	for (; *str; str++) {
+		if (*str == '\\') {
+			gbuf_add_str(buf, "\\\\");
+		} else if (*str == '\n') {
+			gbuf_add_str(buf, "\\n");
+		} else if (*str == '\t') {
+			gbuf_add_str(buf, "\\t");
+		} else {
+			gbuf_add_ch(buf, *str);
+		}
+	}
+}
+
+static void format_track(struct gbuf *buf, const struct track_info *ti,
+		char **fields, int nr_fields)
+{
+	int i;
+
+	gbuf_add_str(buf, "track ");
+	for (i = 0; i < nr_fields; i++) {
+		if (i)
+			gbuf_add_ch(buf, '\t');
+		if (!strcmp(fields[i], "file")) {
+			add_escaped(buf, ti->filename);
+		} else if (!strcmp(fields[i], "duration")) {
+			gbuf_addf(buf, "%d", ti->duration);
+		} else {
+			const char *val = keyvals_get_val(ti->comments, fields[i]);
+
+			if (val)
+				add_escaped(buf, val);
+		}
+	}
+	gbuf_add_ch(buf, '\n');
+}
+
+/* @str is modified, @fields point to it */
+static int split_fields(char *str, char **fields)
+{
+	int nr = 0;
+
+	while (1) {
+		char *comma = strchr(str, ',');
+
+		if (comma)
+			*comma = 0;
+		if (*str == 0 || nr == MAX_FIELDS)
+			return -1;
+		fields[nr++] = str;
+		if (comma == NULL)
+			return nr;
+		str = comma + 1;
+	}
+}
+
+int query_tracks(struct gbuf *buf, const char *view, unsigned int offset,
+		unsigned int limit, const char *fields, const char *filter)
+{
+	char *field_names[MAX_FIELDS];
+	char *field_buf;
+	struct expr *expr = NULL;
+	struct cursor *c;
+	unsigned int pos = offset, scanned = 0, matched = 0;
+	int nr_fields, end = 0;
+
+	c = find_cursor(view);
+	if (c == NULL) {
+		error_msg("unknown view %s, expected lib, pl or queue", view);
+		return -1;
+	}
+	field_buf = xstrdup(fields);
+	nr_fields = split_fields(field_buf, field_names);
+	if (nr_fields < 0) {
+		error_msg("invalid field list %s", fields);
+		free(field_buf);
+		return -1;
+	}
+	if (filter && *filter) {
+		/* reports the error */
+		expr = parse_filter(filter);
+		if (expr == NULL) {
+			free(field_buf);
+			return -1;
+		}
+	}
+	if (limit > QUERY_MAX_LIMIT)
+		limit = QUERY_MAX_LIMIT;
+
+	editable_lock();
+	gbuf_addf(buf, "total %u\n", c->e->nr_tracks);
+	editable_unlock();
+
+	while (matched < limit && scanned < MAX_SCAN) {
+		struct list_head *head = &c->e->head;
+		int n;
+
+		editable_lock();
+		cursor_seek(c, pos);
+		for (n = 0; n < SLICE_SIZE && matched < limit; n++) {
+			struct track_info *ti;
+
+			if (c->item == head)
+				break;
+			ti = to_simple_track(c->item)->info;
+			if (expr == NULL || expr_eval(expr, ti)) {
+				format_track(buf, ti, field_names, nr_fields);
+				matched++;
+			}
+			c->item = c->item->next;
+			c->pos++;
+		}
+		end = c->item == head;
+		pos = c->pos;
+		editable_unlock();
+
+		scanned += n;
+		if (end)
+			break;
+	}
+
+	if (end) {
+		gbuf_add_str(buf, "end\n");
+	} else {
+		gbuf_addf(buf, "next %u\n", pos);
+	}
+
+	if (expr)
+		expr_free(expr);
+	free(field_buf);
+	return 0;
+}
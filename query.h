@@ -0,0 +1,35 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _QUERY_H
+#define _QUERY_H
+
+#include "gbuf.h"
+
+/* most tracks returned by one query */
+#define QUERY_MAX_LIMIT 10000
+
+/*
+ * Appends one page of tracks in @view ("lib", "pl" or "queue") to @buf:
+ *
+ *     total N
+ *     track VALUE<TAB>VALUE...
+ *     next OFFSET | end
+ *
+ * @offset:  position in the view where to start, "next" of the previous page
+ * @limit:   max number of track lines, capped at QUERY_MAX_LIMIT
+ * @fields:  comma separated list of "file", "duration" or tag names
+ * @filter:  filter expression, NULL or "" matches every track
+ *
+ * Only a bounded number of tracks is looked at per call, so a page may
+ * contain less than @limit tracks even if the view isn't exhausted.
+ * editable_lock() is taken for short slices, never for the whole page.
+ *
+ * Returns 0 on success, -1 and reports the error with error_msg() if
+ * the arguments are invalid.
+ */
+int query_tracks(struct gbuf *buf, const char *view, unsigned int offset,
+		unsigned int limit, const char *fields, const char *filter);
+
+#endif
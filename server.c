@@ -30,9 +30,15 @@
 #include "compiler.h"
 #include "debug.h"
 #include "gbuf.h"
+#include "job_stats.h"
+#include "ui_curses.h"
+#include "status.h"
+#include "query.h"
+#include "locking.h"
 
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <sys/socket.h>
 #include <sys/un.h>
 #include <netinet/in.h>
@@ -45,9 +51,110 @@
 #include <unistd.h>
 #include <fcntl.h>
 #include <ctype.h>
+#include <pthread.h>
 
-int server_socket;
-LIST_HEAD(client_head);
+#ifdef __linux__
+#include <sys/epoll.h>
+#else
+#include <poll.h>
+#endif
+
+/*
+ * Clients are served by a separate thread.  It accepts connections, reads
+ * and splits command lines and writes the answers.  Commands are run in
+ * the main thread: complete lines are passed through the requests ring
+ * and the answers come back through the responses ring.  Both rings have
+ * a single producer and a single consumer and don't need locking.
+ */
+
+struct client {
+	struct list_head node;
+	int fd;
+
+	/* read but not yet forwarded */
+	char *in;
+	int in_len;
+	int in_alloc;
+	/* no newline before this */
+	int scan_pos;
+
+	struct gbuf out;
+	size_t out_pos;
+
+	/* EV_* we are waiting for */
+	unsigned int events;
+	/* commands forwarded to the main thread but not answered yet */
+	int inflight;
+	/* too many commands in flight, stopped reading */
+	unsigned int blocked : 1;
+	unsigned int eof : 1;
+	unsigned int error : 1;
+	/* main thread has this client in its subscribers list */
+	unsigned int subscribed : 1;
+	/* asked the main thread to forget this client */
+	unsigned int gone : 1;
+
+	/* used only by the main thread, not bit-fields to avoid races */
+	int authenticated;
+	int auth_failed;
+	int subscriber;
+	struct list_head sub_node;
+	/* milliseconds between position updates, 0 for none */
+	int sub_interval;
+	int sub_pos;
+	uint64_t sub_pos_time;
+	/* updates that didn't fit in the responses ring */
+	struct gbuf sub_pending;
+};
+
+struct server_msg {
+	struct client *client;
+	/* command line, request only.  NULL if the client is closing */
+	char *line;
+	/* answer */
+	char *data;
+	size_t len;
+	/* close connection after sending the answer */
+	int close;
+	/* client is subscribed after this answer */
+	int subscribed;
+	/* subscription update, not an answer to any command */
+	int event;
+};
+
+#define MSG_RING_SIZE 256
+
+struct msg_ring {
+	struct server_msg *msgs[MSG_RING_SIZE];
+	/* head is written by the consumer, tail by the producer */
+	volatile unsigned int head;
+	volatile unsigned int tail;
+};
+
+/* readable when server_serve() should be called */
+int server_fd;
+
+static int server_socket;
+static LIST_HEAD(client_head);
+static int nr_clients = 0;
+
+static struct msg_ring requests;
+static struct msg_ring responses;
+static int main_wake_pipe[2];
+static int server_wake_pipe[2];
+static pthread_t server_thread;
+static volatile int server_quit = 0;
+
+/* commands of other threads, see server_queue_command() */
+struct queued_command {
+	struct list_head node;
+	char *line;
+};
+
+static pthread_mutex_t queued_mutex = CMUS_MUTEX_INITIALIZER;
+static LIST_HEAD(queued_head);
+/* main_wake_pipe has been closed */
+static int queue_closed = 0;
 
 static union {
 	struct sockaddr sa;
@@ -55,7 +162,185 @@ static union {
 	struct sockaddr_in in;
 } addr;
 
-#define MAX_CLIENTS 10
+#define MAX_CLIENTS 128
+/* pipelined commands per client waiting for an answer */
+#define MAX_INFLIGHT 32
+#define MAX_LINE_SIZE (16 * 1024 * 1024)
+/* subscriber that doesn't read its updates is disconnected */
+#define MAX_SUBSCRIBER_BACKLOG (1024 * 1024)
+#define MAX_EVENTS 64
+
+static unsigned int msg_ring_count(struct msg_ring *r)
+{
+	return r->tail - r->head;
+}
+
+static int msg_ring_full(struct msg_ring *r)
+{
+	return msg_ring_count(r) == MSG_RING_SIZE;
+}
+
+/* producer only, ring must not be full */
+static void msg_ring_push(struct msg_ring *r, struct server_msg *msg)
+{
+	r->msgs[r->tail % MSG_RING_SIZE] = msg;
+	/* slot must be written before it is published */
+	__sync_synchronize();
+	r->tail++;
+}
+
+/* consumer only */
+static struct server_msg *msg_ring_pop(struct msg_ring *r)
+{
+	struct server_msg *msg;
+
+	if (r->head == r->tail)
+		return NULL;
+	__sync_synchronize();
+	msg = r->msgs[r->head % MSG_RING_SIZE];
+	__sync_synchronize();
+	r->head++;
+	return msg;
+}
+
+static void wake_up(int fd)
+{
+	char ch = 0;
+
+	/* non-blocking, full pipe means a wakeup is pending anyway */
+	if (write(fd, &ch, 1) < 0 && errno != EAGAIN)
+		d_print("write: %s\n", strerror(errno));
+}
+
+/* event loop, epoll on Linux {{{ */
+
+#define EV_IN	1
+#define EV_OUT	2
+#define EV_ERR	4
+
+struct ev_ready {
+	void *ptr;
+	unsigned int events;
+};
+
+#ifdef __linux__
+
+static int epoll_fd;
+
+static void ev_init(void)
+{
+	epoll_fd = epoll_create(MAX_CLIENTS);
+	if (epoll_fd == -1)
+		die_errno("epoll_create");
+	fcntl(epoll_fd, F_SETFD, FD_CLOEXEC);
+}
+
+/* @events 0 removes interest but keeps the fd registered */
+static void ev_set(int fd, void *ptr, unsigned int events)
+{
+	struct epoll_event ev;
+
+	ev.events = 0;
+	if (events & EV_IN)
+		ev.events |= EPOLLIN;
+	if (events & EV_OUT)
+		ev.events |= EPOLLOUT;
+	ev.data.ptr = ptr;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) && errno == ENOENT)
+		epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev);
+}
+
+static void ev_del(int fd)
+{
+	struct epoll_event ev;
+
+	epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, &ev);
+}
+
+static int ev_wait(struct ev_ready *ready, int max)
+{
+	struct epoll_event evs[MAX_EVENTS];
+	int i, nr;
+
+	nr = epoll_wait(epoll_fd, evs, min(max, MAX_EVENTS), -1);
+	for (i = 0; i < nr; i++) {
+		ready[i].ptr = evs[i].data.ptr;
+		ready[i].events = 0;
+		if (evs[i].events & EPOLLIN)
+			ready[i].events |= EV_IN;
+		if (evs[i].events & EPOLLOUT)
+			ready[i].events |= EV_OUT;
+		if (evs[i].events & (EPOLLERR | EPOLLHUP))
+			ready[i].events |= EV_ERR;
+	}
+	return nr < 0 ? 0 : nr;
+}
+
+#else
+
+static void ev_init(void)
+{
+}
+
+/* poll() looks at the client list directly */
+static void ev_set(int fd, void *ptr, unsigned int events)
+{
+}
+
+static void ev_del(int fd)
+{
+}
+
+static int ev_wait(struct ev_ready *ready, int max)
+{
+	struct pollfd *fds;
+	struct client *client;
+	void **ptrs;
+	int i, n = 0, nr = 0;
+
+	fds = xnew(struct pollfd, nr_clients + 2);
+	ptrs = xnew(void *, nr_clients + 2);
+	fds[n].fd = server_socket;
+	fds[n].events = POLLIN;
+	ptrs[n++] = &server_socket;
+	fds[n].fd = server_wake_pipe[0];
+	fds[n].events = POLLIN;
+	ptrs[n++] = server_wake_pipe;
+	list_for_each_entry(client, &client_head, node) {
+		if (client->error)
+			continue;
+		fds[n].fd = client->fd;
+		fds[n].events = 0;
+		if (client->events & EV_IN)
+			fds[n].events |= POLLIN;
+		if (client->events & EV_OUT)
+			fds[n].events |= POLLOUT;
+		ptrs[n++] = client;
+	}
+
+	if (poll(fds, n, -1) > 0) {
+		for (i = 0; i < n && nr < max; i++) {
+			if (!fds[i].revents)
+				continue;
+			ready[nr].ptr = ptrs[i];
+			ready[nr].events = 0;
+			if (fds[i].revents & POLLIN)
+				ready[nr].events |= EV_IN;
+			if (fds[i].revents & POLLOUT)
+				ready[nr].events |= EV_OUT;
+			if (fds[i].revents & (POLLERR | POLLHUP | POLLNVAL))
+				ready[nr].events |= EV_ERR;
+			nr++;
+		}
+	}
+	free(fds);
+	free(ptrs);
+	return nr;
+}
+
+#endif
+
+/* }}} */
 
 static const char *escape(const char *str)
 {
@@ -88,199 +373,688 @@ static const char *escape(const char *str)
 	return buf;
 }
 
-static int cmd_status(struct client *client)
-{
-	const char *status[] = { "stopped", "playing", "paused" };
-	const char *export_options[] = {
-		"aaa_mode",
-		"continue",
-		"play_library",
-		"play_sorted",
-		"replaygain",
-		"replaygain_limit",
-		"replaygain_preamp",
-		"repeat",
-		"repeat_current",
-		"shuffle",
-		"softvol",
-		NULL
-	};
-	const struct track_info *ti;
-	struct cmus_opt *opt;
-	char optbuf[OPTION_MAX_SIZE];
+static void format_file(struct gbuf *buf, const struct track_info *ti, int pos)
+{
+	int i;
+
+	gbuf_addf(buf, "file %s\n", escape(ti->filename));
+	gbuf_addf(buf, "duration %d\n", ti->duration);
+	gbuf_addf(buf, "position %d\n", pos);
+	for (i = 0; ti->comments[i].key; i++)
+		gbuf_addf(buf, "tag %s %s\n",
+				ti->comments[i].key,
+				escape(ti->comments[i].val));
+}
+
+/*
+ * status [GENERATION]
+ *
+ * only the generation line is sent if the status hasn't changed since
+ * GENERATION
+ */
+static void cmd_status(struct gbuf *buf, const char *arg)
+{
+	struct status_snapshot *s;
+	long int gen;
+
+	status_update_options();
+	s = status_get();
+	if (arg && !str_to_int(arg, &gen) && gen == s->generation) {
+		gbuf_addf(buf, "generation %u\n\n", s->generation);
+		status_put(s);
+		return;
+	}
+	gbuf_add_bytes(buf, s->text, s->text_len);
+	gbuf_addf(buf, "generation %u\n", s->generation);
+	status_put(s);
+
+	/* background job counters */
+	job_stats_format(buf);
+
+	gbuf_add_str(buf, "\n");
+}
+
+/*
+ * tracks VIEW OFFSET LIMIT FIELDS [FILTER]
+ *
+ * one page of tracks, see query_tracks(), or one "error MESSAGE" line
+ */
+static void cmd_tracks(struct gbuf *buf, const char *arg)
+{
+	const char *error = NULL;
+	char *words[4], *str, *ptr;
+	long int offset, limit;
+	int i;
+
+	str = ptr = xstrdup(arg ? arg : "");
+	for (i = 0; i < 4; i++) {
+		while (*ptr == ' ')
+			ptr++;
+		if (*ptr == 0)
+			break;
+		words[i] = ptr;
+		while (*ptr && *ptr != ' ')
+			ptr++;
+		if (*ptr)
+			*ptr++ = 0;
+	}
+	if (i < 4) {
+		error = "expected VIEW OFFSET LIMIT FIELDS [FILTER]";
+	} else if (str_to_int(words[1], &offset) || offset < 0 ||
+			str_to_int(words[2], &limit) || limit < 0) {
+		error = "OFFSET and LIMIT must be positive integers";
+	} else {
+		while (*ptr == ' ')
+			ptr++;
+		/* query_tracks() reports the details itself */
+		if (query_tracks(buf, words[0], offset, limit, words[3], ptr))
+			gbuf_add_str(buf, "error invalid view, field list or filter\n");
+	}
+	if (error) {
+		error_msg("tracks: %s", error);
+		gbuf_addf(buf, "error %s\n", error);
+	}
+	free(str);
+	gbuf_add_ch(buf, '\n');
+}
+
+/* subscriptions {{{ */
+
+/*
+ * Subscribed clients get the full status once and after that only lines
+ * that changed, in the same format as the status command.  Each update
+ * ends with an empty line.  Changes are found by comparing the current
+ * status snapshot against the one that was last sent.
+ */
+
+/* main thread only */
+static struct status_snapshot *last_sent;
+static LIST_HEAD(subscribers);
+
+#define MAX_SUBSCRIBE_INTERVAL (3600 * 1000)
+
+static uint64_t now_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * (uint64_t)1000 + tv.tv_usec / 1000;
+}
+
+static int str_equal(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return a == b;
+	return !strcmp(a, b);
+}
+
+/* lines that changed from @old to @new are added to @buf */
+static int diff_status(struct gbuf *buf, const struct status_snapshot *old,
+		const struct status_snapshot *new)
+{
+	int i, major = 0;
+
+	if (new->status != old->status) {
+		gbuf_addf(buf, "status %s\n", status_names[new->status]);
+		major = 1;
+	}
+	if (new->ti != old->ti) {
+		if (new->ti) {
+			format_file(buf, new->ti, new->pos);
+		} else {
+			/* nothing loaded */
+			gbuf_add_str(buf, "file\n");
+		}
+		major = 1;
+	}
+	if (!str_equal(new->metadata, old->metadata))
+		gbuf_addf(buf, "stream %s\n", new->metadata ? escape(new->metadata) : "");
+
+	for (i = 0; i < NR_STATUS_OPTIONS; i++) {
+		if (strcmp(new->options[i], old->options[i]))
+			gbuf_addf(buf, "set %s %s\n", status_option_names[i], new->options[i]);
+	}
+	if (new->vol_left != old->vol_left || new->vol_right != old->vol_right) {
+		gbuf_addf(buf, "set vol_left %d\n", new->vol_left);
+		gbuf_addf(buf, "set vol_right %d\n", new->vol_right);
+	}
+	return major;
+}
+
+/* pass queued updates to the server thread */
+static void flush_subscribers(void)
+{
+	struct client *client;
+
+	list_for_each_entry(client, &subscribers, sub_node) {
+		struct server_msg *msg;
+
+		if (client->sub_pending.len == 0)
+			continue;
+		/*
+		 * half of the ring is left for answers to commands.  try
+		 * again on next server_notify() or server_serve()
+		 */
+		if (msg_ring_count(&responses) >= MSG_RING_SIZE / 2)
+			break;
+
+		msg = xnew0(struct server_msg, 1);
+		msg->client = client;
+		msg->len = client->sub_pending.len;
+		msg->data = gbuf_steal(&client->sub_pending);
+		msg->event = 1;
+		msg_ring_push(&responses, msg);
+	}
+	wake_up(server_wake_pipe[1]);
+}
+
+static void notify_subscribers(void)
+{
+	struct status_snapshot *s;
+	struct client *client;
+	uint64_t now = now_ms();
 	GBUF(buf);
-	int vol_left, vol_right;
-	int i, ret;
-
-	player_info_lock();
-	gbuf_addf(&buf, "status %s\n", status[player_info.status]);
-	ti = player_info.ti;
-	if (ti) {
-		gbuf_addf(&buf, "file %s\n", escape(ti->filename));
-		gbuf_addf(&buf, "duration %d\n", ti->duration);
-		gbuf_addf(&buf, "position %d\n", player_info.pos);
-		for (i = 0; ti->comments[i].key; i++)
-			gbuf_addf(&buf, "tag %s %s\n",
-					ti->comments[i].key,
-					escape(ti->comments[i].val));
-	}
-
-	/* output options */
-	for (i = 0; export_options[i]; i++) {
-		opt = option_find(export_options[i]);
-		if (opt) {
-			opt->get(opt->id, optbuf);
-			gbuf_addf(&buf, "set %s %s\n", opt->name, optbuf);
+	int major = 0;
+
+	status_update_options();
+	s = status_get();
+	if (last_sent == NULL || last_sent->generation != s->generation) {
+		if (last_sent) {
+			major = diff_status(&buf, last_sent, s);
+			status_put(last_sent);
 		}
+		last_sent = s;
+	} else {
+		status_put(s);
+	}
+
+	list_for_each_entry(client, &subscribers, sub_node) {
+		size_t len = client->sub_pending.len;
+
+		gbuf_add_bytes(&client->sub_pending, buf.buffer, buf.len);
+		if (major) {
+			/* position was sent with the status or file */
+			client->sub_pos = last_sent->pos;
+			client->sub_pos_time = now;
+		}
+		if (last_sent->pos != client->sub_pos && client->sub_interval &&
+				now - client->sub_pos_time >= client->sub_interval) {
+			gbuf_addf(&client->sub_pending, "position %d\n", last_sent->pos);
+			client->sub_pos = last_sent->pos;
+			client->sub_pos_time = now;
+		}
+		if (client->sub_pending.len != len)
+			gbuf_add_ch(&client->sub_pending, '\n');
+	}
+	gbuf_free(&buf);
+	flush_subscribers();
+}
+
+static void subscribe(struct client *client, const char *arg, struct gbuf *out)
+{
+	long int interval = 1000;
+
+	if (arg && (str_to_int(arg, &interval) || interval < 0 ||
+				interval > MAX_SUBSCRIBE_INTERVAL)) {
+		error_msg("subscribe: position interval must be 0-%d ms",
+				MAX_SUBSCRIBE_INTERVAL);
+		gbuf_add_ch(out, '\n');
+		return;
 	}
 
-	/* get volume (copied from ui_curses.c) */
-	if (soft_vol) {
-		vol_left = soft_vol_l;
-		vol_right = soft_vol_r;
-	} else if (!volume_max) {
-		vol_left = vol_right = -1;
+	/* existing subscribers must get changes up to now first */
+	notify_subscribers();
+
+	if (!client->subscriber) {
+		client->subscriber = 1;
+		list_add_tail(&client->sub_node, &subscribers);
+	}
+	client->sub_interval = interval;
+	client->sub_pos = last_sent->pos;
+	client->sub_pos_time = now_ms();
+	cmd_status(out, NULL);
+}
+
+static void unsubscribe(struct client *client)
+{
+	if (!client->subscriber)
+		return;
+	client->subscriber = 0;
+	list_del(&client->sub_node);
+	gbuf_free(&client->sub_pending);
+}
+
+void server_notify(void)
+{
+	if (!list_empty(&subscribers))
+		notify_subscribers();
+}
+
+int server_notify_timeout(void)
+{
+	struct client *client;
+	uint64_t now = now_ms();
+	int timeout = -1;
+
+	if (last_sent == NULL || last_sent->status != PLAYER_STATUS_PLAYING)
+		return -1;
+	list_for_each_entry(client, &subscribers, sub_node) {
+		int t;
+
+		if (!client->sub_interval)
+			continue;
+		t = client->sub_pos_time + client->sub_interval - now;
+		/* position may not have changed yet when the interval is over */
+		if (t < 100)
+			t = 100;
+		if (timeout == -1 || t < timeout)
+			timeout = t;
+	}
+	return timeout;
+}
+
+/* }}} */
+
+static void handle_line(struct client *client, const char *line, struct gbuf *out)
+{
+	char *cmd, *arg;
+
+	if (!client->authenticated) {
+		if (!server_password) {
+			d_print("password is unset, tcp/ip disabled\n");
+			client->auth_failed = 1;
+			return;
+		}
+		client->authenticated = !strcmp(line, server_password);
+		if (!client->authenticated) {
+			d_print("authentication failed\n");
+			client->auth_failed = 1;
+		}
+		return;
+	}
+
+	while (isspace(*line))
+		line++;
+
+	if (*line == '/') {
+		int restricted = 0;
+		line++;
+		search_direction = SEARCH_FORWARD;
+		if (*line == '/') {
+			line++;
+			restricted = 1;
+		}
+		search_text(line, restricted, 1);
+		gbuf_add_ch(out, '\n');
+	} else if (*line == '?') {
+		int restricted = 0;
+		line++;
+		search_direction = SEARCH_BACKWARD;
+		if (*line == '?') {
+			line++;
+			restricted = 1;
+		}
+		search_text(line, restricted, 1);
+		gbuf_add_ch(out, '\n');
+	} else if (parse_command(line, &cmd, &arg)) {
+		if (!strcmp(cmd, "status")) {
+			cmd_status(out, arg);
+		} else if (!strcmp(cmd, "subscribe")) {
+			subscribe(client, arg, out);
+		} else if (!strcmp(cmd, "tracks")) {
+			cmd_tracks(out, arg);
+		} else {
+			run_parsed_command(cmd, arg);
+			gbuf_add_ch(out, '\n');
+		}
+		free(cmd);
+		free(arg);
 	} else {
-		vol_left = scale_to_percentage(volume_l, volume_max);
-		vol_right = scale_to_percentage(volume_r, volume_max);
+		// don't hang cmus-remote
+		gbuf_add_ch(out, '\n');
 	}
+}
 
-	/* output volume */
-	gbuf_addf(&buf, "set vol_left %d\n", vol_left);
-	gbuf_addf(&buf, "set vol_right %d\n", vol_right);
+void server_queue_command(const char *line)
+{
+	struct queued_command *q = xnew(struct queued_command, 1);
 
-	gbuf_add_str(&buf, "\n");
-	player_info_unlock();
+	q->line = xstrdup(line);
+	cmus_mutex_lock(&queued_mutex);
+	if (queue_closed) {
+		cmus_mutex_unlock(&queued_mutex);
+		free(q->line);
+		free(q);
+		return;
+	}
+	list_add_tail(&q->node, &queued_head);
+	wake_up(main_wake_pipe[1]);
+	cmus_mutex_unlock(&queued_mutex);
+}
 
-	ret = write_all(client->fd, buf.buffer, buf.len);
-	gbuf_free(&buf);
-	return ret;
+/* @run is 0 at exit, the commands are only freed */
+static void run_queued_commands(int run)
+{
+	LIST_HEAD(head);
+	struct queued_command *q, *next;
+
+	/* commands could queue more */
+	cmus_mutex_lock(&queued_mutex);
+	list_splice_init(&queued_head, &head);
+	cmus_mutex_unlock(&queued_mutex);
+
+	list_for_each_entry_safe(q, next, &head, node) {
+		if (run)
+			run_command(q->line);
+		free(q->line);
+		free(q);
+	}
+}
+
+void server_serve(void)
+{
+	struct server_msg *msg;
+	char buf[64];
+	int n = 0;
+
+	while (read(server_fd, buf, sizeof(buf)) > 0)
+		;
+
+	run_queued_commands(1);
+
+	/* unix connection is secure, other insecure */
+	run_only_safe_commands = addr.sa.sa_family != AF_UNIX;
+
+	/* no room for the answer => leave the command in the queue */
+	while (!msg_ring_full(&responses) && (msg = msg_ring_pop(&requests))) {
+		struct client *client = msg->client;
+		GBUF(out);
+
+		if (msg->line == NULL) {
+			/* connection is being closed */
+			unsubscribe(client);
+		} else if (!client->auth_failed) {
+			/* commands after failed authentication are ignored */
+			handle_line(client, msg->line, &out);
+		}
+		free(msg->line);
+		msg->line = NULL;
+		msg->len = out.len;
+		msg->data = out.len ? gbuf_steal(&out) : NULL;
+		msg->close = client->auth_failed;
+		msg->subscribed = client->subscriber;
+		msg_ring_push(&responses, msg);
+		n++;
+	}
+
+	run_only_safe_commands = 0;
+	if (!list_empty(&subscribers)) {
+		/* commands may have changed something */
+		notify_subscribers();
+	} else if (n) {
+		wake_up(server_wake_pipe[1]);
+	}
 }
 
-static void read_commands(struct client *client)
+/* }}} */
+
+/* server thread {{{ */
+
+static void client_update_events(struct client *client)
 {
-	char buf[1024];
-	int pos = 0;
-	int authenticated = addr.sa.sa_family == AF_UNIX;
+	unsigned int events = 0;
+
+	if (client->error) {
+		/* waiting for the main thread, don't report EV_ERR again */
+		if (client->events != EV_ERR) {
+			client->events = EV_ERR;
+			ev_del(client->fd);
+		}
+		return;
+	}
+	if (!client->blocked && !client->eof)
+		events |= EV_IN;
+	if (client->out.len > client->out_pos)
+		events |= EV_OUT;
+	if (events != client->events) {
+		client->events = events;
+		ev_set(client->fd, client, events);
+	}
+}
+
+static void client_free(struct client *client)
+{
+	ev_del(client->fd);
+	close(client->fd);
+	list_del(&client->node);
+	free(client->in);
+	gbuf_free(&client->out);
+	gbuf_free(&client->sub_pending);
+	free(client);
+	nr_clients--;
+}
+
+/* closes the connection when there is nothing left to do */
+static int client_check_close(struct client *client)
+{
+	/* subscribers keep the connection open after EOF */
+	int done = client->error || (client->eof && !client->subscribed &&
+			client->in_len == 0 && client->out.len == client->out_pos);
+
+	if (!done || client->inflight)
+		return 0;
+
+	if (client->subscribed) {
+		/* main thread must forget the client before it can be freed */
+		if (!client->gone && !msg_ring_full(&requests)) {
+			struct server_msg *msg = xnew0(struct server_msg, 1);
+
+			msg->client = client;
+			msg_ring_push(&requests, msg);
+			client->inflight++;
+			client->gone = 1;
+		}
+		return 0;
+	}
+	client_free(client);
+	return 1;
+}
+
+/* forward complete lines to the main thread, returns number of lines */
+static int client_parse(struct client *client)
+{
+	int s = 0, i, n = 0;
+
+	client->blocked = 0;
+	for (i = client->scan_pos; i < client->in_len; i++) {
+		struct server_msg *msg;
+
+		if (client->in[i] != '\n')
+			continue;
+
+		/* back-pressure, continue after some answers have been sent */
+		if (client->inflight >= MAX_INFLIGHT || msg_ring_full(&requests)) {
+			client->blocked = 1;
+			break;
+		}
+
+		msg = xnew0(struct server_msg, 1);
+		msg->client = client;
+		msg->line = xstrndup(client->in + s, i - s);
+		msg_ring_push(&requests, msg);
+		client->inflight++;
+		n++;
+		s = i + 1;
+	}
+	memmove(client->in, client->in + s, client->in_len - s);
+	client->in_len -= s;
+	client->scan_pos = client->blocked ? 0 : client->in_len;
+
+	/* line without newline at EOF is ignored, like before */
+	if (client->eof && !client->blocked)
+		client->in_len = 0;
+	return n;
+}
+
+static int client_read(struct client *client)
+{
+	int n = 0;
 
 	while (1) {
-		int rc, s, i;
+		int rc;
 
-		rc = read(client->fd, buf + pos, sizeof(buf) - pos);
+		/* lines are parsed after every read, only a partial line is left */
+		if (client->in_alloc - client->in_len < 1024) {
+			if (client->in_alloc >= MAX_LINE_SIZE) {
+				d_print("line too long\n");
+				client->error = 1;
+				return n;
+			}
+			client->in_alloc = client->in_alloc ? client->in_alloc * 2 : 4096;
+			client->in = xrenew(char, client->in, client->in_alloc);
+		}
+		rc = read(client->fd, client->in + client->in_len,
+				client->in_alloc - client->in_len);
 		if (rc == -1) {
 			if (errno == EINTR)
 				continue;
-			if (errno == EAGAIN)
-				return;
-			goto close;
+			if (errno != EAGAIN)
+				client->error = 1;
+			break;
 		}
-		if (rc == 0)
-			goto close;
-		pos += rc;
-
-		s = 0;
-		for (i = 0; i < pos; i++) {
-			const char *line;
-			char *cmd, *arg;
-			int ret;
+		if (rc == 0) {
+			client->eof = 1;
+			break;
+		}
+		client->in_len += rc;
+		n += client_parse(client);
+		/* the rest is read when some answers have been sent */
+		if (client->blocked)
+			return n;
+	}
+	return n + client_parse(client);
+}
 
-			if (buf[i] != '\n')
-				continue;
+static void client_write(struct client *client)
+{
+	while (client->out.len > client->out_pos) {
+		int rc = write(client->fd, client->out.buffer + client->out_pos,
+				client->out.len - client->out_pos);
 
-			buf[i] = 0;
-			line = buf + s;
-			s = i + 1;
-
-			if (!authenticated) {
-				if (!server_password) {
-					d_print("password is unset, tcp/ip disabled\n");
-					goto close;
-				}
-				authenticated = !strcmp(line, server_password);
-				if (!authenticated) {
-					d_print("authentication failed\n");
-					goto close;
-				}
+		if (rc == -1) {
+			if (errno == EINTR)
 				continue;
-			}
-
-			while (isspace(*line))
-				line++;
-
-			if (*line == '/') {
-				int restricted = 0;
-				line++;
-				search_direction = SEARCH_FORWARD;
-				if (*line == '/') {
-					line++;
-					restricted = 1;
-				}
-				search_text(line, restricted, 1);
-				ret = write_all(client->fd, "\n", 1);
-			} else if (*line == '?') {
-				int restricted = 0;
-				line++;
-				search_direction = SEARCH_BACKWARD;
-				if (*line == '?') {
-					line++;
-					restricted = 1;
-				}
-				search_text(line, restricted, 1);
-				ret = write_all(client->fd, "\n", 1);
-			} else if (parse_command(line, &cmd, &arg)) {
-				if (!strcmp(cmd, "status")) {
-					ret = cmd_status(client);
-				} else {
-					run_parsed_command(cmd, arg);
-					ret = write_all(client->fd, "\n", 1);
-				}
-				free(cmd);
-				free(arg);
-			} else {
-				// don't hang cmus-remote
-				ret = write_all(client->fd, "\n", 1);
-			}
-			if (ret < 0) {
+			if (errno != EAGAIN) {
 				d_print("write: %s\n", strerror(errno));
-				goto close;
+				client->error = 1;
 			}
+			return;
 		}
-		memmove(buf, buf + s, pos - s);
-		pos -= s;
+		client->out_pos += rc;
 	}
-	return;
-close:
-	close(client->fd);
-	list_del(&client->node);
-	free(client);
+	gbuf_clear(&client->out);
+	client->out_pos = 0;
 }
 
-void server_accept(void)
+static void accept_clients(void)
 {
-	struct client *client;
-	struct sockaddr saddr;
-	socklen_t saddr_size = sizeof(saddr);
-	int fd;
+	while (1) {
+		struct client *client;
+		struct sockaddr saddr;
+		socklen_t saddr_size = sizeof(saddr);
+		int fd;
 
-	fd = accept(server_socket, &saddr, &saddr_size);
-	if (fd == -1)
-		return;
+		fd = accept(server_socket, &saddr, &saddr_size);
+		if (fd == -1)
+			return;
 
-	fcntl(fd, F_SETFL, O_NONBLOCK);
+		fcntl(fd, F_SETFL, O_NONBLOCK);
+		fcntl(fd, F_SETFD, FD_CLOEXEC);
 
-	client = xnew(struct client, 1);
-	client->fd = fd;
-	list_add_tail(&client->node, &client_head);
+		client = xnew0(struct client, 1);
+		client->fd = fd;
+		client->out.buffer = gbuf_empty_buffer;
+		client->sub_pending.buffer = gbuf_empty_buffer;
+		client->authenticated = addr.sa.sa_family == AF_UNIX;
+		list_add_tail(&client->node, &client_head);
+		nr_clients++;
+		client_update_events(client);
+	}
 }
 
-void server_serve(struct client *client)
+/* answers from the main thread, returns 1 if the ring was full */
+static int handle_responses(void)
 {
-	/* unix connection is secure, other insecure */
-	run_only_safe_commands = addr.sa.sa_family != AF_UNIX;
-	read_commands(client);
-	run_only_safe_commands = 0;
+	struct server_msg *msg;
+	int was_full = msg_ring_full(&responses);
+
+	while ((msg = msg_ring_pop(&responses))) {
+		struct client *client = msg->client;
+
+		if (!msg->event) {
+			client->inflight--;
+			client->subscribed = msg->subscribed;
+		}
+		if (msg->data && !client->error)
+			gbuf_add_bytes(&client->out, msg->data, msg->len);
+		if (msg->close)
+			client->error = 1;
+		if (msg->event && client->out.len - client->out_pos > MAX_SUBSCRIBER_BACKLOG) {
+			d_print("subscriber too slow, disconnecting\n");
+			client->error = 1;
+		}
+		free(msg->data);
+		free(msg);
+	}
+	return was_full;
 }
 
+static void *server_loop(void *arg)
+{
+	struct ev_ready ready[MAX_EVENTS];
+
+	while (!server_quit) {
+		struct client *client, *next;
+		int i, nr, forwarded = 0;
+
+		nr = ev_wait(ready, MAX_EVENTS);
+		for (i = 0; i < nr; i++) {
+			if (ready[i].ptr == &server_socket) {
+				accept_clients();
+			} else if (ready[i].ptr == server_wake_pipe) {
+				char buf[64];
+
+				while (read(server_wake_pipe[0], buf, sizeof(buf)) > 0)
+					;
+			} else {
+				client = ready[i].ptr;
+				if (ready[i].events & EV_IN)
+					forwarded += client_read(client);
+				if (ready[i].events & EV_ERR)
+					client->error = 1;
+			}
+		}
+
+		/* the rings may have room again */
+		if (handle_responses())
+			forwarded++;
+		list_for_each_entry_safe(client, next, &client_head, node) {
+			if (client->blocked || (client->eof && client->in_len))
+				forwarded += client_parse(client);
+			if (!client->error)
+				client_write(client);
+			if (!client_check_close(client))
+				client_update_events(client);
+		}
+
+		if (forwarded || msg_ring_count(&requests))
+			wake_up(main_wake_pipe[1]);
+	}
+	return NULL;
+}
+
+/* }}} */
+
 static void gethostbyname_failed(void)
 {
 	const char *error = "Unknown error.";
@@ -300,10 +1074,20 @@ static void gethostbyname_failed(void)
 	die("gethostbyname: %s\n", error);
 }
 
+static void make_wake_pipe(int fds[2])
+{
+	if (pipe(fds) == -1)
+		die_errno("pipe");
+	fcntl(fds[0], F_SETFL, O_NONBLOCK);
+	fcntl(fds[1], F_SETFL, O_NONBLOCK);
+	fcntl(fds[0], F_SETFD, FD_CLOEXEC);
+	fcntl(fds[1], F_SETFD, FD_CLOEXEC);
+}
+
 void server_init(char *address)
 {
 	int port = DEFAULT_PORT;
-	int addrlen;
+	int addrlen, rc;
 
 	if (strchr(address, '/')) {
 		addr.sa.sa_family = AF_UNIX;
@@ -374,10 +1158,55 @@ void server_init(char *address)
 
 	if (listen(server_socket, MAX_CLIENTS) == -1)
 		die_errno("listen");
+	fcntl(server_socket, F_SETFL, O_NONBLOCK);
+	fcntl(server_socket, F_SETFD, FD_CLOEXEC);
+
+	make_wake_pipe(main_wake_pipe);
+	make_wake_pipe(server_wake_pipe);
+	server_fd = main_wake_pipe[0];
+
+	ev_init();
+	ev_set(server_socket, &server_socket, EV_IN);
+	ev_set(server_wake_pipe[0], server_wake_pipe, EV_IN);
+
+	rc = pthread_create(&server_thread, NULL, server_loop, NULL);
+	if (rc)
+		die("pthread_create: %s\n", strerror(rc));
 }
 
 void server_exit(void)
 {
+	struct server_msg *msg;
+	struct client *client, *next;
+
+	server_quit = 1;
+	wake_up(server_wake_pipe[1]);
+	pthread_join(server_thread, NULL);
+
+	while ((msg = msg_ring_pop(&requests))) {
+		free(msg->line);
+		free(msg);
+	}
+	while ((msg = msg_ring_pop(&responses))) {
+		free(msg->data);
+		free(msg);
+	}
+	list_for_each_entry_safe(client, next, &client_head, node)
+		client_free(client);
+	list_init(&subscribers);
+	if (last_sent)
+		status_put(last_sent);
+	last_sent = NULL;
+
+	cmus_mutex_lock(&queued_mutex);
+	queue_closed = 1;
+	cmus_mutex_unlock(&queued_mutex);
+	run_queued_commands(0);
+
+	close(main_wake_pipe[0]);
+	close(main_wake_pipe[1]);
+	close(server_wake_pipe[0]);
+	close(server_wake_pipe[1]);
 	close(server_socket);
 	if (addr.sa.sa_family == AF_UNIX)
 		unlink(addr.un.sun_path);
@@ -5,19 +5,30 @@
 #ifndef _SERVER_H
 #define _SERVER_H
 
-#include "list.h"
-
-struct client {
-	struct list_head node;
-	int fd;
-};
-
-extern int server_socket;
-extern struct list_head client_head;
+/*
+ * Clients are handled by a separate thread.  server_fd becomes readable
+ * when there are commands waiting to be run, then call server_serve()
+ * from the main thread.
+ */
+extern int server_fd;
 
 void server_init(char *address);
 void server_exit(void);
-void server_accept(void);
-void server_serve(struct client *client);
+void server_serve(void);
+
+/*
+ * runs @line with run_command() in the main thread when server_fd is
+ * served.  can be called from any thread, errors go to error_msg()
+ */
+void server_queue_command(const char *line);
+
+/*
+ * Send changes in player status, volume and options to subscribed
+ * clients.  Call from the main thread after something may have changed.
+ */
+void server_notify(void);
+
+/* milliseconds until next position update is due, -1 for none */
+int server_notify_timeout(void);
 
 #endif
@@ -0,0 +1,56 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "slab.h"
+#include "xmalloc.h"
+#include "debug.h"
+
+static void next_chunk(struct slab *s)
+{
+	struct slab_chunk *chunk;
+
+	chunk = s->cur ? s->cur->next : s->chunks;
+	if (chunk == NULL) {
+		chunk = xnew(struct slab_chunk, 1);
+		chunk->next = NULL;
+		if (s->cur)
+			s->cur->next = chunk;
+		else
+			s->chunks = chunk;
+	}
+	s->cur = chunk;
+	s->cur_pos = 0;
+}
+
+void *slab_alloc(struct slab *s)
+{
+	void *obj = s->free_list;
+
+	if (obj) {
+		s->free_list = *(void **)obj;
+	} else {
+		if (s->cur == NULL || s->cur_pos + s->size > SLAB_CHUNK_SIZE)
+			next_chunk(s);
+		obj = s->cur->data + s->cur_pos;
+		s->cur_pos += s->size;
+	}
+	s->nr_used++;
+	return obj;
+}
+
+void slab_free(struct slab *s, void *obj)
+{
+	BUG_ON(s->nr_used == 0);
+
+	s->nr_used--;
+	if (s->nr_used == 0) {
+		/* everything is free, start over from the first chunk */
+		s->free_list = NULL;
+		s->cur = NULL;
+		s->cur_pos = 0;
+		return;
+	}
+	*(void **)obj = s->free_list;
+	s->free_list = obj;
+}
@@ -0,0 +1,46 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _SLAB_H
+#define _SLAB_H
+
+/*
+ * Allocator for many small objects of one type (view nodes).  Objects are
+ * carved from big chunks and freed objects are reused.  When the last
+ * object is freed the slab starts over from its first chunk, so a view
+ * rebuilt after editable_clear() gets the same memory back, in order,
+ * without calling malloc.  Chunks are never returned to the system.
+ *
+ * Not thread safe.  The view slabs are used under editable_lock().
+ */
+
+#define SLAB_CHUNK_SIZE (64 * 1024)
+
+struct slab_chunk {
+	struct slab_chunk *next;
+	char data[SLAB_CHUNK_SIZE];
+};
+
+struct slab {
+	/* object size, rounded up to pointer alignment */
+	unsigned int size;
+	unsigned int nr_used;
+	/* freed objects, linked through their first word */
+	void *free_list;
+	struct slab_chunk *chunks;
+	/* chunk being carved, NULL before the first allocation */
+	struct slab_chunk *cur;
+	unsigned int cur_pos;
+};
+
+#define SLAB_OBJ_SIZE(size) \
+	(((size) + sizeof(void *) - 1) & ~(sizeof(void *) - 1))
+
+#define SLAB(name, type) \
+	struct slab name = { SLAB_OBJ_SIZE(sizeof(type)), 0, NULL, NULL, NULL, 0 }
+
+void *slab_alloc(struct slab *s);
+void slab_free(struct slab *s, void *obj);
+
+#endif
@@ -27,10 +27,18 @@
 #include <fcntl.h>
 #include <errno.h>
 
-int spawn(char *argv[], int *status)
+/*
+ * fork and exec @argv with stdin from @stdin_fd (closed if -1) and stdout
+ * and stderr redirected to /dev/null.  returns after exec has succeeded
+ *
+ * returns pid of the child, or -1 and errno.  the child is reaped on
+ * error and @status, if not NULL, is set
+ */
+static pid_t fork_exec(char *argv[], int stdin_fd, int *status)
 {
 	pid_t pid;
 	int err_pipe[2];
+	int rc, errno_save, child_errno;
 
 	if (pipe(err_pipe) == -1)
 		return -1;
@@ -38,6 +46,10 @@ int spawn(char *argv[], int *status)
 	pid = fork();
 	if (pid == -1) {
 		/* error */
+		errno_save = errno;
+		close(err_pipe[0]);
+		close(err_pipe[1]);
+		errno = errno_save;
 		return -1;
 	} else if (pid == 0) {
 		/* child */
@@ -46,6 +58,15 @@ int spawn(char *argv[], int *status)
 		close(err_pipe[0]);
 		fcntl(err_pipe[1], F_SETFD, FD_CLOEXEC);
 
+		if (stdin_fd != -1) {
+			dup2(stdin_fd, 0);
+			if (stdin_fd != 0)
+				close(stdin_fd);
+		} else {
+			/* not interactive, close stdin */
+			close(0);
+		}
+
 		/* redirect stdout and stderr to /dev/null if possible */
 		dev_null = open("/dev/null", O_WRONLY);
 		if (dev_null != -1) {
@@ -53,12 +74,11 @@ int spawn(char *argv[], int *status)
 			dup2(dev_null, 2);
 		}
 
-		/* not interactive, close stdin */
-		close(0);
-
-		/* close unused fds */
-		for (i = 3; i < 30; i++)
-			close(i);
+		/* close unused fds, err_pipe is closed by exec */
+		for (i = 3; i < 30; i++) {
+			if (i != err_pipe[1])
+				close(i);
+		}
 
 		execvp(argv[0], argv);
 
@@ -66,29 +86,58 @@ int spawn(char *argv[], int *status)
 		err = errno;
 		write_all(err_pipe[1], &err, sizeof(int));
 		exit(1);
-	} else {
-		/* parent */
-		int rc, errno_save, child_errno;
+	}
 
-		close(err_pipe[1]);
-		rc = read_all(err_pipe[0], &child_errno, sizeof(int));
-		errno_save = errno;
-		close(err_pipe[0]);
+	/* parent */
+	close(err_pipe[1]);
+	rc = read_all(err_pipe[0], &child_errno, sizeof(int));
+	errno_save = errno;
+	close(err_pipe[0]);
 
+	if (rc != 0) {
 		waitpid(pid, status, 0);
-
 		if (rc == -1) {
 			errno = errno_save;
-			return -1;
-		}
-		if (rc == sizeof(int)) {
+		} else if (rc == sizeof(int)) {
 			errno = child_errno;
-			return -1;
-		}
-		if (rc != 0) {
+		} else {
 			errno = EMSGSIZE;
-			return -1;
 		}
-		return 0;
+		return -1;
+	}
+	return pid;
+}
+
+int spawn(char *argv[], int *status)
+{
+	pid_t pid;
+
+	pid = fork_exec(argv, -1, status);
+	if (pid == -1)
+		return -1;
+	waitpid(pid, status, 0);
+	return 0;
+}
+
+pid_t spawn_coprocess(char *argv[], int *in_fd)
+{
+	pid_t pid;
+	int in_pipe[2];
+	int errno_save;
+
+	if (pipe(in_pipe) == -1)
+		return -1;
+	/* not inherited by this or any other child */
+	fcntl(in_pipe[1], F_SETFD, FD_CLOEXEC);
+
+	pid = fork_exec(argv, in_pipe[0], NULL);
+	errno_save = errno;
+	close(in_pipe[0]);
+	if (pid == -1) {
+		close(in_pipe[1]);
+		errno = errno_save;
+		return -1;
 	}
+	*in_fd = in_pipe[1];
+	return pid;
 }
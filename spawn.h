@@ -20,6 +20,16 @@
 #ifndef _SPAWN_H
 #define _SPAWN_H
 
+#include <sys/types.h>
+
 int spawn(char *argv[], int *status);
 
+/*
+ * starts @argv in the background with stdin connected to a pipe
+ *
+ * returns pid of the child and sets @in_fd to the write end of the pipe,
+ * or -1 and errno
+ */
+pid_t spawn_coprocess(char *argv[], int *in_fd);
+
 #endif
@@ -0,0 +1,252 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "stat_batch.h"
+#include "locking.h"
+#include "xmalloc.h"
+#include "debug.h"
+
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <string.h>
+#include <errno.h>
+
+#define NR_STAT_THREADS 8
+/* threads stuck in stat() before giving up on the rest */
+#define MAX_STUCK_THREADS 16
+
+enum {
+	STAT_PENDING,
+	STAT_RUNNING,
+	STAT_DONE
+};
+
+struct stat_file {
+	char *filename;
+	int state;
+	struct stat_result res;
+};
+
+/* one per thread, never reused so a stuck thread keeps its own */
+struct stat_worker {
+	struct stat_pool *pool;
+	/* file in stat(), NULL if none or timed out */
+	struct stat_file *file;
+	/* when stat() was started, ms */
+	uint64_t start;
+};
+
+/*
+ * shared by the caller and the threads, freed by whoever drops the last
+ * reference.  stuck threads may outlive stat_batch()
+ */
+struct stat_pool {
+	pthread_mutex_t mutex;
+	pthread_cond_t cond;
+	int ref;
+	int quit;
+
+	struct stat_file *files;
+	int nr;
+	int next;
+	int nr_done;
+
+	/* the initial threads, replacements of stuck ones and the caller */
+	struct stat_worker workers[NR_STAT_THREADS + MAX_STUCK_THREADS + 1];
+	int nr_workers;
+};
+
+static uint64_t now_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+/* pool must be locked, unlocks it */
+static void pool_unref(struct stat_pool *p)
+{
+	int i;
+
+	if (--p->ref) {
+		cmus_mutex_unlock(&p->mutex);
+		return;
+	}
+	cmus_mutex_unlock(&p->mutex);
+
+	for (i = 0; i < p->nr; i++)
+		free(p->files[i].filename);
+	free(p->files);
+	pthread_cond_destroy(&p->cond);
+	pthread_mutex_destroy(&p->mutex);
+	free(p);
+}
+
+static void *stat_thread(void *arg)
+{
+	struct stat_worker *w = arg;
+	struct stat_pool *p = w->pool;
+
+	cmus_mutex_lock(&p->mutex);
+	while (!p->quit && p->next < p->nr) {
+		struct stat_file *f = &p->files[p->next++];
+		struct stat st;
+		int rc;
+
+		f->state = STAT_RUNNING;
+		w->file = f;
+		w->start = now_ms();
+		cmus_mutex_unlock(&p->mutex);
+
+		rc = stat(f->filename, &st);
+
+		cmus_mutex_lock(&p->mutex);
+		/* may have timed out already */
+		if (f->state == STAT_RUNNING) {
+			f->res.err = rc ? errno : 0;
+			f->res.mtime = rc ? 0 : st.st_mtime;
+			f->state = STAT_DONE;
+			w->file = NULL;
+			/* stat_batch() wakes up by itself for the deadlines */
+			if (++p->nr_done == p->nr)
+				pthread_cond_signal(&p->cond);
+		}
+	}
+	pool_unref(p);
+	return NULL;
+}
+
+/* pool must be locked */
+static struct stat_worker *new_worker(struct stat_pool *p)
+{
+	struct stat_worker *w = &p->workers[p->nr_workers++];
+
+	w->pool = p;
+	w->file = NULL;
+	w->start = 0;
+	p->ref++;
+	return w;
+}
+
+/* pool must be locked */
+static int start_thread(struct stat_pool *p)
+{
+	pthread_attr_t attr;
+	pthread_t tid;
+	struct stat_worker *w = new_worker(p);
+	int rc;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	rc = pthread_create(&tid, &attr, stat_thread, w);
+	pthread_attr_destroy(&attr);
+	if (rc) {
+		d_print("pthread_create: %s\n", strerror(rc));
+		p->nr_workers--;
+		p->ref--;
+		return -1;
+	}
+	return 0;
+}
+
+/* pool must be locked */
+static void time_out(struct stat_pool *p, struct stat_file *f)
+{
+	d_print("stat timed out: %s\n", f->filename);
+	f->res.err = ETIMEDOUT;
+	f->state = STAT_DONE;
+	p->nr_done++;
+}
+
+struct stat_result *stat_batch(char * const *filenames, int nr, int timeout_ms,
+		int (*cancel)(void))
+{
+	struct stat_result *results = NULL;
+	struct stat_pool *p;
+	int i, nr_threads = 0, nr_stuck = 0;
+
+	p = xnew(struct stat_pool, 1);
+	pthread_mutex_init(&p->mutex, NULL);
+	pthread_cond_init(&p->cond, NULL);
+	p->ref = 1;
+	p->quit = 0;
+	p->files = xnew(struct stat_file, nr);
+	p->nr = nr;
+	p->next = 0;
+	p->nr_done = 0;
+	p->nr_workers = 0;
+	for (i = 0; i < nr; i++) {
+		/* copied, a stuck thread may still use it after we return */
+		p->files[i].filename = xstrdup(filenames[i]);
+		p->files[i].state = STAT_PENDING;
+	}
+
+	cmus_mutex_lock(&p->mutex);
+	for (i = 0; i < NR_STAT_THREADS && i < nr; i++) {
+		if (start_thread(p))
+			break;
+		nr_threads++;
+	}
+	if (nr_threads == 0) {
+		/* stat everything in this thread */
+		struct stat_worker *w = new_worker(p);
+
+		cmus_mutex_unlock(&p->mutex);
+		stat_thread(w);
+		cmus_mutex_lock(&p->mutex);
+	}
+
+	while (p->nr_done < nr) {
+		struct timespec ts;
+		uint64_t now, wake;
+
+		if (cancel && cancel())
+			goto out;
+
+		/* check timeouts, and wake up at least every 100 ms for @cancel */
+		now = now_ms();
+		wake = now + 100;
+		for (i = 0; i < p->nr_workers; i++) {
+			struct stat_worker *w = &p->workers[i];
+			uint64_t deadline;
+
+			if (w->file == NULL)
+				continue;
+			deadline = w->start + timeout_ms;
+			if (deadline > now) {
+				if (deadline < wake)
+					wake = deadline;
+				continue;
+			}
+
+			time_out(p, w->file);
+			w->file = NULL;
+			if (++nr_stuck < MAX_STUCK_THREADS && start_thread(p) == 0)
+				continue;
+
+			/* give up */
+			p->quit = 1;
+			for (i = p->next; i < nr; i++)
+				time_out(p, &p->files[i]);
+			p->next = nr;
+			break;
+		}
+		if (p->nr_done == nr)
+			break;
+
+		ts.tv_sec = wake / 1000;
+		ts.tv_nsec = (wake % 1000) * 1000000;
+		pthread_cond_timedwait(&p->cond, &p->mutex, &ts);
+	}
+
+	results = xnew(struct stat_result, nr);
+	for (i = 0; i < nr; i++)
+		results[i] = p->files[i].res;
+out:
+	p->quit = 1;
+	pool_unref(p);
+	return results;
+}
@@ -0,0 +1,30 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _STAT_BATCH_H
+#define _STAT_BATCH_H
+
+#include <sys/types.h>
+#include <time.h>
+
+struct stat_result {
+	time_t mtime;
+	/* 0, errno from stat() or ETIMEDOUT */
+	int err;
+};
+
+/*
+ * stat() @nr files using a pool of threads, without any locks held
+ *
+ * A file whose stat() takes longer than @timeout_ms (unreachable mount)
+ * gets ETIMEDOUT and its thread is abandoned.  If too many threads get
+ * stuck the rest of the files get ETIMEDOUT too, so this always returns.
+ *
+ * @cancel is polled while waiting.  Returns NULL if it returned non-zero,
+ * otherwise an array of @nr results which must be freed.
+ */
+struct stat_result *stat_batch(char * const *filenames, int nr, int timeout_ms,
+		int (*cancel)(void));
+
+#endif
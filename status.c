@@ -0,0 +1,267 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "status.h"
+#include "player.h"
+#include "options.h"
+#include "output.h"
+#include "comment.h"
+#include "locking.h"
+#include "gbuf.h"
+#include "utils.h"
+#include "xmalloc.h"
+#include "debug.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+const char * const status_option_names[NR_STATUS_OPTIONS + 1] = {
+	"aaa_mode",
+	"continue",
+	"play_library",
+	"play_sorted",
+	"replaygain",
+	"replaygain_limit",
+	"replaygain_preamp",
+	"repeat",
+	"repeat_current",
+	"shuffle",
+	"softvol",
+	NULL
+};
+
+const char * const status_names[] = { "stopped", "playing", "paused", NULL };
+
+/* serializes status_update() */
+static pthread_mutex_t update_mutex = CMUS_MUTEX_INITIALIZER;
+/* held only while taking a reference to current */
+static pthread_mutex_t ref_mutex = CMUS_MUTEX_INITIALIZER;
+static struct status_snapshot *current = NULL;
+static volatile unsigned int generation = 0;
+
+/*
+ * values of status_option_names[], empty until the options are registered.
+ * options are not locked, so they are only read on the main thread by
+ * status_update_options().  protected by update_mutex
+ */
+static char option_values[NR_STATUS_OPTIONS][OPTION_MAX_SIZE];
+
+static void snapshot_free(struct status_snapshot *s)
+{
+	int i;
+
+	if (s->ti)
+		track_info_unref(s->ti);
+	free(s->metadata);
+	free(s->stream_title);
+	for (i = 0; i < NR_STATUS_OPTIONS; i++)
+		free(s->options[i]);
+	free(s->text);
+	free(s);
+}
+
+static char *parse_stream_title(const char *metadata)
+{
+	const char *ptr, *title;
+
+	ptr = strstr(metadata, "StreamTitle='");
+	if (ptr == NULL)
+		return NULL;
+	title = ptr + 13;
+	for (ptr = title; *ptr; ptr++) {
+		if (ptr[0] == '\'' && ptr[1] == ';')
+			return xstrndup(title, ptr - title);
+	}
+	return NULL;
+}
+
+static void add_escaped(struct gbuf *buf, const char *str)
+{
+	for (; *str; str++) {
+		if (*str == '\\') {
+			gbuf_add_str(buf, "\\\\");
+		} else if (*str == '\n') {
+			gbuf_add_str(buf, "\\n");
+		} else {
+			gbuf_add_ch(buf, *str);
+		}
+	}
+}
+
+static void format_text(struct status_snapshot *s)
+{
+	const struct track_info *ti = s->ti;
+	GBUF(buf);
+	int i;
+
+	gbuf_addf(&buf, "status %s\n", status_names[s->status]);
+	if (ti) {
+		gbuf_add_str(&buf, "file ");
+		add_escaped(&buf, ti->filename);
+		gbuf_addf(&buf, "\nduration %d\n", ti->duration);
+		gbuf_addf(&buf, "position %d\n", s->pos);
+		for (i = 0; ti->comments[i].key; i++) {
+			gbuf_addf(&buf, "tag %s ", ti->comments[i].key);
+			add_escaped(&buf, ti->comments[i].val);
+			gbuf_add_ch(&buf, '\n');
+		}
+	}
+	for (i = 0; i < NR_STATUS_OPTIONS; i++) {
+		if (s->options[i][0])
+			gbuf_addf(&buf, "set %s %s\n", status_option_names[i], s->options[i]);
+	}
+	gbuf_addf(&buf, "set vol_left %d\n", s->vol_left);
+	gbuf_addf(&buf, "set vol_right %d\n", s->vol_right);
+
+	s->text_len = buf.len;
+	s->text = gbuf_steal(&buf);
+}
+
+static void get_volume(int *left, int *right)
+{
+	if (soft_vol) {
+		*left = soft_vol_l;
+		*right = soft_vol_r;
+	} else if (!volume_max) {
+		*left = *right = -1;
+	} else {
+		*left = scale_to_percentage(volume_l, volume_max);
+		*right = scale_to_percentage(volume_r, volume_max);
+	}
+}
+
+static int str_equal(const char *a, const char *b)
+{
+	if (a == NULL || b == NULL)
+		return a == b;
+	return !strcmp(a, b);
+}
+
+/* called with update_mutex held, releases it */
+static void update_unlock(void)
+{
+	struct status_snapshot *s, *old;
+	int vol_left, vol_right;
+	int i;
+
+	old = current;
+	get_volume(&vol_left, &vol_right);
+
+	player_info_lock();
+	/* a scan can make the duration of the same track exact */
+	if (old && old->status == player_info.status && old->ti == player_info.ti &&
+			old->duration == (old->ti ? old->ti->duration : -1) &&
+			old->pos == player_info.pos &&
+			str_equal(old->metadata, player_info.metadata[0] ? player_info.metadata : NULL) &&
+			old->vol_left == vol_left && old->vol_right == vol_right) {
+		for (i = 0; i < NR_STATUS_OPTIONS; i++) {
+			if (strcmp(old->options[i], option_values[i]))
+				break;
+		}
+		if (i == NR_STATUS_OPTIONS) {
+			/* nothing changed */
+			player_info_unlock();
+			cmus_mutex_unlock(&update_mutex);
+			return;
+		}
+	}
+
+	s = xnew0(struct status_snapshot, 1);
+	s->ref = 1;
+	s->status = player_info.status;
+	s->pos = player_info.pos;
+	s->duration = -1;
+	s->ti = player_info.ti;
+	if (s->ti) {
+		track_info_ref(s->ti);
+		s->duration = s->ti->duration;
+		s->artist = keyvals_get_val(s->ti->comments, "artist");
+		s->album = keyvals_get_val(s->ti->comments, "album");
+		s->title = keyvals_get_val(s->ti->comments, "title");
+		s->date = keyvals_get_val(s->ti->comments, "date");
+		s->discnumber = keyvals_get_val(s->ti->comments, "discnumber");
+		s->tracknumber = keyvals_get_val(s->ti->comments, "tracknumber");
+	}
+	if (player_info.metadata[0]) {
+		s->metadata = xstrdup(player_info.metadata);
+		s->stream_title = parse_stream_title(s->metadata);
+	}
+	player_info_unlock();
+
+	s->vol_left = vol_left;
+	s->vol_right = vol_right;
+	for (i = 0; i < NR_STATUS_OPTIONS; i++)
+		s->options[i] = xstrdup(option_values[i]);
+	format_text(s);
+	s->generation = old ? old->generation + 1 : 1;
+
+	cmus_mutex_lock(&ref_mutex);
+	current = s;
+	generation = s->generation;
+	cmus_mutex_unlock(&ref_mutex);
+	cmus_mutex_unlock(&update_mutex);
+
+	if (old)
+		status_put(old);
+}
+
+void status_update(void)
+{
+	cmus_mutex_lock(&update_mutex);
+	update_unlock();
+}
+
+void status_update_options(void)
+{
+	char values[NR_STATUS_OPTIONS][OPTION_MAX_SIZE];
+	int i;
+
+	for (i = 0; i < NR_STATUS_OPTIONS; i++) {
+		struct cmus_opt *opt = __option_find(status_option_names[i]);
+
+		values[i][0] = 0;
+		if (opt)
+			opt->get(opt->id, values[i]);
+	}
+
+	cmus_mutex_lock(&update_mutex);
+	memcpy(option_values, values, sizeof(values));
+	update_unlock();
+}
+
+struct status_snapshot *status_get(void)
+{
+	struct status_snapshot *s;
+
+	if (current == NULL)
+		status_update();
+
+	cmus_mutex_lock(&ref_mutex);
+	s = current;
+	__sync_add_and_fetch(&s->ref, 1);
+	cmus_mutex_unlock(&ref_mutex);
+	return s;
+}
+
+void status_put(struct status_snapshot *s)
+{
+	BUG_ON(s->ref < 1);
+	if (__sync_sub_and_fetch(&s->ref, 1) == 0)
+		snapshot_free(s);
+}
+
+unsigned int status_generation(void)
+{
+	return generation;
+}
+
+void status_exit(void)
+{
+	cmus_mutex_lock(&update_mutex);
+	if (current)
+		status_put(current);
+	current = NULL;
+	cmus_mutex_unlock(&update_mutex);
+}
@@ -0,0 +1,78 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _STATUS_H
+#define _STATUS_H
+
+#include "player.h"
+#include "track_info.h"
+
+#include <stddef.h>
+
+/* options exported to cmus-remote and subscribers */
+#define NR_STATUS_OPTIONS 11
+
+extern const char * const status_option_names[NR_STATUS_OPTIONS + 1];
+extern const char * const status_names[];
+
+/*
+ * Immutable copy of the player status.  A new one is built when something
+ * changes and replaces the current one, readers keep a reference to the
+ * one they got and never need player_info_lock().
+ */
+struct status_snapshot {
+	int ref;
+	/* increased every time the snapshot changes */
+	unsigned int generation;
+
+	enum player_status status;
+	/* referenced, NULL if nothing is loaded */
+	struct track_info *ti;
+	int pos;
+	/* -1 if unknown */
+	int duration;
+
+	/* tags of ti, NULL if missing */
+	const char *artist;
+	const char *album;
+	const char *title;
+	const char *date;
+	const char *discnumber;
+	const char *tracknumber;
+
+	/* raw stream metadata and StreamTitle parsed from it, NULL if none */
+	char *metadata;
+	char *stream_title;
+
+	int vol_left;
+	int vol_right;
+
+	/* values of status_option_names[] */
+	char *options[NR_STATUS_OPTIONS];
+
+	/* "status ...", "file ...", "tag ...", "set ..." lines for cmus-remote */
+	char *text;
+	size_t text_len;
+};
+
+/*
+ * Rebuilds the snapshot if player status or volume has changed.  Options
+ * are copied from the previous snapshot.  Can be called from any thread,
+ * cheap if nothing has changed.
+ */
+void status_update(void);
+
+/* same as status_update() but reads the options too, main thread only */
+void status_update_options(void);
+
+/* returns referenced snapshot, release with status_put() */
+struct status_snapshot *status_get(void);
+void status_put(struct status_snapshot *s);
+
+/* generation of the current snapshot, doesn't take a reference */
+unsigned int status_generation(void);
+
+void status_exit(void);
+
+#endif
@@ -0,0 +1,198 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "status_program.h"
+#include "spawn.h"
+#include "options.h"
+#include "gbuf.h"
+#include "ui_curses.h"
+#include "xmalloc.h"
+#include "utils.h"
+#include "debug.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <time.h>
+
+/* a program that keeps exiting isn't restarted more often than this */
+#define MIN_RESTART_INTERVAL 1
+
+/* how long (ms) a stopped program gets to exit before the next signal */
+#define STOP_GRACE_MS 200
+
+static pid_t pid = -1;
+static int fd = -1;
+static time_t start_time;
+
+/* event being written */
+static struct gbuf out = { gbuf_empty_buffer, 0, 0 };
+static size_t out_pos;
+
+/* newest event, sent again to a restarted program */
+static char *latest;
+static int latest_sent;
+
+static unsigned int nr_coalesced;
+
+static char *format_event(char **pairs)
+{
+	GBUF(buf);
+	int i;
+
+	for (i = 0; pairs[i] && pairs[i + 1]; i += 2) {
+		const char *val;
+
+		gbuf_add_str(&buf, pairs[i]);
+		gbuf_add_ch(&buf, ' ');
+		for (val = pairs[i + 1]; *val; val++) {
+			if (*val == '\\') {
+				gbuf_add_str(&buf, "\\\\");
+			} else if (*val == '\n') {
+				gbuf_add_str(&buf, "\\n");
+			} else {
+				gbuf_add_ch(&buf, *val);
+			}
+		}
+		gbuf_add_ch(&buf, '\n');
+	}
+	gbuf_add_ch(&buf, '\n');
+	return gbuf_steal(&buf);
+}
+
+/* returns 1 if the program exited (and was reaped) within @ms */
+static int wait_exit(int ms)
+{
+	while (1) {
+		if (waitpid(pid, NULL, WNOHANG) != 0)
+			return 1;
+		if (ms <= 0)
+			return 0;
+		ms_sleep(10);
+		ms -= 10;
+	}
+}
+
+void status_program_stop(void)
+{
+	if (pid == -1)
+		return;
+
+	/* closing stdin should be enough for a well-behaved program */
+	close(fd);
+	if (!wait_exit(STOP_GRACE_MS)) {
+		kill(pid, SIGTERM);
+		if (!wait_exit(STOP_GRACE_MS)) {
+			d_print("%s (pid %d) ignores SIGTERM, killing it\n",
+					status_display_program ? status_display_program : "",
+					(int)pid);
+			/* can't be ignored, doesn't block for long */
+			kill(pid, SIGKILL);
+			waitpid(pid, NULL, 0);
+		}
+	}
+	d_print("stopped %s (pid %d), %u events coalesced\n",
+			status_display_program ? status_display_program : "",
+			(int)pid, nr_coalesced);
+	pid = -1;
+	fd = -1;
+	gbuf_clear(&out);
+	out_pos = 0;
+	/* the next program gets the current status first */
+	latest_sent = 0;
+}
+
+static int start(void)
+{
+	char *argv[2];
+	time_t now = time(NULL);
+
+	if (now - start_time < MIN_RESTART_INTERVAL)
+		return -1;
+	start_time = now;
+
+	argv[0] = status_display_program;
+	argv[1] = NULL;
+	pid = spawn_coprocess(argv, &fd);
+	if (pid == -1) {
+		error_msg("couldn't run `%s': %s", status_display_program, strerror(errno));
+		return -1;
+	}
+	fcntl(fd, F_SETFL, O_NONBLOCK);
+	d_print("started %s (pid %d)\n", status_display_program, (int)pid);
+	return 0;
+}
+
+static int running(void)
+{
+	if (pid != -1 && waitpid(pid, NULL, WNOHANG) == pid) {
+		d_print("%s (pid %d) exited\n", status_display_program, (int)pid);
+		/* already reaped */
+		close(fd);
+		pid = -1;
+		fd = -1;
+		gbuf_clear(&out);
+		out_pos = 0;
+		latest_sent = 0;
+	}
+	return pid != -1;
+}
+
+void status_program_flush(void)
+{
+	if (!running())
+		return;
+
+	while (1) {
+		ssize_t rc;
+
+		if (out_pos == out.len) {
+			if (latest == NULL || latest_sent)
+				return;
+			gbuf_clear(&out);
+			gbuf_add_str(&out, latest);
+			out_pos = 0;
+			latest_sent = 1;
+		}
+
+		rc = write(fd, out.buffer + out_pos, out.len - out_pos);
+		if (rc == -1) {
+			if (errno == EINTR)
+				continue;
+			if (errno == EAGAIN)
+				return;
+			/* EPIPE, stdin closed.  restarted with the next event */
+			d_print("writing to %s: %s\n", status_display_program, strerror(errno));
+			status_program_stop();
+			return;
+		}
+		out_pos += rc;
+	}
+}
+
+void status_program_send(char **pairs)
+{
+	/* an event that was never started is replaced */
+	if (latest && !latest_sent)
+		nr_coalesced++;
+	free(latest);
+	latest = format_event(pairs);
+	latest_sent = 0;
+
+	if (!running() && start())
+		return;
+	status_program_flush();
+}
+
+int status_program_fd(void)
+{
+	if (pid == -1 || (out_pos == out.len && (latest == NULL || latest_sent)))
+		return -1;
+	return fd;
+}
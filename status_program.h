@@ -0,0 +1,35 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _STATUS_PROGRAM_H
+#define _STATUS_PROGRAM_H
+
+/*
+ * Persistent status_display_program.  The program is started once and
+ * reads events from stdin, one "KEY VALUE" line per argument pair it
+ * would otherwise get on the command line, each event ending with an
+ * empty line.  Backslashes and newlines in values are escaped as \\ and
+ * \n.
+ *
+ * Writes never block.  At most one event is being written and one is
+ * queued, a newer event replaces the queued one.
+ */
+
+/*
+ * queues an event and writes as much as possible
+ *
+ * @pairs  NULL terminated key, value, key, value... array
+ */
+void status_program_send(char **pairs);
+
+/* fd to wait for writability, -1 if nothing is queued */
+int status_program_fd(void);
+
+/* call when status_program_fd() is writable */
+void status_program_flush(void);
+
+/* stops the program, started again with the next event */
+void status_program_stop(void);
+
+#endif
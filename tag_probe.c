@@ -0,0 +1,130 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "tag_probe.h"
+#include "xmalloc.h"
+#include "debug.h"
+#include "job_stats.h"
+
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+
+volatile int tag_probe_size = 16 * 1024;
+
+static int pread_all(struct tag_probe *tp, char *buf, int count, off_t offset)
+{
+	int pos = 0;
+
+	tp->bytes_read += count;
+	while (pos < count) {
+		int rc = pread(tp->fd, buf + pos, count - pos, offset + pos);
+
+		if (rc == -1) {
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return -1;
+		}
+		if (rc == 0) {
+			/* file shrunk */
+			errno = EIO;
+			return -1;
+		}
+		pos += rc;
+	}
+	return 0;
+}
+
+int tag_probe_init(struct tag_probe *tp, int fd)
+{
+	struct stat st;
+	/* the option can be changed by the main thread at any time */
+	int size = tag_probe_size;
+
+	tp->fd = fd;
+	tp->size = 0;
+	tp->head = NULL;
+	tp->head_size = 0;
+	tp->tail = NULL;
+	tp->tail_size = 0;
+	tp->bytes_read = 0;
+
+	if (fstat(fd, &st))
+		return -1;
+	if (!S_ISREG(st.st_mode)) {
+		errno = EINVAL;
+		return -1;
+	}
+	tp->size = st.st_size;
+
+	if (tp->size <= size) {
+		/* whole file fits in one block */
+		size = tp->size;
+		tp->head = xnew(char, size ? size : 1);
+		if (pread_all(tp, tp->head, size, 0))
+			goto error;
+		tp->head_size = size;
+		tp->tail = tp->head;
+		tp->tail_size = size;
+		return 0;
+	}
+
+	tp->head = xnew(char, size);
+	if (pread_all(tp, tp->head, size, 0))
+		goto error;
+	tp->head_size = size;
+
+	tp->tail = xnew(char, size);
+	if (pread_all(tp, tp->tail, size, tp->size - size))
+		goto error;
+	tp->tail_size = size;
+	return 0;
+error:
+	tag_probe_free(tp);
+	return -1;
+}
+
+void tag_probe_free(struct tag_probe *tp)
+{
+	job_stats_bytes(tp->bytes_read);
+	if (tp->tail != tp->head)
+		free(tp->tail);
+	free(tp->head);
+	tp->head = NULL;
+	tp->tail = NULL;
+	tp->head_size = 0;
+	tp->tail_size = 0;
+}
+
+const char *tag_probe_peek(struct tag_probe *tp, off_t offset, int count)
+{
+	off_t tail_start = tp->size - tp->tail_size;
+
+	if (offset < 0 || count < 0 || offset + count > tp->size)
+		return NULL;
+	if (offset + count <= tp->head_size)
+		return tp->head + offset;
+	if (offset >= tail_start)
+		return tp->tail + (offset - tail_start);
+	return NULL;
+}
+
+int tag_probe_read(struct tag_probe *tp, off_t offset, char *buf, int count)
+{
+	const char *ptr;
+
+	if (offset < 0 || count < 0 || offset + count > tp->size) {
+		errno = EINVAL;
+		return -1;
+	}
+
+	ptr = tag_probe_peek(tp, offset, count);
+	if (ptr) {
+		memcpy(buf, ptr, count);
+		return 0;
+	}
+	d_print("reading %d bytes at %lld\n", count, (long long)offset);
+	return pread_all(tp, buf, count, offset);
+}
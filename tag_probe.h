@@ -0,0 +1,47 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _TAG_PROBE_H
+#define _TAG_PROBE_H
+
+#include <sys/types.h>
+
+/*
+ * Reads the beginning and the end of a file once so that all tag parsers
+ * (ID3v1, ID3v2 header and footer, APE) can be served from memory.
+ * Anything outside of these buffers is read with pread().
+ */
+struct tag_probe {
+	int fd;
+	off_t size;
+
+	/* first head_size bytes of the file */
+	char *head;
+	int head_size;
+
+	/* last tail_size bytes of the file, may point to head */
+	char *tail;
+	int tail_size;
+
+	/* total bytes read from the file, for debugging */
+	off_t bytes_read;
+};
+
+/* size of the head and tail blocks in bytes, set by the main thread */
+extern volatile int tag_probe_size;
+
+/*
+ * returns 0 on success, -1 on error (errno set).  tags are read from
+ * both ends of the file, anything but a regular file fails with EINVAL
+ */
+int tag_probe_init(struct tag_probe *tp, int fd);
+void tag_probe_free(struct tag_probe *tp);
+
+/* returns pointer to @count bytes at @offset if they are buffered, otherwise NULL */
+const char *tag_probe_peek(struct tag_probe *tp, off_t offset, int count);
+
+/* reads exactly @count bytes at @offset, returns 0 on success or -1 on error */
+int tag_probe_read(struct tag_probe *tp, off_t offset, char *buf, int count);
+
+#endif
@@ -0,0 +1,139 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "ti_hash.h"
+#include "xmalloc.h"
+
+#include <string.h>
+
+#define TI_HASH_MIN_SIZE 1024
+
+/* this is from glib */
+unsigned int ti_hash_filename(const char *filename)
+{
+	unsigned int hash = 0;
+	int i;
+
+	for (i = 0; filename[i]; i++)
+		hash = (hash << 5) - hash + filename[i];
+	return hash;
+}
+
+/* the low bits of the string hash are weak, take the high bits of a product */
+static inline unsigned int home_slot(const struct ti_hash *h, unsigned int hash)
+{
+	return (hash * 0x9e3779b1U) >> h->shift;
+}
+
+static void resize(struct ti_hash *h, unsigned int size)
+{
+	struct track_info **old = h->slots;
+	unsigned int i, old_size = h->size;
+
+	h->slots = xnew0(struct track_info *, size);
+	h->size = size;
+	h->shift = 32;
+	while (size > 1) {
+		h->shift--;
+		size >>= 1;
+	}
+
+	for (i = 0; i < old_size; i++) {
+		struct track_info *ti = old[i];
+		unsigned int pos;
+
+		if (ti == NULL)
+			continue;
+		pos = home_slot(h, ti->hash);
+		while (h->slots[pos])
+			pos = (pos + 1) & (h->size - 1);
+		h->slots[pos] = ti;
+	}
+	free(old);
+}
+
+struct track_info *ti_hash_lookup(const struct ti_hash *h, const char *filename, unsigned int hash)
+{
+	unsigned int pos;
+
+	if (h->count == 0)
+		return NULL;
+
+	pos = home_slot(h, hash);
+	while (h->slots[pos]) {
+		struct track_info *ti = h->slots[pos];
+
+		if (ti->hash == hash && !strcmp(ti->filename, filename))
+			return ti;
+		pos = (pos + 1) & (h->size - 1);
+	}
+	return NULL;
+}
+
+int ti_hash_insert(struct ti_hash *h, struct track_info *ti)
+{
+	unsigned int pos;
+
+	/* keep load factor at most 1/2, probe sequences stay short */
+	if ((h->count + 1) * 2 > h->size)
+		resize(h, h->size ? h->size * 2 : TI_HASH_MIN_SIZE);
+
+	pos = home_slot(h, ti->hash);
+	while (h->slots[pos]) {
+		struct track_info *t = h->slots[pos];
+
+		if (t->hash == ti->hash && !strcmp(t->filename, ti->filename))
+			return 0;
+		pos = (pos + 1) & (h->size - 1);
+	}
+	h->slots[pos] = ti;
+	h->count++;
+	return 1;
+}
+
+int ti_hash_remove(struct ti_hash *h, struct track_info *ti)
+{
+	unsigned int mask = h->size - 1;
+	unsigned int pos, next;
+
+	if (h->count == 0)
+		return 0;
+
+	pos = home_slot(h, ti->hash);
+	while (h->slots[pos] != ti) {
+		if (h->slots[pos] == NULL)
+			return 0;
+		pos = (pos + 1) & mask;
+	}
+
+	/* move back later entries whose probe sequence crosses the hole */
+	next = pos;
+	while (1) {
+		unsigned int home;
+
+		next = (next + 1) & mask;
+		if (h->slots[next] == NULL)
+			break;
+		home = home_slot(h, h->slots[next]->hash);
+		if (((next - home) & mask) >= ((next - pos) & mask)) {
+			h->slots[pos] = h->slots[next];
+			pos = next;
+		}
+	}
+	h->slots[pos] = NULL;
+	h->count--;
+
+	if (h->size > TI_HASH_MIN_SIZE && h->count * 8 < h->size)
+		resize(h, h->size / 2);
+	return 1;
+}
+
+void ti_hash_free(struct ti_hash *h)
+{
+	free(h->slots);
+	h->slots = NULL;
+	h->size = 0;
+	h->count = 0;
+	h->shift = 0;
+}
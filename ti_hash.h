@@ -0,0 +1,43 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _TI_HASH_H
+#define _TI_HASH_H
+
+#include "track_info.h"
+
+/*
+ * Growable track_info hash table keyed on filename.  Uses the hash cached
+ * in track_info, so filenames are hashed once when the track_info is
+ * created and compared only when the full hashes match.
+ *
+ * Open addressing with linear probing.  The table doesn't ref the tracks
+ * and isn't locked, that's up to the owner (cache.c, lib.c).
+ */
+struct ti_hash {
+	/* NULL if empty, can be walked directly */
+	struct track_info **slots;
+	unsigned int size;
+	unsigned int count;
+	/* 32 - log2(size) */
+	unsigned int shift;
+};
+
+#define TI_HASH(name) struct ti_hash name = { NULL, 0, 0, 0 }
+
+unsigned int ti_hash_filename(const char *filename);
+
+/* @hash  ti_hash_filename(@filename) */
+struct track_info *ti_hash_lookup(const struct ti_hash *h, const char *filename, unsigned int hash);
+
+/* returns 0 and doesn't insert if a track with the same filename exists */
+int ti_hash_insert(struct ti_hash *h, struct track_info *ti);
+
+/* returns 0 if @ti isn't in the table */
+int ti_hash_remove(struct ti_hash *h, struct track_info *ti);
+
+/* frees the table, not the tracks */
+void ti_hash_free(struct ti_hash *h);
+
+#endif
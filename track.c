@@ -10,6 +10,7 @@
 #include "options.h"
 #include "comment.h"
 #include "uchar.h"
+#include "slab.h"
 #include "xmalloc.h"
 
 #include <string.h>
@@ -20,15 +21,22 @@ void simple_track_init(struct simple_track *track, struct track_info *ti)
 	track->marked = 0;
 }
 
+static SLAB(simple_track_slab, struct simple_track);
+
 struct simple_track *simple_track_new(struct track_info *ti)
 {
-	struct simple_track *t = xnew(struct simple_track, 1);
+	struct simple_track *t = slab_alloc(&simple_track_slab);
 
 	track_info_ref(ti);
 	simple_track_init(t, ti);
 	return t;
 }
 
+void simple_track_free(struct simple_track *track)
+{
+	slab_free(&simple_track_slab, track);
+}
+
 GENERIC_ITER_PREV(simple_track_get_prev, struct simple_track, node)
 GENERIC_ITER_NEXT(simple_track_get_next, struct simple_track, node)
 
@@ -197,24 +205,31 @@ void list_add_rand(struct list_head *head, struct list_head *node, int nr)
 
 void reshuffle(struct list_head *head)
 {
-	struct list_head *item, *last;
-	int i = 0;
+	struct list_head **items, *item;
+	int i, nr = 0;
 
-	if (list_empty(head))
+	list_for_each(item, head)
+		nr++;
+	if (nr == 0)
 		return;
 
-	last = head->prev;
-	item = head->next;
-	list_init(head);
-
-	while (1) {
-		struct list_head *next = item->next;
-
-		list_add_rand(head, item, i++);
-		if (item == last)
-			break;
-		item = next;
+	/* list_add_rand() for each item would be quadratic */
+	items = xnew(struct list_head *, nr);
+	i = 0;
+	list_for_each(item, head)
+		items[i++] = item;
+	for (i = nr - 1; i > 0; i--) {
+		int j = rand() % (i + 1);
+
+		item = items[i];
+		items[i] = items[j];
+		items[j] = item;
 	}
+
+	list_init(head);
+	for (i = 0; i < nr; i++)
+		list_add_tail(items[i], head);
+	free(items);
 }
 
 int simple_list_for_each_marked(struct list_head *head,
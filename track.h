@@ -11,6 +11,8 @@
 struct simple_track {
 	struct list_head node;
 	struct track_info *info;
+	/* info->duration when added to editable total_time */
+	int duration;
 	unsigned int marked : 1;
 };
 
@@ -45,6 +47,9 @@ void simple_track_init(struct simple_track *track, struct track_info *ti);
 /* refs ti */
 struct simple_track *simple_track_new(struct track_info *ti);
 
+/* frees a track from simple_track_new(), does not unref ti */
+void simple_track_free(struct simple_track *track);
+
 int simple_track_get_prev(struct iter *);
 int simple_track_get_next(struct iter *);
 
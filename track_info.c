@@ -18,6 +18,7 @@
  */
 
 #include "track_info.h"
+#include "ti_hash.h"
 #include "comment.h"
 #include "uchar.h"
 #include "misc.h"
@@ -29,41 +30,103 @@
 
 static void track_info_free(struct track_info *ti)
 {
-	keyvals_free(ti->comments);
+	free(ti->seek_idx);
 	free(ti);
 }
 
-struct track_info *track_info_new(const char *filename)
+/* @nr comments, @str_size bytes for filename, keys and values */
+static struct track_info *track_info_alloc(int nr, int str_size)
 {
 	struct track_info *ti;
-	int size = strlen(filename) + 1;
 
-	ti = xmalloc(sizeof(struct track_info) + size);
-	memcpy(ti->filename, filename, size);
+	ti = xmalloc(sizeof(struct track_info) + (nr + 1) * sizeof(struct keyval) + str_size);
+	ti->comments = (struct keyval *)(ti + 1);
+	ti->comments[nr].key = NULL;
+	ti->comments[nr].val = NULL;
+	ti->filename = (char *)(ti->comments + nr + 1);
 	ti->ref = 1;
+	ti->seek_idx = NULL;
+	ti->seek_idx_size = 0;
+	ti->duration_estimated = 0;
+	return ti;
+}
+
+static char *copy_str(char *dst, const char *src)
+{
+	int size = strlen(src) + 1;
+
+	memcpy(dst, src, size);
+	return dst + size;
+}
+
+struct track_info *track_info_new(const char *filename, const struct keyval *comments)
+{
+	static const struct keyval empty = { NULL, NULL };
+	struct track_info *ti;
+	int nr, str_size = strlen(filename) + 1;
+	char *s;
+
+	if (comments == NULL)
+		comments = &empty;
+	for (nr = 0; comments[nr].key; nr++)
+		str_size += strlen(comments[nr].key) + strlen(comments[nr].val) + 2;
+
+	ti = track_info_alloc(nr, str_size);
+	s = copy_str(ti->filename, filename);
+	ti->hash = ti_hash_filename(ti->filename);
+	for (nr = 0; comments[nr].key; nr++) {
+		ti->comments[nr].key = s;
+		s = copy_str(s, comments[nr].key);
+		ti->comments[nr].val = s;
+		s = copy_str(s, comments[nr].val);
+	}
+	return ti;
+}
+
+struct track_info *track_info_new_strings(const char *strings, int size)
+{
+	struct track_info *ti;
+	char *s;
+	int i, nr = 0;
+
+	for (i = 0; i < size; i++) {
+		if (!strings[i])
+			nr++;
+	}
+	nr = (nr - 1) / 2;
+
+	ti = track_info_alloc(nr, size);
+	memcpy(ti->filename, strings, size);
+	ti->hash = ti_hash_filename(ti->filename);
+	s = ti->filename + strlen(ti->filename) + 1;
+	for (i = 0; i < nr; i++) {
+		ti->comments[i].key = s;
+		s += strlen(s) + 1;
+		ti->comments[i].val = s;
+		s += strlen(s) + 1;
+	}
 	return ti;
 }
 
 struct track_info *track_info_url_new(const char *url)
 {
-	struct track_info *ti = track_info_new(url);
-	ti->comments = xnew0(struct keyval, 1);
+	struct track_info *ti = track_info_new(url, NULL);
 	ti->duration = -1;
 	ti->mtime = -1;
 	return ti;
 }
 
+/* atomic, status snapshots drop their references without any lock */
 void track_info_ref(struct track_info *ti)
 {
 	BUG_ON(ti->ref < 1);
-	ti->ref++;
+	__sync_add_and_fetch(&ti->ref, 1);
 }
 
 void track_info_unref(struct track_info *ti)
 {
 	BUG_ON(ti->ref < 1);
-	ti->ref--;
-	if (ti->ref == 0)
+	if (__sync_sub_and_fetch(&ti->ref, 1) == 0)
 		track_info_free(ti);
 }
 
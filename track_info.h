@@ -22,24 +22,46 @@
 
 #include <time.h>
 
+/*
+ * The header, comments array and all strings (filename, keys and values)
+ * are allocated as one block.  Don't free or replace comments.
+ */
 struct track_info {
 	struct keyval *comments;
+	char *filename;
+
+	/* ti_hash_filename(filename), see ti_hash.h */
+	unsigned int hash;
 
-	// next track_info in the hash table (cache.c)
-	struct track_info *next;
+	/* opaque seek index from a full scan, see ip_set_seek_idx() */
+	char *seek_idx;
+	int seek_idx_size;
 
 	time_t mtime;
 	int duration;
 	int ref;
-	char filename[0];
+	/* duration is a guess, exact scan pending */
+	unsigned int duration_estimated : 1;
 };
 
 #define TI_MATCH_ARTIST	(1 << 0)
 #define TI_MATCH_ALBUM	(1 << 1)
 #define TI_MATCH_TITLE	(1 << 2)
 
-/* initializes only filename and ref */
-extern struct track_info *track_info_new(const char *filename);
+/*
+ * initializes only filename, comments, ref and seek index
+ *
+ * @comments  copied, can be NULL
+ */
+extern struct track_info *track_info_new(const char *filename, const struct keyval *comments);
+
+/*
+ * same as track_info_new() but takes the cache entry string layout
+ *
+ * @strings  filename followed by keys and values, all NUL terminated
+ * @size     size of @strings
+ */
+extern struct track_info *track_info_new_strings(const char *strings, int size);
 
 extern struct track_info *track_info_url_new(const char *url);
 
@@ -4,6 +4,7 @@
 
 #include "lib.h"
 #include "search_mode.h"
+#include "slab.h"
 #include "xmalloc.h"
 #include "comment.h"
 #include "utils.h"
@@ -325,16 +326,19 @@ static inline void tree_win_get_selected(struct artist **artist, struct album **
 	}
 }
 
+static SLAB(artist_slab, struct artist);
+static SLAB(album_slab, struct album);
+
 static void artist_free(struct artist *artist)
 {
 	free(artist->name);
-	free(artist);
+	slab_free(&artist_slab, artist);
 }
 
 static void album_free(struct album *album)
 {
 	free(album->name);
-	free(album);
+	slab_free(&album_slab, album);
 }
 
 void tree_init(void)
@@ -479,14 +483,20 @@ void tree_sort_artists(void)
 	window_changed(lib_tree_win);
 }
 
-static struct artist *add_artist(const char *name)
+static struct artist *new_artist(const char *name)
 {
 	struct artist *artist;
 
-	artist = xnew(struct artist, 1);
+	artist = slab_alloc(&artist_slab);
 	artist->name = xstrdup(name);
 	list_init(&artist->album_head);
 	artist->expanded = 0;
+	return artist;
+}
+
+static struct artist *add_artist(const char *name)
+{
+	struct artist *artist = new_artist(name);
 
 	insert_artist(artist);
 	return artist;
@@ -497,7 +507,7 @@ static struct album *artist_add_album(struct artist *artist, const char *name, i
 	struct list_head *item;
 	struct album *album;
 
-	album = xnew(struct album, 1);
+	album = slab_alloc(&album_slab);
 	album->name = xstrdup(name);
 	album->date = date;
 	list_init(&album->track_head);
@@ -543,6 +553,42 @@ static void album_add_track(struct album *album, struct tree_track *track)
 	list_add_tail(&track->node, item);
 }
 
+static void get_artist_and_album_name(const struct track_info *ti,
+		const char **artist_namep, const char **album_namep)
+{
+	const char *album_name, *artist_name;
+
+	if (is_url(ti->filename)) {
+		*artist_namep = "<Stream>";
+		*album_namep = "<Stream>";
+		return;
+	}
+
+	album_name = keyvals_get_val(ti->comments, "album");
+
+	artist_name = keyvals_get_val(ti->comments, "albumartistsort");
+	if (!artist_name)
+		artist_name= keyvals_get_val(ti->comments, "albumartist");
+	if (!artist_name)
+		artist_name= keyvals_get_val(ti->comments, "artistsort");
+	if (!artist_name) {
+		const char *compilation = keyvals_get_val(ti->comments, "compilation");
+		if (compilation && (!strcasecmp(compilation, "1") ||
+				    !strcasecmp(compilation, "yes")))
+			artist_name = "<Compilations>";
+	}
+	if (!artist_name)
+		artist_name = keyvals_get_val(ti->comments, "artist");
+
+	if (artist_name == NULL)
+		artist_name = "<No Name>";
+	if (album_name == NULL)
+		album_name = "<No Name>";
+
+	*artist_namep = artist_name;
+	*album_namep = album_name;
+}
+
 void tree_add_track(struct tree_track *track)
 {
 	const struct track_info *ti = tree_track_info(track);
@@ -551,32 +597,7 @@ void tree_add_track(struct tree_track *track)
 	struct album *album;
 	int date;
 
-	if (is_url(ti->filename)) {
-		artist_name = "<Stream>";
-		album_name = "<Stream>";
-	} else {
-		album_name = keyvals_get_val(ti->comments, "album");
-
-		artist_name = keyvals_get_val(ti->comments, "albumartistsort");
-		if (!artist_name)
-			artist_name= keyvals_get_val(ti->comments, "albumartist");
-		if (!artist_name)
-			artist_name= keyvals_get_val(ti->comments, "artistsort");
-		if (!artist_name) {
-			const char *compilation = keyvals_get_val(ti->comments, "compilation");
-			if (compilation && (!strcasecmp(compilation, "1") ||
-					    !strcasecmp(compilation, "yes")))
-				artist_name = "<Compilations>";
-		}
-		if (!artist_name)
-			artist_name = keyvals_get_val(ti->comments, "artist");
-
-		if (artist_name == NULL)
-			artist_name = "<No Name>";
-		if (album_name == NULL)
-			album_name = "<No Name>";
-
-	}
+	get_artist_and_album_name(ti, &artist_name, &album_name);
 
 	find_artist_and_album(artist_name, album_name, &artist, &album);
 	if (album) {
@@ -607,6 +628,62 @@ void tree_add_track(struct tree_track *track)
 	}
 }
 
+/* does artist @a sort after @b in the tree, like in insert_artist() */
+static int artist_name_after(const char *a, const char *b)
+{
+	if (fuzzy_artist_sort) {
+		a = artist_name_skip_the(a);
+		b = artist_name_skip_the(b);
+	}
+	return special_name_cmp(a, b) > 0;
+}
+
+void tree_append_track(struct tree_track *track)
+{
+	const struct track_info *ti = tree_track_info(track);
+	const char *album_name, *artist_name;
+	struct artist *artist;
+	struct album *album;
+	int date;
+
+	if (list_empty(&lib_artist_head)) {
+		tree_add_track(track);
+		return;
+	}
+
+	get_artist_and_album_name(ti, &artist_name, &album_name);
+	artist = to_artist(lib_artist_head.prev);
+	if (u_strcasecmp(artist->name, artist_name)) {
+		if (!artist_name_after(artist_name, artist->name)) {
+			tree_add_track(track);
+			return;
+		}
+		/* sorts last, no need to search */
+		artist = new_artist(artist_name);
+		list_add_tail(&artist->node, &lib_artist_head);
+		window_changed(lib_tree_win);
+	}
+
+	album = list_empty(&artist->album_head) ? NULL : to_album(artist->album_head.prev);
+	if (album == NULL || u_strcasecmp(album->name, album_name)) {
+		date = comments_get_date(ti->comments, "date");
+		if (album && (date < album->date || (date == album->date &&
+				special_name_cmp(album_name, album->name) <= 0))) {
+			tree_add_track(track);
+			return;
+		}
+		album = artist_add_album(artist, album_name, date);
+		if (artist->expanded)
+			window_changed(lib_tree_win);
+	}
+
+	/* order of tracks in an album is trusted */
+	track->album = album;
+	list_add_tail(&track->node, &album->track_head);
+	if (album_selected(album))
+		window_changed(lib_track_win);
+}
+
 static void remove_sel_artist(struct artist *artist)
 {
 	struct list_head *aitem, *ahead;
@@ -30,6 +30,7 @@
 #include "output.h"
 #include "utils.h"
 #include "lib.h"
+#include "lib_snapshot.h"
 #include "pl.h"
 #include "xmalloc.h"
 #include "xstrjoin.h"
@@ -44,6 +45,11 @@
 #include "debug.h"
 #include "help.h"
 #include "worker.h"
+#include "job.h"
+#include "job_stats.h"
+#include "status.h"
+#include "status_program.h"
+#include "index.h"
 #include "input.h"
 #include "dbus-server.h"
 
@@ -52,6 +58,7 @@
 #include <stdio.h>
 #include <errno.h>
 #include <sys/ioctl.h>
+#include <fcntl.h>
 #include <ctype.h>
 #include <dirent.h>
 #include <locale.h>
@@ -236,6 +243,7 @@ enum {
 	SF_CONTINUE,
 	SF_SHUFFLE,
 	SF_PLAYLISTMODE,
+	SF_JOBS,
 	NR_SFS
 };
 
@@ -252,6 +260,7 @@ static struct format_option status_fopts[NR_SFS + 1] = {
 	DEF_FO_STR('C'),
 	DEF_FO_STR('S'),
 	DEF_FO_STR('L'),
+	DEF_FO_STR('j'),
 	DEF_FO_END
 };
 
@@ -898,10 +907,16 @@ static void do_update_statusline(void)
 	static const char *cont_strs[] = { " ", "C" };
 	static const char *repeat_strs[] = { " ", "R" };
 	static const char *shuffle_strs[] = { " ", "S" };
+	struct status_snapshot *ss;
+	struct job_stats js;
 	int buffer_fill, vol, vol_left, vol_right;
-	int duration = -1;
+	int duration;
 	char *msg;
-	char format[80];
+	char format[96];
+	char jobs[64];
+
+	/* volume may have been changed by a command */
+	status_update_options();
 
 	editable_lock();
 	fopt_set_time(&status_fopts[SF_TOTAL], play_library ? lib_editable.total_time :
@@ -912,30 +927,35 @@ static void do_update_statusline(void)
 	fopt_set_str(&status_fopts[SF_SHUFFLE], shuffle_strs[shuffle]);
 	fopt_set_str(&status_fopts[SF_PLAYLISTMODE], aaa_mode_names[aaa_mode]);
 
-	player_info_lock();
-
-	if (player_info.ti)
-		duration = player_info.ti->duration;
+	job_stats_get(&js);
+	if (js.busy) {
+		int n = snprintf(jobs, sizeof(jobs), "adding: %u/%u %.0f/s",
+				js.batch_processed, js.batch_discovered, js.rate);
 
-	if (soft_vol) {
-		vol_left = soft_vol_l;
-		vol_right = soft_vol_r;
-		vol = (vol_left + vol_right + 1) / 2;
-	} else if (!volume_max) {
-		vol_left = vol_right = vol = -1;
-	} else {
-		vol_left = scale_to_percentage(volume_l, volume_max);
-		vol_right = scale_to_percentage(volume_r, volume_max);
-		vol = (vol_left + vol_right + 1) / 2;
+		if (js.eta >= 0)
+			snprintf(jobs + n, sizeof(jobs) - n, " eta %d:%02d", js.eta / 60, js.eta % 60);
+		fopt_set_str(&status_fopts[SF_JOBS], jobs);
 	}
+
+	/* buffer fill changes too often to be in the snapshot */
+	player_info_lock();
 	buffer_fill = scale_to_percentage(player_info.buffer_fill, player_info.buffer_size);
+	msg = player_info.error_msg;
+	player_info.error_msg = NULL;
+	player_info_unlock();
 
-	fopt_set_str(&status_fopts[SF_STATUS], status_strs[player_info.status]);
+	ss = status_get();
+	duration = ss->duration;
+	vol_left = ss->vol_left;
+	vol_right = ss->vol_right;
+	vol = vol_left < 0 ? -1 : (vol_left + vol_right + 1) / 2;
+
+	fopt_set_str(&status_fopts[SF_STATUS], status_strs[ss->status]);
 
 	if (show_remaining_time && duration != -1) {
-		fopt_set_time(&status_fopts[SF_POSITION], player_info.pos - duration, 0);
+		fopt_set_time(&status_fopts[SF_POSITION], ss->pos - duration, 0);
 	} else {
-		fopt_set_time(&status_fopts[SF_POSITION], player_info.pos, 0);
+		fopt_set_time(&status_fopts[SF_POSITION], ss->pos, 0);
 	}
 
 	fopt_set_time(&status_fopts[SF_DURATION], duration, 0);
@@ -956,8 +976,10 @@ static void do_update_statusline(void)
 			strcat(format, "vol: %v ");
 		}
 	}
-	if (player_info.ti && is_url(player_info.ti->filename))
+	if (ss->ti && is_url(ss->ti->filename))
 		strcat(format, "buf: %b ");
+	if (js.busy)
+		strcat(format, "%j ");
 	strcat(format, "%=");
 	if (player_repeat_current) {
 		strcat(format, "repeat current");
@@ -976,11 +998,7 @@ static void do_update_statusline(void)
 	}
 	strcat(format, " | %1C%1R%1S ");
 	format_print(print_buffer, COLS, format, status_fopts);
-
-	msg = player_info.error_msg;
-	player_info.error_msg = NULL;
-
-	player_info_unlock();
+	status_put(ss);
 
 	bkgdset(pairs[CURSED_STATUSLINE]);
 	dump_print_buffer(LINES - 2, 0);
@@ -1100,28 +1118,6 @@ static void do_update_commandline(void)
 	}
 }
 
-/* lock player_info! */
-static const char *get_stream_title(void)
-{
-	static char stream_title[255 * 16 + 1];
-	char *ptr, *title;
-
-	ptr = strstr(player_info.metadata, "StreamTitle='");
-	if (ptr == NULL)
-		return NULL;
-	ptr += 13;
-	title = ptr;
-	while (*ptr) {
-		if (*ptr == '\'' && *(ptr + 1) == ';') {
-			memcpy(stream_title, title, ptr - title);
-			stream_title[ptr - title] = 0;
-			return stream_title;
-		}
-		ptr++;
-	}
-	return NULL;
-}
-
 static void set_title(const char *title)
 {
 	if (!set_term_title)
@@ -1135,21 +1131,20 @@ static void set_title(const char *title)
 
 static void do_update_titleline(void)
 {
+	struct status_snapshot *ss = status_get();
+
 	bkgdset(pairs[CURSED_TITLELINE]);
-	player_info_lock();
-	if (player_info.ti) {
+	if (ss->ti) {
 		int i, use_alt_format = 0;
 		char *wtitle;
 
-		fill_track_fopts_track_info(player_info.ti);
-		if (is_url(player_info.ti->filename)) {
-			const char *title = get_stream_title();
-
-			if (title == NULL)
+		fill_track_fopts_track_info(ss->ti);
+		if (is_url(ss->ti->filename)) {
+			if (ss->stream_title == NULL)
 				use_alt_format = 1;
-			fopt_set_str(&track_fopts[TF_TITLE], title);
+			fopt_set_str(&track_fopts[TF_TITLE], ss->stream_title);
 		} else {
-			use_alt_format = !track_info_has_tag(player_info.ti);
+			use_alt_format = !track_info_has_tag(ss->ti);
 		}
 
 		if (use_alt_format) {
@@ -1188,7 +1183,7 @@ static void do_update_titleline(void)
 
 		set_title("cmus " VERSION);
 	}
-	player_info_unlock();
+	status_put(ss);
 }
 
 static int cmdline_cursor_column(void)
@@ -1258,6 +1253,9 @@ static void post_update(void)
 
 void update_titleline(void)
 {
+	if (!ui_initialized)
+		return;
+
 	curs_set(0);
 	do_update_titleline();
 	post_update();
@@ -1280,6 +1278,9 @@ void update_full(void)
 
 static void update_commandline(void)
 {
+	if (!ui_initialized)
+		return;
+
 	curs_set(0);
 	do_update_commandline();
 	post_update();
@@ -1341,6 +1342,10 @@ int yes_no_query(const char *format, ...)
 	vsnprintf(buffer, sizeof(buffer), format, ap);
 	va_end(ap);
 
+	/* nobody to ask in daemon mode */
+	if (!ui_initialized)
+		return 0;
+
 	move(LINES - 1, 0);
 	bkgdset(pairs[CURSED_INFO]);
 
@@ -1439,10 +1444,14 @@ void set_view(int view)
 		break;
 	case HELP_VIEW:
 		searchable = help_searchable;
-		update_help_window();
+		if (ui_initialized)
+			update_help_window();
 		break;
 	}
 
+	if (!ui_initialized)
+		return;
+
 	curs_set(0);
 	do_update_view(1);
 	post_update();
@@ -1516,62 +1525,63 @@ static void clear_error(void)
 
 static void spawn_status_program(void)
 {
-	static const char *status_strs[] = { "stopped", "playing", "paused" };
-	const char *stream_title = NULL;
+	struct status_snapshot *ss;
 	char *argv[32];
 	int i, status;
 
 	if (status_display_program == NULL || status_display_program[0] == 0)
 		return;
 
-	player_info_lock();
-	status = player_info.status;
-	if (status == 1)
-		stream_title = get_stream_title();
-
+	ss = status_get();
 	i = 0;
 	argv[i++] = xstrdup(status_display_program);
 
 	argv[i++] = xstrdup("status");
-	argv[i++] = xstrdup(status_strs[status]);
-	if (player_info.ti) {
-		static const char *keys[] = {
-			"artist", "album", "discnumber", "tracknumber", "title", "date", NULL
+	argv[i++] = xstrdup(status_names[ss->status]);
+	if (ss->ti) {
+		const char *tags[] = {
+			"artist", ss->artist,
+			"album", ss->album,
+			"discnumber", ss->discnumber,
+			"tracknumber", ss->tracknumber,
+			"title", ss->title,
+			"date", ss->date,
+			NULL
 		};
 		int j;
 
-		if (is_url(player_info.ti->filename)) {
+		if (is_url(ss->ti->filename)) {
 			argv[i++] = xstrdup("url");
-			argv[i++] = xstrdup(player_info.ti->filename);
-			if (stream_title) {
+			argv[i++] = xstrdup(ss->ti->filename);
+			if (ss->status == PLAYER_STATUS_PLAYING && ss->stream_title) {
 				argv[i++] = xstrdup("title");
-				argv[i++] = xstrdup(stream_title);
+				argv[i++] = xstrdup(ss->stream_title);
 			}
 		} else {
 			char buf[32];
 
 			argv[i++] = xstrdup("file");
-			argv[i++] = xstrdup(player_info.ti->filename);
-			for (j = 0; keys[j]; j++) {
-				const char *key = keys[j];
-				const char *val;
-
-				val = keyvals_get_val(player_info.ti->comments, key);
-				if (val) {
-					argv[i++] = xstrdup(key);
-					argv[i++] = xstrdup(val);
+			argv[i++] = xstrdup(ss->ti->filename);
+			for (j = 0; tags[j]; j += 2) {
+				if (tags[j + 1]) {
+					argv[i++] = xstrdup(tags[j]);
+					argv[i++] = xstrdup(tags[j + 1]);
 				}
 			}
-			snprintf(buf, sizeof(buf), "%d", player_info.ti->duration);
+			snprintf(buf, sizeof(buf), "%d", ss->duration);
 			argv[i++] = xstrdup("duration");
 			argv[i++] = xstrdup(buf);
 		}
 	}
 	argv[i++] = NULL;
-	player_info_unlock();
+	status_put(ss);
 
-	if (spawn(argv, &status) == -1)
+	if (status_display_persistent) {
+		/* same key value pairs, without the program name */
+		status_program_send(argv + 1);
+	} else if (spawn(argv, &status) == -1) {
 		error_msg("couldn't run `%s': %s", status_display_program, strerror(errno));
+	}
 	for (i = 0; argv[i]; i++)
 		free(argv[i]);
 }
@@ -1624,14 +1634,46 @@ static void resize_tree_view(int w, int h)
 	window_set_nr_rows(lib_track_win, h);
 }
 
+/* scanning for exact durations changed some tracks, fix total times */
+static void update_durations(void)
+{
+	if (!editable_durations_changed)
+		return;
+	editable_durations_changed = 0;
+	editable_update_durations(&lib_editable);
+	editable_update_durations(&pl_editable);
+	editable_update_durations(&pq_editable);
+}
+
+/* errors of add jobs are reported here, error_msg() isn't thread-safe */
+static void report_job_errors(void)
+{
+	char *msg = job_get_add_error();
+
+	if (msg) {
+		error_msg("%s", msg);
+		free(msg);
+	}
+}
+
 static void update(void)
 {
+	static int jobs_were_busy = 0;
+	int busy;
 	int needs_view_update = 0;
 	int needs_title_update = 0;
 	int needs_status_update = 0;
 	int needs_command_update = 0;
 	int needs_spawn = 0;
 
+	report_job_errors();
+
+	/* job progress, once more after the jobs have finished */
+	busy = job_stats_busy();
+	if (busy || jobs_were_busy)
+		needs_status_update = 1;
+	jobs_were_busy = busy;
+
 	if (needs_to_resize) {
 		int w, h;
 		int columns, lines;
@@ -1660,8 +1702,11 @@ static void update(void)
 		}
 	}
 
+	/* snapshot must be current before the flags are cleared */
+	status_update_options();
 	player_info_lock();
 	editable_lock();
+	update_durations();
 
 	needs_spawn = player_info.status_changed || player_info.file_changed ||
 		player_info.metadata_changed;
@@ -1809,17 +1854,17 @@ static void main_loop(void)
 {
 	int rc, fd_high;
 
-	fd_high = server_socket;
+	fd_high = server_fd;
 	while (cmus_running) {
-		fd_set set;
+		fd_set set, wset;
 		struct timeval tv;
+		int prog_fd;
 		int poll_mixer = 0;
 		int i, nr_fds = 0;
 		int fds[NR_MIXER_FDS];
-		struct list_head *item;
-		struct client *client;
 
 		update();
+		server_notify();
 
 		/* Timeout must be so small that screen updates seem instant.
 		 * Only affects changes done in other threads (worker, player).
@@ -1846,12 +1891,7 @@ static void main_loop(void)
 
 		FD_ZERO(&set);
 		FD_SET(0, &set);
-		FD_SET(server_socket, &set);
-		list_for_each_entry(client, &client_head, node) {
-			FD_SET(client->fd, &set);
-			if (client->fd > fd_high)
-				fd_high = client->fd;
-		}
+		FD_SET(server_fd, &set);
 		if (!soft_vol) {
 			nr_fds = mixer_get_fds(fds);
 			if (nr_fds == -OP_ERROR_NOT_SUPPORTED) {
@@ -1868,10 +1908,16 @@ static void main_loop(void)
 			}
 		}
 
+		/* persistent status program is behind */
+		FD_ZERO(&wset);
+		prog_fd = status_program_fd();
+		if (prog_fd != -1)
+			FD_SET(prog_fd, &wset);
+
 		if (tv.tv_usec) {
-			rc = select(fd_high + 1, &set, NULL, NULL, &tv);
+			rc = select(max(fd_high, prog_fd) + 1, &set, &wset, NULL, &tv);
 		} else {
-			rc = select(fd_high + 1, &set, NULL, NULL, NULL);
+			rc = select(max(fd_high, prog_fd) + 1, &set, &wset, NULL, NULL);
 		}
 		if (poll_mixer) {
 			int ol = volume_l;
@@ -1898,18 +1944,10 @@ static void main_loop(void)
 				update_statusline();
 			}
 		}
-		if (FD_ISSET(server_socket, &set))
-			server_accept();
-
-		// server_serve() can remove client from the list
-		item = client_head.next;
-		while (item != &client_head) {
-			struct list_head *next = item->next;
-			client = container_of(item, struct client, node);
-			if (FD_ISSET(client->fd, &set))
-				server_serve(client);
-			item = next;
-		}
+		if (FD_ISSET(server_fd, &set))
+			server_serve();
+		if (prog_fd != -1 && FD_ISSET(prog_fd, &wset))
+			status_program_flush();
 
 		if (FD_ISSET(0, &set)) {
 			if (using_utf8) {
@@ -1959,6 +1997,138 @@ static const struct player_callbacks player_callbacks = {
 	.get_next = get_next
 };
 
+/* daemon mode {{{ */
+
+static int daemon_mode = 0;
+/* written to wake up daemon_loop() */
+static int wakeup_pipe[2];
+
+/* called from the player threads and signal handlers */
+static void daemon_wakeup(void)
+{
+	char ch = 0;
+	int saved_errno = errno;
+
+	/* non-blocking, if the pipe is full a wakeup is pending anyway */
+	if (write(wakeup_pipe[1], &ch, 1) < 0)
+		d_print("write: %s\n", strerror(errno));
+	errno = saved_errno;
+}
+
+static const struct player_callbacks daemon_player_callbacks = {
+	.get_next = get_next,
+	.info_changed = daemon_wakeup
+};
+
+static void sig_quit(int sig)
+{
+	cmus_running = 0;
+	daemon_wakeup();
+}
+
+static void init_daemon(void)
+{
+	struct sigaction act;
+	int i;
+
+	if (pipe(wakeup_pipe))
+		die_errno("pipe");
+	for (i = 0; i < 2; i++) {
+		fcntl(wakeup_pipe[i], F_SETFL, O_NONBLOCK);
+		fcntl(wakeup_pipe[i], F_SETFD, FD_CLOEXEC);
+	}
+
+	sigemptyset(&act.sa_mask);
+	act.sa_flags = 0;
+	act.sa_handler = sig_quit;
+	sigaction(SIGINT, &act, NULL);
+	sigaction(SIGTERM, &act, NULL);
+	sigaction(SIGHUP, &act, NULL);
+
+	act.sa_handler = SIG_IGN;
+	sigaction(SIGPIPE, &act, NULL);
+}
+
+/* what update() does for the screen, but only the parts without one */
+static void daemon_update(void)
+{
+	int needs_spawn;
+	char *msg;
+
+	editable_lock();
+	update_durations();
+	editable_unlock();
+
+	status_update_options();
+	player_info_lock();
+	needs_spawn = player_info.status_changed || player_info.file_changed ||
+		player_info.metadata_changed;
+	player_info.status_changed = 0;
+	player_info.file_changed = 0;
+	player_info.metadata_changed = 0;
+	player_info.position_changed = 0;
+	msg = player_info.error_msg;
+	player_info.error_msg = NULL;
+	player_info_unlock();
+
+	if (msg) {
+		error_msg("%s", msg);
+		free(msg);
+	}
+	if (needs_spawn)
+		spawn_status_program();
+}
+
+/*
+ * sleeps until a client sends something or the player wakes us up,
+ * there is nothing to redraw
+ */
+static void daemon_loop(void)
+{
+	while (cmus_running) {
+		fd_set set, wset;
+		struct timeval tv;
+		int rc, timeout, prog_fd;
+
+		/* nothing wakes us up for these, shown after the next event */
+		report_job_errors();
+
+		FD_ZERO(&set);
+		FD_SET(server_fd, &set);
+		FD_SET(wakeup_pipe[0], &set);
+		FD_ZERO(&wset);
+		prog_fd = status_program_fd();
+		if (prog_fd != -1)
+			FD_SET(prog_fd, &wset);
+
+		/* wake up only for position updates wanted by subscribers */
+		timeout = server_notify_timeout();
+		tv.tv_sec = timeout / 1000;
+		tv.tv_usec = timeout % 1000 * 1000;
+		rc = select(max(max(server_fd, wakeup_pipe[0]), prog_fd) + 1, &set,
+				&wset, NULL, timeout < 0 ? NULL : &tv);
+		if (rc <= 0) {
+			server_notify();
+			continue;
+		}
+		if (prog_fd != -1 && FD_ISSET(prog_fd, &wset))
+			status_program_flush();
+
+		if (FD_ISSET(wakeup_pipe[0], &set)) {
+			char buf[64];
+
+			while (read(wakeup_pipe[0], buf, sizeof(buf)) > 0)
+				;
+			daemon_update();
+			server_notify();
+		}
+		if (FD_ISSET(server_fd, &set))
+			server_serve();
+	}
+}
+
+/* }}} */
+
 static void init_curses(void)
 {
 	struct sigaction act;
@@ -2048,7 +2218,7 @@ static void init_all(void)
 	server_init(server_address);
 
 	/* does not select output plugin */
-	player_init(&player_callbacks);
+	player_init(daemon_mode ? &daemon_player_callbacks : &player_callbacks);
 
 	/* plugins have been loaded so we know what plugin options are available */
 	options_add();
@@ -2077,9 +2247,15 @@ static void init_all(void)
 	pl_filename = xstrdup(pl_autosave_filename);
 	lib_filename = xstrdup(lib_autosave_filename);
 
-	cmus_add(lib_add_track, lib_autosave_filename, FILE_TYPE_PL, JOB_TYPE_LIB);
+	cmus_load_lib(lib_autosave_filename);
 	cmus_add(pl_add_track, pl_autosave_filename, FILE_TYPE_PL, JOB_TYPE_PL);
 
+	if (daemon_mode) {
+		help_add_all_unbound();
+		init_daemon();
+		return;
+	}
+
 	if (error_count) {
 		char buf[16];
 
@@ -2093,16 +2269,20 @@ static void init_all(void)
 
 static void exit_all(void)
 {
-	endwin();
+	if (!daemon_mode)
+		endwin();
 
 	options_exit();
 
 	server_exit();
 	cmus_exit();
-	cmus_save(lib_for_each, lib_autosave_filename);
-	cmus_save(pl_for_each, pl_autosave_filename);
+	if (cmus_save(lib_for_each, lib_ti_cmp, lib_autosave_filename) == 0)
+		lib_snapshot_save(lib_autosave_filename);
+	cmus_save(pl_for_each, NULL, pl_autosave_filename);
 
 	player_exit();
+	status_program_stop();
+	status_exit();
 	op_exit_plugins();
 	commands_exit();
 	search_mode_exit();
@@ -2115,6 +2295,9 @@ enum {
 	FLAG_LISTEN,
 	FLAG_PLUGINS,
 	FLAG_SHOW_CURSOR,
+	FLAG_DAEMON,
+	FLAG_INDEX,
+	FLAG_CACHE,
 	FLAG_HELP,
 	FLAG_VERSION,
 	NR_FLAGS
@@ -2124,6 +2307,9 @@ static struct option options[NR_FLAGS + 1] = {
 	{ 0, "listen", 1 },
 	{ 0, "plugins", 0 },
 	{ 0, "show-cursor", 0 },
+	{ 0, "daemon", 0 },
+	{ 0, "index", 0 },
+	{ 0, "cache", 1 },
 	{ 0, "help", 0 },
 	{ 0, "version", 0 },
 	{ 0, NULL, 0 }
@@ -2131,6 +2317,7 @@ static struct option options[NR_FLAGS + 1] = {
 
 static const char *usage =
 "Usage: %s [OPTION]...\n"
+"   or: %s --index [--cache FILE] DIR...\n"
 "Curses based music player.\n"
 "\n"
 "      --listen ADDR   listen on ADDR instead of ~/.cmus/socket\n"
@@ -2138,6 +2325,9 @@ static const char *usage =
 "                      WARNING: using TCP/IP is insecure!\n"
 "      --plugins       list available plugins and exit\n"
 "      --show-cursor   always visible cursor\n"
+"      --daemon        run without the user interface, use cmus-remote\n"
+"      --index         read tags of files in DIRs into the cache and exit\n"
+"      --cache FILE    cache file for --index instead of ~/.cmus/cache\n"
 "      --help          display this help and exit\n"
 "      --version       " VERSION "\n"
 "\n"
@@ -2147,6 +2337,8 @@ static const char *usage =
 int main(int argc, char *argv[])
 {
 	int list_plugins = 0;
+	int index_mode = 0;
+	char *cache_file = NULL;
 
 	program_name = argv[0];
 	argv++;
@@ -2160,7 +2352,7 @@ int main(int argc, char *argv[])
 
 		switch (idx) {
 		case FLAG_HELP:
-			printf(usage, program_name);
+			printf(usage, program_name, program_name);
 			return 0;
 		case FLAG_VERSION:
 			printf("cmus " VERSION "\nCopyright 2004-2006 Timo Hirvonen\n");
@@ -2174,9 +2366,23 @@ int main(int argc, char *argv[])
 		case FLAG_SHOW_CURSOR:
 			show_cursor = 1;
 			break;
+		case FLAG_DAEMON:
+			daemon_mode = 1;
+			break;
+		case FLAG_INDEX:
+			index_mode = 1;
+			break;
+		case FLAG_CACHE:
+			cache_file = arg;
+			break;
 		}
 	}
 
+	if (cache_file && !index_mode) {
+		warn("--cache can only be used with --index\n");
+		return 1;
+	}
+
 	setlocale(LC_CTYPE, "");
 #ifdef CODESET
 	charset = nl_langinfo(CODESET);
@@ -2195,6 +2401,8 @@ int main(int argc, char *argv[])
 	d_print("charset = '%s'\n", charset);
 
 	ip_load_plugins();
+	if (index_mode)
+		return index_main(argv, cache_file);
 	op_load_plugins();
 	if (list_plugins) {
 		ip_dump_plugins();
@@ -2202,7 +2410,11 @@ int main(int argc, char *argv[])
 		return 0;
 	}
 	init_all();
-	main_loop();
+	if (daemon_mode) {
+		daemon_loop();
+	} else {
+		main_loop();
+	}
 	exit_all();
 	return 0;
 }
@@ -31,7 +31,9 @@
 
 #include <errno.h>
 #include <string.h>
+#include <stdint.h>
 #include <sys/types.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 struct vorbis_private {
@@ -223,20 +225,16 @@ static int vorbis_seek(struct input_plugin_data *ip_data, double offset)
 	return 0;
 }
 
-static int vorbis_read_comments(struct input_plugin_data *ip_data,
-		struct keyval **comments)
+static struct keyval *get_comments(OggVorbis_File *vf)
 {
 	GROWING_KEYVALS(c);
-	struct vorbis_private *priv;
 	vorbis_comment *vc;
 	int i;
 
-	priv = ip_data->private;
-	vc = ov_comment(&priv->vf, -1);
+	vc = ov_comment(vf, -1);
 	if (vc == NULL) {
 		d_print("vc == NULL\n");
-		*comments = xnew0(struct keyval, 1);
-		return 0;
+		return xnew0(struct keyval, 1);
 	}
 	for (i = 0; i < vc->comments; i++) {
 		const char *str = vc->user_comments[i];
@@ -253,7 +251,16 @@ static int vorbis_read_comments(struct input_plugin_data *ip_data,
 		free(key);
 	}
 	keyvals_terminate(&c);
-	*comments = c.keyvals;
+	return c.keyvals;
+}
+
+static int vorbis_read_comments(struct input_plugin_data *ip_data,
+		struct keyval **comments)
+{
+	struct vorbis_private *priv;
+
+	priv = ip_data->private;
+	*comments = get_comments(&priv->vf);
 	return 0;
 }
 
@@ -272,13 +279,87 @@ static int vorbis_duration(struct input_plugin_data *ip_data)
 	return duration;
 }
 
+/*
+ * granule position (= total samples) of the last Ogg page
+ *
+ * the last page is at most 65307 bytes long
+ */
+static int64_t last_granulepos(int fd)
+{
+	unsigned char buf[65307];
+	off_t off;
+	int rc, i;
+
+	off = lseek(fd, 0, SEEK_END);
+	if (off == -1)
+		return -1;
+	if (off > sizeof(buf))
+		off -= sizeof(buf);
+	else
+		off = 0;
+	rc = pread(fd, buf, sizeof(buf), off);
+	if (rc < 27)
+		return -1;
+
+	for (i = rc - 27; i >= 0; i--) {
+		int64_t pos = 0;
+		int j;
+
+		if (memcmp(buf + i, "OggS", 4) || buf[i + 4] != 0)
+			continue;
+		for (j = 7; j >= 0; j--)
+			pos = (pos << 8) | buf[i + 6 + j];
+		if (pos >= 0)
+			return pos;
+	}
+	return -1;
+}
+
+/* reads only the identification and comment headers and the last page */
+static int vorbis_read_info(struct input_plugin_data *ip_data,
+		struct keyval **comments, int *duration)
+{
+	OggVorbis_File vf;
+	vorbis_info *vi;
+	int64_t samples;
+	int rc;
+
+	/* closed by ip_read_info() on error */
+	ip_data->fd = open(ip_data->filename, O_RDONLY);
+	if (ip_data->fd == -1)
+		return -IP_ERROR_ERRNO;
+
+	samples = last_granulepos(ip_data->fd);
+	if (samples < 0)
+		return -IP_ERROR_FUNCTION_NOT_SUPPORTED;
+	if (lseek(ip_data->fd, 0, SEEK_SET) == -1)
+		return -IP_ERROR_ERRNO;
+
+	memset(&vf, 0, sizeof(vf));
+	rc = ov_test_callbacks(ip_data, &vf, NULL, 0, callbacks);
+	if (rc != 0) {
+		d_print("ov_test failed: %d\n", rc);
+		return -IP_ERROR_FILE_FORMAT;
+	}
+
+	vi = ov_info(&vf, -1);
+	*duration = vi && vi->rate ? samples / vi->rate : -1;
+	*comments = get_comments(&vf);
+
+	/* this closes ip_data->fd! */
+	ov_clear(&vf);
+	ip_data->fd = -1;
+	return 0;
+}
+
 const struct input_plugin_ops ip_ops = {
 	.open = vorbis_open,
 	.close = vorbis_close,
 	.read = vorbis_read,
 	.seek = vorbis_seek,
 	.read_comments = vorbis_read_comments,
-	.duration = vorbis_duration
+	.duration = vorbis_duration,
+	.read_info = vorbis_read_info
 };
 
 const char * const ip_extensions[] = { "ogg", NULL };
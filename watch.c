@@ -0,0 +1,422 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#include "watch.h"
+#include "job.h"
+#include "worker.h"
+#include "locking.h"
+#include "xmalloc.h"
+#include "debug.h"
+
+#include <string.h>
+#include <errno.h>
+
+int watch_library = 0;
+
+#ifdef __linux__
+
+#include <sys/inotify.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <poll.h>
+
+#define WATCH_MASK (IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | \
+		IN_MOVED_TO | IN_MOVE_SELF | IN_DELETE_SELF | IN_ONLYDIR)
+
+/* flush events after this long without new ones */
+#define DEBOUNCE_MS 500
+/* ...but not later than this */
+#define MAX_DELAY_MS 5000
+/* or when there are this many */
+#define MAX_EVENTS 4096
+
+static pthread_mutex_t watch_mutex = CMUS_MUTEX_INITIALIZER;
+static pthread_t watch_thread;
+static int inotify_fd = -1;
+static int quit_pipe[2] = { -1, -1 };
+
+/* watched directories indexed by inotify watch descriptor */
+static char **wd_paths;
+static int wd_alloc;
+
+/* parent directory of the last watch_add_file() */
+static char *last_dir;
+
+/* only used by the watch thread */
+static struct watch_event *events;
+static int nr_events;
+static int alloc_events;
+
+#define watch_lock() cmus_mutex_lock(&watch_mutex)
+#define watch_unlock() cmus_mutex_unlock(&watch_mutex)
+
+static int path_within(const char *path, const char *dir)
+{
+	int len = strlen(dir);
+
+	if (strncmp(path, dir, len))
+		return 0;
+	return path[len] == '/' || !path[len];
+}
+
+static uint64_t now_ms(void)
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return (uint64_t)tv.tv_sec * 1000 + tv.tv_usec / 1000;
+}
+
+static void add_event(char *path, enum watch_event_type type)
+{
+	if (nr_events && events[nr_events - 1].type == type &&
+			!strcmp(events[nr_events - 1].path, path)) {
+		free(path);
+		return;
+	}
+	if (nr_events == alloc_events) {
+		alloc_events = alloc_events * 2 + 64;
+		events = xrenew(struct watch_event, events, alloc_events);
+	}
+	events[nr_events].path = path;
+	events[nr_events].type = type;
+	nr_events++;
+}
+
+/* longest common directory of @a and @b, modifies @a */
+static void common_dir(char *a, const char *b)
+{
+	int i, slash = 0;
+
+	for (i = 0; a[i] && a[i] == b[i]; i++) {
+		if (a[i] == '/')
+			slash = i;
+	}
+	if (!a[i] && (b[i] == '/' || !b[i]))
+		return;
+	a[slash ? slash : 1] = 0;
+}
+
+/*
+ * the kernel dropped events.  we can't know what changed, so rescan the
+ * smallest directory containing everything seen in this batch, or all
+ * watched directories if there is nothing to go by
+ */
+static void add_rescan(void)
+{
+	char *dir = NULL;
+	int i;
+
+	for (i = 0; i < nr_events; i++) {
+		if (dir) {
+			common_dir(dir, events[i].path);
+		} else {
+			dir = xstrdup(events[i].path);
+		}
+	}
+	if (dir == NULL) {
+		watch_lock();
+		for (i = 0; i < wd_alloc; i++) {
+			if (!wd_paths[i])
+				continue;
+			if (dir) {
+				common_dir(dir, wd_paths[i]);
+			} else {
+				dir = xstrdup(wd_paths[i]);
+			}
+		}
+		watch_unlock();
+	}
+	if (dir) {
+		d_print("inotify queue overflow, rescanning %s\n", dir);
+		add_event(dir, WATCH_RESCAN);
+	}
+}
+
+/* watch lock must be held */
+static void remove_wd(int wd)
+{
+	if (wd < wd_alloc && wd_paths[wd]) {
+		free(wd_paths[wd]);
+		wd_paths[wd] = NULL;
+	}
+}
+
+/* directory moved away, old watches would report wrong paths */
+static void remove_watches_within(const char *dir)
+{
+	int i;
+
+	watch_lock();
+	for (i = 0; i < wd_alloc; i++) {
+		if (wd_paths[i] && path_within(wd_paths[i], dir)) {
+			inotify_rm_watch(inotify_fd, i);
+			remove_wd(i);
+		}
+	}
+	watch_unlock();
+}
+
+static void flush_events(void)
+{
+	struct watch_data *data;
+
+	if (nr_events == 0)
+		return;
+
+	d_print("%d events\n", nr_events);
+	data = xnew(struct watch_data, 1);
+	data->events = events;
+	data->nr = nr_events;
+	worker_add_job(JOB_TYPE_LIB, do_watch_job, free_watch_job, data);
+
+	events = NULL;
+	nr_events = 0;
+	alloc_events = 0;
+}
+
+static void handle_event(const struct inotify_event *ev)
+{
+	char *path;
+	int len;
+
+	if (ev->mask & IN_Q_OVERFLOW) {
+		add_rescan();
+		return;
+	}
+	if (ev->mask & IN_IGNORED) {
+		watch_lock();
+		remove_wd(ev->wd);
+		watch_unlock();
+		return;
+	}
+	if (ev->len == 0 || ev->name[0] == '.')
+		return;
+
+	watch_lock();
+	if (ev->wd >= wd_alloc || !wd_paths[ev->wd]) {
+		watch_unlock();
+		return;
+	}
+	len = strlen(wd_paths[ev->wd]);
+	path = xnew(char, len + 1 + strlen(ev->name) + 1);
+	memcpy(path, wd_paths[ev->wd], len);
+	path[len] = '/';
+	strcpy(path + len + 1, ev->name);
+	watch_unlock();
+
+	if (ev->mask & IN_ISDIR) {
+		if (ev->mask & (IN_CREATE | IN_MOVED_TO)) {
+			add_event(path, WATCH_DIR_ADDED);
+		} else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+			remove_watches_within(path);
+			add_event(path, WATCH_GONE);
+		} else {
+			free(path);
+		}
+		return;
+	}
+
+	/* IN_CREATE is ignored for files, wait for IN_CLOSE_WRITE */
+	if (ev->mask & (IN_CLOSE_WRITE | IN_MOVED_TO)) {
+		add_event(path, WATCH_CHANGED);
+	} else if (ev->mask & (IN_DELETE | IN_MOVED_FROM)) {
+		add_event(path, WATCH_GONE);
+	} else {
+		free(path);
+	}
+}
+
+static void *watch_loop(void *arg)
+{
+	char buf[64 * 1024] __attribute__((aligned(__alignof__(struct inotify_event))));
+	uint64_t first = 0;
+
+	while (1) {
+		struct pollfd pfd[2];
+		int rc, pos;
+
+		pfd[0].fd = inotify_fd;
+		pfd[0].events = POLLIN;
+		pfd[1].fd = quit_pipe[0];
+		pfd[1].events = POLLIN;
+
+		rc = poll(pfd, 2, nr_events ? DEBOUNCE_MS : -1);
+		if (rc == -1) {
+			if (errno == EINTR)
+				continue;
+			d_print("poll: %s\n", strerror(errno));
+			break;
+		}
+		if (pfd[1].revents)
+			break;
+		if (rc == 0) {
+			flush_events();
+			continue;
+		}
+
+		rc = read(inotify_fd, buf, sizeof(buf));
+		if (rc <= 0) {
+			if (rc == -1 && (errno == EINTR || errno == EAGAIN))
+				continue;
+			d_print("read: %s\n", strerror(errno));
+			break;
+		}
+
+		if (nr_events == 0)
+			first = now_ms();
+		for (pos = 0; pos < rc; ) {
+			const struct inotify_event *ev = (const struct inotify_event *)(buf + pos);
+
+			handle_event(ev);
+			pos += sizeof(struct inotify_event) + ev->len;
+		}
+		if (nr_events >= MAX_EVENTS || (nr_events && now_ms() - first >= MAX_DELAY_MS))
+			flush_events();
+	}
+
+	flush_events();
+	return NULL;
+}
+
+void watch_enable(void)
+{
+	int fd, rc;
+
+	if (inotify_fd != -1)
+		return;
+
+	fd = inotify_init();
+	if (fd == -1) {
+		d_print("inotify_init: %s\n", strerror(errno));
+		return;
+	}
+	if (pipe(quit_pipe) == -1) {
+		d_print("pipe: %s\n", strerror(errno));
+		close(fd);
+		return;
+	}
+
+	watch_lock();
+	inotify_fd = fd;
+	watch_unlock();
+
+	rc = pthread_create(&watch_thread, NULL, watch_loop, NULL);
+	BUG_ON(rc);
+}
+
+void watch_disable(void)
+{
+	int i;
+
+	if (inotify_fd == -1)
+		return;
+
+	write(quit_pipe[1], "", 1);
+	pthread_join(watch_thread, NULL);
+	close(quit_pipe[0]);
+	close(quit_pipe[1]);
+
+	watch_lock();
+	/* closing the fd removes all watches */
+	close(inotify_fd);
+	inotify_fd = -1;
+	for (i = 0; i < wd_alloc; i++)
+		free(wd_paths[i]);
+	free(wd_paths);
+	wd_paths = NULL;
+	wd_alloc = 0;
+	free(last_dir);
+	last_dir = NULL;
+	watch_unlock();
+}
+
+void watch_exit(void)
+{
+	watch_disable();
+}
+
+/* watch lock must be held */
+static void __watch_add_dir(const char *dir)
+{
+	int wd;
+
+	wd = inotify_add_watch(inotify_fd, dir, WATCH_MASK);
+	if (wd == -1) {
+		/* ENOSPC: fs.inotify.max_user_watches reached */
+		d_print("inotify_add_watch %s: %s\n", dir, strerror(errno));
+		return;
+	}
+	if (wd >= wd_alloc) {
+		int i, alloc = wd * 2 + 64;
+
+		wd_paths = xrenew(char *, wd_paths, alloc);
+		for (i = wd_alloc; i < alloc; i++)
+			wd_paths[i] = NULL;
+		wd_alloc = alloc;
+	}
+	/* same directory can be added many times */
+	if (!wd_paths[wd] || strcmp(wd_paths[wd], dir)) {
+		free(wd_paths[wd]);
+		wd_paths[wd] = xstrdup(dir);
+	}
+}
+
+void watch_add_dir(const char *dir)
+{
+	watch_lock();
+	if (inotify_fd != -1)
+		__watch_add_dir(dir);
+	watch_unlock();
+}
+
+void watch_add_file(const char *filename)
+{
+	const char *slash = strrchr(filename, '/');
+	int len;
+
+	if (slash == NULL)
+		return;
+	len = slash - filename;
+	if (len == 0)
+		len = 1;
+
+	watch_lock();
+	if (inotify_fd == -1)
+		goto out;
+	/* files come in sorted order so this avoids most syscalls */
+	if (last_dir && !strncmp(last_dir, filename, len) && !last_dir[len])
+		goto out;
+
+	free(last_dir);
+	last_dir = xstrndup(filename, len);
+	__watch_add_dir(last_dir);
+out:
+	watch_unlock();
+}
+
+#else
+
+void watch_enable(void)
+{
+}
+
+void watch_disable(void)
+{
+}
+
+void watch_exit(void)
+{
+}
+
+void watch_add_dir(const char *dir)
+{
+}
+
+void watch_add_file(const char *filename)
+{
+}
+
+#endif
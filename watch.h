@@ -0,0 +1,41 @@
+/*
+ * Copyright 2010 Various Authors
+ */
+
+#ifndef _WATCH_H
+#define _WATCH_H
+
+enum watch_event_type {
+	/* file was written or moved in */
+	WATCH_CHANGED,
+	/* file or directory was deleted or moved away */
+	WATCH_GONE,
+	/* new directory, add it to the library */
+	WATCH_DIR_ADDED,
+	/* events were lost, check everything under path */
+	WATCH_RESCAN
+};
+
+struct watch_event {
+	char *path;
+	enum watch_event_type type;
+};
+
+/* data for do_watch_job() */
+struct watch_data {
+	struct watch_event *events;
+	int nr;
+};
+
+/* watch library directories for changes (inotify) */
+extern int watch_library;
+
+void watch_enable(void);
+void watch_disable(void);
+void watch_exit(void);
+
+/* call from the worker thread only */
+void watch_add_dir(const char *dir);
+void watch_add_file(const char *filename);
+
+#endif
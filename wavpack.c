@@ -242,24 +242,32 @@ static int wavpack_seek(struct input_plugin_data *ip_data, double offset)
 static int wavpack_read_comments(struct input_plugin_data *ip_data,
 		struct keyval **comments)
 {
+	struct tag_probe tp;
 	struct id3tag id3;
 	APETAG(ape);
 	GROWING_KEYVALS(c);
-	int fd, rc, save, i;
+	int fd, rc, i;
 
 	fd = open(ip_data->filename, O_RDONLY);
 	if (fd == -1)
 		return -1;
 	d_print("filename: %s\n", ip_data->filename);
 
+	/* one probe for both ID3 and APE tags */
+	if (tag_probe_init(&tp, fd)) {
+		d_print("error: %s\n", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
 	id3_init(&id3);
-	rc = id3_read_tags(&id3, fd, ID3_V1);
-	save = errno;
-	close(fd);
-	errno = save;
+	rc = id3_read_tags_probe(&id3, &tp, ID3_V1);
 	if (rc) {
 		if (rc == -1) {
 			d_print("error: %s\n", strerror(errno));
+			id3_free(&id3);
+			tag_probe_free(&tp);
+			close(fd);
 			return -1;
 		}
 		d_print("corrupted tag?\n");
@@ -275,7 +283,7 @@ static int wavpack_read_comments(struct input_plugin_data *ip_data,
 next:
 	id3_free(&id3);
 
-	rc = ape_read_tags(&ape, ip_data->fd, 1);
+	rc = ape_read_tags_probe(&ape, &tp, 1);
 	if (rc < 0)
 		goto out;
 
@@ -290,6 +298,8 @@ next:
 
 out:
 	ape_free(&ape);
+	tag_probe_free(&tp);
+	close(fd);
 
 	keyvals_terminate(&c);
 	*comments = c.keyvals;
@@ -5,6 +5,7 @@
 #include "debug.h"
 
 #include <stdlib.h>
+#include <string.h>
 #include <pthread.h>
 
 struct worker_job {
@@ -14,30 +15,79 @@ struct worker_job {
 	void (*job_cb)(void *data);
 	void (*free_cb)(void *data);
 	void *data;
+
+	/* order of worker_add_job() calls, older jobs first */
+	unsigned int seq;
+	/* set by worker_remove_jobs() while the job is running */
+	int cancel;
+};
+
+/*
+ * one queue per job type.  jobs of the same type run one at a time in the
+ * order they were added, jobs of different types can run in parallel.
+ */
+struct worker_queue {
+	struct list_head head;
+	/* job of this type being run, NULL if none */
+	struct worker_job *running;
+	int prio;
 };
 
-static LIST_HEAD(worker_job_head);
+static struct worker_queue queues[WORKER_MAX_TYPES];
 static pthread_mutex_t worker_mutex = CMUS_MUTEX_INITIALIZER;
 static pthread_cond_t worker_cond = PTHREAD_COND_INITIALIZER;
-static pthread_t worker_thread;
+/* signaled when a worker thread exits */
+static pthread_cond_t worker_exit_cond = PTHREAD_COND_INITIALIZER;
+static pthread_key_t cur_job_key;
+static unsigned int job_seq = 0;
+static int nr_threads = 0;
+static int initialized = 0;
 static int running = 1;
-static int cancel_type = JOB_TYPE_NONE;
 
-/*
- * - only worker thread modifies this
- * - cur_job->job_cb can read this without locking
- * - anyone else must lock worker before reading this
- */
-static struct worker_job *cur_job = NULL;
+int worker_threads = 2;
 
 #define worker_lock() cmus_mutex_lock(&worker_mutex)
 #define worker_unlock() cmus_mutex_unlock(&worker_mutex)
 
+static int type_matches(int type, int job_type)
+{
+	return type == JOB_TYPE_ANY || type == job_type;
+}
+
+/* oldest job of the highest priority type that isn't already running */
+static struct worker_job *get_next_job(void)
+{
+	struct worker_job *best = NULL;
+	int i, best_prio = 0;
+
+	for (i = 1; i < WORKER_MAX_TYPES; i++) {
+		struct worker_queue *q = &queues[i];
+		struct worker_job *job;
+
+		if (q->running || list_empty(&q->head))
+			continue;
+		job = container_of(q->head.next, struct worker_job, node);
+		if (best == NULL || q->prio > best_prio ||
+				(q->prio == best_prio && job->seq < best->seq)) {
+			best = job;
+			best_prio = q->prio;
+		}
+	}
+	return best;
+}
+
 static void *worker_loop(void *arg)
 {
 	worker_lock();
 	while (1) {
-		if (list_empty(&worker_job_head)) {
+		struct worker_job *job;
+
+		/* worker_threads was decreased */
+		if (nr_threads > worker_threads)
+			break;
+
+		job = get_next_job();
+		if (job == NULL) {
 			int rc;
 
 			if (!running)
@@ -47,46 +97,103 @@ static void *worker_loop(void *arg)
 			if (rc)
 				d_print("pthread_cond_wait: %s\n", strerror(rc));
 		} else {
-			struct list_head *item = worker_job_head.next;
+			struct worker_queue *q = &queues[job->type];
 			uint64_t t;
 
-			list_del(item);
-			cur_job = container_of(item, struct worker_job, node);
+			list_del(&job->node);
+			q->running = job;
 			worker_unlock();
 
+			pthread_setspecific(cur_job_key, job);
 			t = timer_get();
-			cur_job->job_cb(cur_job->data);
+			job->job_cb(job->data);
 			timer_print("worker job", timer_get() - t);
+			pthread_setspecific(cur_job_key, NULL);
 
 			worker_lock();
-			cur_job->free_cb(cur_job->data);
-			free(cur_job);
-			cur_job = NULL;
+			job->free_cb(job->data);
+			free(job);
+			q->running = NULL;
 
-			// wakeup worker_remove_jobs() if needed
-			if (cancel_type != JOB_TYPE_NONE)
-				pthread_cond_signal(&worker_cond);
+			/* next job of this type can be run now */
+			if (!list_empty(&q->head))
+				pthread_cond_broadcast(&worker_cond);
 		}
 	}
+	nr_threads--;
+	pthread_cond_signal(&worker_exit_cond);
 	worker_unlock();
 	return NULL;
 }
 
+/* worker must be locked */
+static void start_threads(void)
+{
+	pthread_attr_t attr;
+
+	pthread_attr_init(&attr);
+	pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+	while (nr_threads < worker_threads) {
+		pthread_t thread;
+		int rc = pthread_create(&thread, &attr, worker_loop, NULL);
+
+		if (rc) {
+			d_print("pthread_create: %s\n", strerror(rc));
+			break;
+		}
+		nr_threads++;
+	}
+	pthread_attr_destroy(&attr);
+}
+
 void worker_init(void)
 {
-	int rc = pthread_create(&worker_thread, NULL, worker_loop, NULL);
+	int i, rc;
 
+	rc = pthread_key_create(&cur_job_key, NULL);
 	BUG_ON(rc);
+
+	worker_lock();
+	for (i = 0; i < WORKER_MAX_TYPES; i++) {
+		list_init(&queues[i].head);
+		queues[i].running = NULL;
+		queues[i].prio = WORKER_PRIO_NORMAL;
+	}
+	initialized = 1;
+	start_threads();
+	BUG_ON(nr_threads == 0);
+	worker_unlock();
 }
 
 void worker_exit(void)
 {
 	worker_lock();
 	running = 0;
-	pthread_cond_signal(&worker_cond);
+	pthread_cond_broadcast(&worker_cond);
+	while (nr_threads > 0)
+		pthread_cond_wait(&worker_exit_cond, &worker_mutex);
 	worker_unlock();
+}
+
+void worker_set_threads(int nr)
+{
+	worker_lock();
+	worker_threads = nr;
+	if (initialized && running) {
+		start_threads();
+		/* extra threads exit when they wake up */
+		pthread_cond_broadcast(&worker_cond);
+	}
+	worker_unlock();
+}
 
-	pthread_join(worker_thread, NULL);
+void worker_set_priority(int type, int prio)
+{
+	BUG_ON(type <= 0 || type >= WORKER_MAX_TYPES);
+
+	worker_lock();
+	queues[type].prio = prio;
+	worker_unlock();
 }
 
 void worker_add_job(int type, void (*job_cb)(void *data),
@@ -94,70 +201,85 @@ void worker_add_job(int type, void (*job_cb)(void *data),
 {
 	struct worker_job *job;
 
+	BUG_ON(type <= 0 || type >= WORKER_MAX_TYPES);
+
 	job = xnew(struct worker_job, 1);
 	job->type = type;
 	job->job_cb = job_cb;
 	job->free_cb = free_cb;
 	job->data = data;
+	job->cancel = 0;
 
 	worker_lock();
-	list_add_tail(&job->node, &worker_job_head);
+	job->seq = job_seq++;
+	list_add_tail(&job->node, &queues[type].head);
 	pthread_cond_signal(&worker_cond);
 	worker_unlock();
 }
 
 void worker_remove_jobs(int type)
 {
-	struct list_head *item;
+	int i;
 
 	worker_lock();
-	cancel_type = type;
+	for (i = 1; i < WORKER_MAX_TYPES; i++) {
+		struct worker_queue *q = &queues[i];
+		struct list_head *item;
+
+		if (!type_matches(type, i))
+			continue;
 
-	/* remove jobs of the specified type from the queue */
-	item = worker_job_head.next;
-	while (item != &worker_job_head) {
-		struct worker_job *job = container_of(item, struct worker_job, node);
-		struct list_head *next = item->next;
+		/* remove jobs of the specified type from the queue */
+		item = q->head.next;
+		while (item != &q->head) {
+			struct worker_job *job = container_of(item, struct worker_job, node);
+			struct list_head *next = item->next;
 
-		if (type == JOB_TYPE_ANY || type == job->type) {
 			list_del(&job->node);
 			job->free_cb(job->data);
 			free(job);
+			item = next;
 		}
-		item = next;
-	}
 
-	/* wait current job to finish or cancel if it's of the specified type */
-	if (cur_job && (type == JOB_TYPE_ANY || type == cur_job->type))
-		pthread_cond_wait(&worker_cond, &worker_mutex);
-
-	cancel_type = JOB_TYPE_NONE;
+		/*
+		 * don't wait for the running job, it notices the flag soon
+		 * enough.  jobs added after this run after it has finished
+		 */
+		if (q->running)
+			q->running->cancel = 1;
+	}
 	worker_unlock();
 }
 
 int worker_has_job(int type)
 {
-	struct worker_job *job;
-	int has_job = 0;
+	int i, has_job = 0;
 
 	worker_lock();
-	list_for_each_entry(job, &worker_job_head, node) {
-		if (type == JOB_TYPE_ANY || type == job->type) {
+	/* cmus --index doesn't start the worker */
+	for (i = 1; initialized && i < WORKER_MAX_TYPES; i++) {
+		struct worker_queue *q = &queues[i];
+
+		if (type_matches(type, i) && (q->running || !list_empty(&q->head))) {
 			has_job = 1;
 			break;
 		}
 	}
-	if (cur_job && (type == JOB_TYPE_ANY || type == cur_job->type))
-		has_job = 1;
 	worker_unlock();
 	return has_job;
 }
 
 /*
- * this is only called from the worker thread
- * cur_job is guaranteed to be non-NULL
+ * this is only called from a worker thread
+ * current job is guaranteed to be non-NULL
  */
 int worker_cancelling(void)
 {
-	return cur_job->type == cancel_type || cancel_type == JOB_TYPE_ANY;
+	struct worker_job *job = pthread_getspecific(cur_job_key);
+	int cancel;
+
+	worker_lock();
+	cancel = job->cancel;
+	worker_unlock();
+	return cancel;
 }
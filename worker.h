@@ -4,9 +4,27 @@
 #define JOB_TYPE_NONE	0
 #define JOB_TYPE_ANY	-1
 
+/* job types are small integers, see cmus.h */
+#define WORKER_MAX_TYPES	8
+
+#define WORKER_PRIO_LOW		0
+#define WORKER_PRIO_NORMAL	1
+#define WORKER_PRIO_HIGH	2
+
+/* number of worker threads */
+extern int worker_threads;
+
 void worker_init(void);
 void worker_exit(void);
 
+void worker_set_threads(int nr);
+
+/*
+ * jobs of a higher priority type are run before jobs of lower priority
+ * types.  jobs of the same type are always run one at a time in order.
+ */
+void worker_set_priority(int type, int prio);
+
 /*
  * @type:     JOB_TYPE_* (>0)
  * @job_cb:   does the job
@@ -18,6 +36,9 @@ void worker_add_job(int type, void (*job_cb)(void *data),
 
 /*
  * @type: job type. >0, use JOB_TYPE_ANY to remove all
+ *
+ * queued jobs are removed, running jobs are asked to cancel but not
+ * waited for
  */
 void worker_remove_jobs(int type);
 
@@ -28,7 +49,9 @@ int worker_has_job(int type);
  *
  * returns: 0 or 1
  *
- * long jobs should call this to see whether it should cancel
+ * long jobs should call this to see whether it should cancel.  anything
+ * a cancelled job still adds to a view must be checked with this while
+ * holding the editable lock.
  * call from job function _only_
  */
 int worker_cancelling(void);